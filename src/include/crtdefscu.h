@@ -30,6 +30,8 @@ THE SOFTWARE.
 //#include <corecrt_io.h>
 #include <cuda_runtime.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <limits.h>
 #define __LIBCU__
 
 #define HAS_STDIO_BUFSIZ_NONE__
@@ -50,12 +52,16 @@ All macros listed above as possibly being defined by this file are explicitly un
 #define __USE_LARGEFILE64	1
 #endif
 
+#if defined(LIBCU_HOST) && !defined(_MSC_VER)
+#undef __USE_LARGEFILE64 // glibc turns this on under _GNU_SOURCE, but the 64-bit messages carry the msvc _stat64
+#endif
+
 #if defined(_FILE_OFFSET_BITS) && _FILE_OFFSET_BITS == 64
 #define __USE_FILE_OFFSET64	1
 #endif
 
 #ifndef CORE_MAXFILESTREAM
-#define CORE_MAXFILESTREAM 10
+#define CORE_MAXFILESTREAM 4096 // device descriptors, and streams, open at once
 #endif
 
 #ifndef CORE_MAXHOSTPTR
@@ -67,7 +73,7 @@ All macros listed above as possibly being defined by this file are explicitly un
 #define panic(fmt, ...) { printf(fmt"\n", __VA_ARGS__); asm("trap;"); }
 #else
 //__forceinline void Coverage(int line) { }
-#define panic(fmt, ...) { printf(fmt"\n", __VA_ARGS__); exit(1); }
+#define panic(fmt, ...) { printf(fmt"\n", ##__VA_ARGS__); exit(1); }
 #endif  /* __CUDA_ARCH__ */
 
 /* GCC does not define the offsetof() macro so we'll have to do it ourselves. */
@@ -27,6 +27,7 @@ THE SOFTWARE.
 #ifndef _CTYPECU_H
 #define _CTYPECU_H
 #include <crtdefscu.h>
+#include <ctype.h>
 
 __BEGIN_DECLS;
 extern __constant__ unsigned char __curtUpperToLower[256];
@@ -35,13 +36,14 @@ extern __forceinline __device__ int isctype_(int c, int type) { return (__curtCt
 #define isctype isctype_
 __END_DECLS;
 
-#include <ctype.h>
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __BEGIN_DECLS;
 
-///* set bit masks for the possible character types */
-//#define _DIGIT          0x04     /* digit[0-9] */
-//#define _HEX            0x08    /* hexadecimal digit */
+/* set bit masks for the possible character types */
+#ifndef _DIGIT
+#define _DIGIT          0x04     /* digit[0-9] */
+#define _HEX            0x08    /* hexadecimal digit */
+#endif
 
 extern __forceinline __device__ int isalnum_(int c) { return (__curtCtypeMap[(unsigned char)c]&0x06)!=0; }
 #define isalnum isalnum_
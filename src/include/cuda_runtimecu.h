@@ -29,6 +29,10 @@ THE SOFTWARE.
 
 #include <cuda_runtime.h>
 #include <host_functions.h>
+#ifndef LIBCU_HOST
+/* kernel<<<grid, block>>>(args) as cudaLaunchGrid(kernel, grid, block)(args), which libcu.host runs on host threads. */
+#define cudaLaunchGrid(kernel, grid, block) kernel<<<grid, block>>>
+#endif
 extern __device__ void libcuReset();
 
 #endif /* __CUDA_RUNTIMECU_H__ */
\ No newline at end of file
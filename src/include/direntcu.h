@@ -29,7 +29,7 @@ THE SOFTWARE.
 #include <crtdefscu.h>
 
 #include <_dirent.h>
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __BEGIN_DECLS;
 
 /* Open a directory stream on NAME. Return a DIR stream on the directory, or NULL if it could not be opened. */
@@ -29,11 +29,12 @@ THE SOFTWARE.
 #include <crtdefscu.h>
 
 #include <errno.h>
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __BEGIN_DECLS;
 
 extern __device__ int *_errno_(void);
 #define _errno _errno_
+#undef errno
 #define errno (*_errno())
 extern __device__ errno_t _set_errno_(int value);
 #define _set_errno _set_errno_
@@ -0,0 +1,75 @@
+﻿/*
+fsimage.h - packed images of the memory filesystem
+The MIT License
+
+Copyright (c) 2016 Sky Morey
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _EXT_FSIMAGE_H
+#define _EXT_FSIMAGE_H
+#include <stddef.h>
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+	/* An image is the header, the directory table, the names and the file extents, one after the other and each a multiple of 8 bytes,
+	** so the host builds it once and moves it to the device in one copy. fsystemLoad serves the files from the image in place. */
+	typedef struct fsimage_t {
+		unsigned int magic;				// FSIMAGE_MAGIC
+		unsigned int version;			// FSIMAGE_VERSION
+		int entCount;					// Entities in the directory table, each after its directory
+		int nameSize;					// Bytes of names, each null terminated
+		long long dataSize;				// Bytes of file extents, each started on a multiple of 8
+	} fsimage_t;
+
+	typedef struct fsimageEnt_t {
+		int parent;						// Index of the directory holding the entity, -1 for the root
+		int type;						// d_type, 1 for a directory and 2 for a file
+		int name;						// Offset of the name in the names
+		int namlen;						// Length of the name
+		long long offset;				// Offset of a file's extent in the extents
+		long long size;					// Bytes of a file
+	} fsimageEnt_t;
+
+#define FSIMAGE_MAGIC 0x5346434C // "LCFS"
+#define FSIMAGE_VERSION 1
+#define FSIMAGE_ROUND(x) (((x) + 7) & ~7)
+#define fsimageEnts(h) ((fsimageEnt_t *)((char *)(h) + sizeof(fsimage_t)))
+#define fsimageNames(h) ((char *)(fsimageEnts(h) + (h)->entCount))
+#define fsimageData(h) (fsimageNames(h) + (h)->nameSize)
+#define fsimageSize(h) (sizeof(fsimage_t) + (h)->entCount * sizeof(fsimageEnt_t) + (h)->nameSize + (h)->dataSize)
+
+	/* A file, or a directory when isDir is set, to pack; path is from the root with '\\' or '/' between components. */
+	typedef struct fsimageFile_t {
+		const char *path;
+		const void *data;
+		long long size;
+		bool isDir;
+	} fsimageFile_t;
+
+	/* Pack files into image, making the directories on their paths, and return the bytes the image takes; nothing is written unless
+	** size covers them. Returns 0 when a file and a directory claim the same path. A host function. */
+	extern size_t fsimageBuild(void *image, size_t size, const fsimageFile_t *files, int count);
+
+#ifdef  __cplusplus
+}
+#endif
+#endif  /* _EXT_FSIMAGE_H */
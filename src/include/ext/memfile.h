@@ -34,6 +34,7 @@ extern "C" {
 
 	extern __constant__ int __sizeofMemfile_t;
 	extern __device__ void memfileOpen(memfile_t *f);
+	extern __device__ void memfileMap(memfile_t *f, const void *data, int64_t size);
 	extern __device__ void memfileRead(memfile_t *f, void *buffer, int amount, int64_t offset);
 	extern __device__ bool memfileWrite(memfile_t *f, const void *buffer, int amount, int64_t offset);
 	extern __device__ void memfileTruncate(memfile_t *f, int64_t size);
@@ -77,7 +77,7 @@ extern "C" cudaError_t cudaDeviceFallocHeapDestroy(cudaDeviceFallocHeap &heap);
 // DEVICE SIDE
 // External function definitions for device-side code
 #pragma region DEVICE SIDE
-#if __CUDACC__
+#if __CUDACC__ || defined(LIBCU_HOST)
 
 typedef struct cuFallocDeviceHeap fallocDeviceHeap;
 extern __constant__ fallocDeviceHeap *_defaultDeviceHeap;
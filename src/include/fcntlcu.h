@@ -31,7 +31,7 @@ THE SOFTWARE.
 #include <sys/statcu.h>
 
 #include <fcntl.h>
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 #include <io.h>
 __BEGIN_DECLS;
 
@@ -28,14 +28,16 @@ THE SOFTWARE.
 #define _GRPCU_H
 #include <crtdefscu.h>
 
+#ifdef _MSC_VER
 #define gid_t short
+#endif
 struct group {
 	char *gr_name;		// the name of the group
 	gid_t gr_gid;		// numerical group ID
 	char  **gr_mem;		// pointer to a null-terminated array of character pointers to member names
 };
 
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __BEGIN_DECLS;
 
 /* get group database entry for a group ID */
@@ -35,6 +35,8 @@ extern "C" {
 	extern bool gpuAssert(cudaError_t code, const char *action, const char *file = nullptr, int line = 0, bool abort = true);
 	extern int gpuGetMaxGflopsDevice();
 	extern char **cudaDeviceTransferStringArray(size_t length, char *const value[], cudaError_t *error = nullptr);
+	/* Send the host streams what device code still holds buffered for them. sentinelServerShutdown does so while it still serves them. */
+	extern cudaError_t cudaDeviceFlushHostStreams();
 
 #ifdef __cplusplus
 }
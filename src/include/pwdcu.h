@@ -30,7 +30,9 @@ THE SOFTWARE.
 #include <sys/types.h>
 #include <grpcu.h>
 
+#ifdef _MSC_VER
 #define uid_t short
+#endif
 
 struct passwd {
 	char *pw_name;		// user's login name
@@ -40,7 +42,7 @@ struct passwd {
 	//char *pw_shell;		// program to use as shell
 };
 
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __BEGIN_DECLS;
 
 /* search user database for a user ID */
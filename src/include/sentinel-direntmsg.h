@@ -41,20 +41,11 @@ enum {
 };
 
 struct dirent_opendir {
-	static __forceinline __device__ char *Prepare(dirent_opendir *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(dirent_opendir, SENTINELIN(dirent_opendir, Str))
 	sentinelMessage Base;
 	const char *Str;
 	__device__ dirent_opendir(const char *str)
-		: Base(true, DIRENT_OPENDIR, 1024, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(dirent_opendir)); }
+		: Base(true, DIRENT_OPENDIR, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(dirent_opendir)); }
 	DIR *RC;
 };
 
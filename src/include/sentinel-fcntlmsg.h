@@ -53,51 +53,30 @@ struct fcntl_fcntl {
 };
 
 struct fcntl_open {
-	static __forceinline __device__ char *Prepare(fcntl_open *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(fcntl_open, SENTINELIN(fcntl_open, Str))
 	sentinelMessage Base;
 	const char *Str; int OFlag; int P0;
 	__device__ fcntl_open(const char *str, int oflag, int p0)
-		: Base(true, FCNTL_OPEN, 1024, SENTINELPREPARE(Prepare)), Str(str), OFlag(oflag), P0(p0) { sentinelDeviceSend(&Base, sizeof(fcntl_open)); }
+		: Base(true, FCNTL_OPEN, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str), OFlag(oflag), P0(p0) { sentinelDeviceSend(&Base, sizeof(fcntl_open)); }
 	int RC;
 };
 
 struct fcntl_stat {
 	static __forceinline __device__ char *Prepare(fcntl_stat *t, char *data, char *dataEnd, intptr_t offset)
 	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		t->Ptr = (struct stat *)(str + offset);
+		char *end = sentinelMarshal<fcntl_stat, SENTINELIN(fcntl_stat, Str)>::Prepare(t, data, dataEnd, offset);
+		t->Ptr = (struct stat *)t->Str; // the reply overwrites the path
 		return end;
 	}
 	sentinelMessage Base;
 	const char *Str; struct stat *Ptr; bool LStat;
 	__device__ fcntl_stat(const char *str, struct stat *ptr, bool lstat)
-		: Base(true, FCNTL_STAT, 1024, SENTINELPREPARE(Prepare)), Str(str), Ptr(ptr), LStat(lstat) { sentinelDeviceSend(&Base, sizeof(fcntl_stat)); }
+		: Base(true, FCNTL_STAT, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare), SENTINEL_LANELATENCY), Str(str), Ptr(ptr), LStat(lstat) { sentinelDeviceSend(&Base, sizeof(fcntl_stat)); }
 	int RC;
 };
 
 struct fcntl_fstat {
-	static __forceinline __device__ char *Prepare(fcntl_fstat *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		char *ptr = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += 1024);
-		if (end > dataEnd) return nullptr;
-		t->Ptr = (struct stat *)ptr;
-		return end;
-	}
+	SENTINELMARSHAL(fcntl_fstat, SENTINELOUT(fcntl_fstat, Ptr, 1024))
 	sentinelMessage Base;
 	int Handle; struct stat *Ptr;
 	__device__ fcntl_fstat(int fd, struct stat *ptr)
@@ -108,31 +87,19 @@ struct fcntl_fstat {
 struct fcntl_stat64 {
 	static __forceinline __device__ char *Prepare(fcntl_stat64 *t, char *data, char *dataEnd, intptr_t offset)
 	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		t->Ptr = (struct _stat64 *)(str + offset);
+		char *end = sentinelMarshal<fcntl_stat64, SENTINELIN(fcntl_stat64, Str)>::Prepare(t, data, dataEnd, offset);
+		t->Ptr = (struct _stat64 *)t->Str; // the reply overwrites the path
 		return end;
 	}
 	sentinelMessage Base;
 	const char *Str; struct _stat64 *Ptr; bool LStat;
 	__device__ fcntl_stat64(const char *str, struct _stat64 *ptr, bool lstat)
-		: Base(true, FCNTL_STAT64, 1024, SENTINELPREPARE(Prepare)), Str(str), Ptr(ptr), LStat(lstat) { sentinelDeviceSend(&Base, sizeof(fcntl_stat64)); }
+		: Base(true, FCNTL_STAT64, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare), SENTINEL_LANELATENCY), Str(str), Ptr(ptr), LStat(lstat) { sentinelDeviceSend(&Base, sizeof(fcntl_stat64)); }
 	int RC;
 };
 
 struct fcntl_fstat64 {
-	static __forceinline __device__ char *Prepare(fcntl_fstat64 *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		char *ptr = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += 1024);
-		if (end > dataEnd) return nullptr;
-		t->Ptr = (struct _stat64 *)ptr;
-		return end;
-	}
+	SENTINELMARSHAL(fcntl_fstat64, SENTINELOUT(fcntl_fstat64, Ptr, 1024))
 	sentinelMessage Base;
 	int Handle; struct _stat64 *Ptr; bool LStat;
 	__device__ fcntl_fstat64(int fd, struct _stat64 *ptr)
@@ -141,56 +108,29 @@ struct fcntl_fstat64 {
 };
 
 struct fcntl_chmod {
-	static __forceinline __device__ char *Prepare(fcntl_chmod *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(fcntl_chmod, SENTINELIN(fcntl_chmod, Str))
 	sentinelMessage Base;
 	const char *Str; mode_t Mode;
 	__device__ fcntl_chmod(const char *str, mode_t mode)
-		: Base(true, FCNTL_CHMOD, 1024, SENTINELPREPARE(Prepare)), Str(str), Mode(mode) { sentinelDeviceSend(&Base, sizeof(fcntl_chmod)); }
+		: Base(true, FCNTL_CHMOD, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str), Mode(mode) { sentinelDeviceSend(&Base, sizeof(fcntl_chmod)); }
 	int RC;
 };
 
 struct fcntl_mkdir {
-	static __forceinline __device__ char *Prepare(fcntl_mkdir *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(fcntl_mkdir, SENTINELIN(fcntl_mkdir, Str))
 	sentinelMessage Base;
 	const char *Str; mode_t Mode;
 	__device__ fcntl_mkdir(const char *str, mode_t mode)
-		: Base(true, FCNTL_MKDIR, 1024, SENTINELPREPARE(Prepare)), Str(str), Mode(mode) { sentinelDeviceSend(&Base, sizeof(fcntl_mkdir)); }
+		: Base(true, FCNTL_MKDIR, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str), Mode(mode) { sentinelDeviceSend(&Base, sizeof(fcntl_mkdir)); }
 	int RC;
 };
 
 struct fcntl_mkfifo {
-	static __forceinline __device__ char *Prepare(fcntl_mkfifo *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(fcntl_mkfifo, SENTINELIN(fcntl_mkfifo, Str))
 	sentinelMessage Base;
 	const char *Str; mode_t Mode;
 	__device__ fcntl_mkfifo(const char *str, mode_t mode)
-		: Base(true, FCNTL_MKFIFO, 1024, SENTINELPREPARE(Prepare)), Str(str), Mode(mode) { sentinelDeviceSend(&Base, sizeof(fcntl_mkfifo)); }
+		: Base(true, FCNTL_MKFIFO, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str), Mode(mode) { sentinelDeviceSend(&Base, sizeof(fcntl_mkfifo)); }
 	int RC;
 };
 
@@ -57,42 +57,20 @@ enum {
 };
 
 struct stdio_remove {
-	static __forceinline __device__ char *Prepare(stdio_remove *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(stdio_remove, SENTINELIN(stdio_remove, Str))
 	sentinelMessage Base;
 	const char *Str;
 	__device__ stdio_remove(const char *str)
-		: Base(true, STDIO_REMOVE, 1024, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(stdio_remove)); }
+		: Base(true, STDIO_REMOVE, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(stdio_remove)); }
 	int RC;
 };
 
 struct stdio_rename {
-	static __forceinline __device__ char *Prepare(stdio_rename *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		int str2Length = (t->Str2 ? (int)strlen(t->Str2) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *str2 = (char *)(data += strLength);
-		char *end = (char *)(data += str2Length);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		memcpy(str2, t->Str2, str2Length);
-		t->Str = str + offset;
-		t->Str2 = str2 + offset;
-		return end;
-	}
+	SENTINELMARSHAL(stdio_rename, SENTINELIN(stdio_rename, Str), SENTINELIN(stdio_rename, Str2))
 	sentinelMessage Base;
 	const char *Str; const char *Str2;
 	__device__ stdio_rename(const char *str, const char *str2)
-		: Base(true, STDIO_RENAME, 1024, SENTINELPREPARE(Prepare)), Str(str), Str2(str2) { sentinelDeviceSend(&Base, sizeof(stdio_rename)); }
+		: Base(true, STDIO_RENAME, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str), Str2(str2) { sentinelDeviceSend(&Base, sizeof(stdio_rename)); }
 	int RC;
 };
 
@@ -113,42 +91,20 @@ struct stdio_fflush {
 };
 
 struct stdio_freopen {
-	static __forceinline __device__ char *Prepare(stdio_freopen *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		int str2Length = (t->Str2 ? (int)strlen(t->Str2) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *str2 = (char *)(data += strLength);
-		char *end = (char *)(data += str2Length);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		memcpy(str2, t->Str2, str2Length);
-		t->Str = str + offset;
-		t->Str2 = str2 + offset;
-		return end;
-	}
+	SENTINELMARSHAL(stdio_freopen, SENTINELIN(stdio_freopen, Str), SENTINELIN(stdio_freopen, Str2))
 	sentinelMessage Base;
 	const char *Str; const char *Str2; FILE *Stream;
 	__device__ stdio_freopen(const char *str, const char *str2, FILE *stream)
-		: Base(true, STDIO_FREOPEN, 1024, SENTINELPREPARE(Prepare)), Str(str), Str2(str2), Stream(stream) { sentinelDeviceSend(&Base, sizeof(stdio_freopen)); }
+		: Base(true, STDIO_FREOPEN, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str), Str2(str2), Stream(stream) { sentinelDeviceSend(&Base, sizeof(stdio_freopen)); }
 	FILE *RC;
 };
 
 struct stdio_setvbuf {
-	static __forceinline __device__ char *Prepare(stdio_setvbuf *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int bufferLength = (t->Buffer ? (int)strlen(t->Buffer) + 1 : 0);
-		char *buffer = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += bufferLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(buffer, t->Buffer, bufferLength);
-		t->Buffer = buffer + offset;
-		return end;
-	}
+	SENTINELMARSHAL(stdio_setvbuf, SENTINELIN(stdio_setvbuf, Buffer))
 	sentinelMessage Base;
 	FILE *File; char *Buffer; int Mode; size_t Size;
 	__device__ stdio_setvbuf(FILE *file, char *buffer, int mode, size_t size)
-		: Base(true, STDIO_SETVBUF, 1024, SENTINELPREPARE(Prepare)), File(file), Buffer(buffer), Mode(mode), Size(size) { sentinelDeviceSend(&Base, sizeof(stdio_setvbuf)); }
+		: Base(true, STDIO_SETVBUF, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), File(file), Buffer(buffer), Mode(mode), Size(size) { sentinelDeviceSend(&Base, sizeof(stdio_setvbuf)); }
 	int RC;
 };
 
@@ -169,13 +125,7 @@ struct stdio_fputc {
 };
 
 struct stdio_fgets {
-	static __forceinline __device__ char *Prepare(stdio_fgets *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		t->Str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += 1024);
-		if (end > dataEnd) return nullptr;
-		return end;
-	}
+	SENTINELMARSHAL(stdio_fgets, SENTINELOUT(stdio_fgets, Str, 1024))
 	sentinelMessage Base;
 	int Num; FILE *File;
 	__device__ stdio_fgets(char *str, int num, FILE *file)
@@ -185,20 +135,11 @@ struct stdio_fgets {
 };
 
 struct stdio_fputs {
-	static __forceinline __device__ char *Prepare(stdio_fputs *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(stdio_fputs, SENTINELIN(stdio_fputs, Str))
 	sentinelMessage Base;
 	const char *Str; FILE *File;
 	__device__ stdio_fputs(bool wait, const char *str, FILE *file)
-		: Base(wait, STDIO_FPUTS, 1024, SENTINELPREPARE(Prepare)), Str(str), File(file) { sentinelDeviceSend(&Base, sizeof(stdio_fputs)); }
+		: Base(wait, STDIO_FPUTS, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str), File(file) { sentinelDeviceSend(&Base, sizeof(stdio_fputs)); }
 	int RC;
 };
 
@@ -214,16 +155,31 @@ struct stdio_fread {
 	static __forceinline __device__ char *Prepare(stdio_fread *t, char *data, char *dataEnd, intptr_t offset)
 	{
 		t->Ptr = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += 1024);
+		char *end = (char *)(data += t->Size * t->Num);
 		if (end > dataEnd) return nullptr;
 		return end;
 	}
+	static __forceinline __device__ char *PreparePooled(stdio_fread *t, char *data, char *dataEnd, intptr_t offset)
+	{
+		t->Ptr = (char *)t->Dest + offset;
+		return data + _ROUND8(sizeof(*t));
+	}
+	static __forceinline __device__ void Complete(stdio_fread *t, char *data)
+	{
+		memcpy(t->Dest, data + _ROUND8(sizeof(*t)), t->RC * t->Size);
+	}
 	sentinelMessage Base;
 	size_t Size; size_t Num; FILE *File;
 	__device__ stdio_fread(bool wait, size_t size, size_t num, FILE *file)
-		: Base(wait, STDIO_FREAD, 1024, SENTINELPREPARE(Prepare)), Size(size), Num(num), File(file) { sentinelDeviceSend(&Base, sizeof(stdio_fread)); }
+		: Base(wait, STDIO_FREAD, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Size(size), Num(num), File(file), Dest(nullptr) { sentinelDeviceSend(&Base, sizeof(stdio_fread)); }
+	/* ptr lies in the sentinel pool, the host reads into it in place */
+	__device__ stdio_fread(bool wait, void *ptr, size_t size, size_t num, FILE *file)
+		: Base(wait, STDIO_FREAD, SENTINEL_MSGSIZE, SENTINELPREPARE(PreparePooled)), Size(size), Num(num), File(file), Dest(ptr) { sentinelDeviceSend(&Base, sizeof(stdio_fread)); }
+	__device__ stdio_fread(sentinelTicket *ticket, void *ptr, size_t size, size_t num, FILE *file)
+		: Base(true, STDIO_FREAD, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Size(size), Num(num), File(file), Dest(ptr) { sentinelDeviceSendAsync(&Base, sizeof(stdio_fread), ticket, SENTINELCOMPLETE(Complete)); }
 	size_t RC;
 	void *Ptr;
+	void *Dest;
 };
 
 struct stdio_fwrite {
@@ -237,10 +193,17 @@ struct stdio_fwrite {
 		t->Ptr = (char *)ptr + offset;
 		return end;
 	}
+	static __forceinline __device__ char *PreparePooled(stdio_fwrite *t, char *data, char *dataEnd, intptr_t offset)
+	{
+		t->Ptr = (char *)t->Ptr + offset;
+		return data + _ROUND8(sizeof(*t));
+	}
 	sentinelMessage Base;
 	const void *Ptr; size_t Size; size_t Num; FILE *File;
-	__device__ stdio_fwrite(bool wait, const void *ptr, size_t size, size_t num, FILE *file)
-		: Base(wait, STDIO_FWRITE, 1024, SENTINELPREPARE(Prepare)), Ptr(ptr), Size(size), Num(num), File(file) { sentinelDeviceSend(&Base, sizeof(stdio_fwrite)); }
+	__device__ stdio_fwrite(bool wait, const void *ptr, size_t size, size_t num, FILE *file, bool pooled = false)
+		: Base(wait, STDIO_FWRITE, SENTINEL_MSGSIZE, pooled ? SENTINELPREPARE(PreparePooled) : SENTINELPREPARE(Prepare)), Ptr(ptr), Size(size), Num(num), File(file) { sentinelDeviceSend(&Base, sizeof(stdio_fwrite)); }
+	__device__ stdio_fwrite(sentinelTicket *ticket, const void *ptr, size_t size, size_t num, FILE *file)
+		: Base(true, STDIO_FWRITE, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Ptr(ptr), Size(size), Num(num), File(file) { sentinelDeviceSendAsync(&Base, sizeof(stdio_fwrite), ticket); }
 	size_t RC;
 };
 
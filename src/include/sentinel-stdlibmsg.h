@@ -44,20 +44,11 @@ struct stdlib_exit {
 };
 
 struct stdlib_system {
-	static __forceinline __device__ char *Prepare(stdlib_system *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(stdlib_system, SENTINELIN(stdlib_system, Str))
 	sentinelMessage Base;
 	const char *Str;
 	__device__ stdlib_system(const char *str)
-		: Base(false, STDLIB_SYSTEM, 1024, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(stdlib_system)); }
+		: Base(false, STDLIB_SYSTEM, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(stdlib_system)); }
 	int RC;
 };
 
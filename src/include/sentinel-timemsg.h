@@ -45,24 +45,11 @@ struct time_mktime {
 };
 
 struct time_strftime {
-	static __forceinline __device__ char *Prepare(time_strftime *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		int str2Length = (t->Str2 ? (int)strlen(t->Str2) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *str2 = (char *)(data += strLength);
-		char *end = (char *)(data += str2Length);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		memcpy(str2, t->Str2, str2Length);
-		t->Str = str + offset;
-		t->Str2 = str2 + offset;
-		return end;
-	}
+	SENTINELMARSHAL(time_strftime, SENTINELIN(time_strftime, Str), SENTINELIN(time_strftime, Str2))
 	sentinelMessage Base;
 	const char *Str; size_t Maxsize; const char *Str2; const struct tm *Tp;
 	__device__ time_strftime(const char *str, size_t maxsize, const char *str2, const struct tm *tp)
-		: Base(true, TIME_STRFTIME, 1024, SENTINELPREPARE(Prepare)), Str(str), Maxsize(maxsize), Str2(str2), Tp(tp) { sentinelDeviceSend(&Base, sizeof(time_strftime)); }
+		: Base(true, TIME_STRFTIME, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str), Maxsize(maxsize), Str2(str2), Tp(tp) { sentinelDeviceSend(&Base, sizeof(time_strftime)); }
 	size_t RC;
 };
 
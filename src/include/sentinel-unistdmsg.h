@@ -46,20 +46,11 @@ enum {
 };
 
 struct unistd_access {
-	static __forceinline __device__ char *Prepare(unistd_access *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int nameLength = (t->Name ? (int)strlen(t->Name) + 1 : 0);
-		char *name = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += nameLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(name, t->Name, nameLength);
-		t->Name = name + offset;
-		return end;
-	}
+	SENTINELMARSHAL(unistd_access, SENTINELIN(unistd_access, Name))
 	sentinelMessage Base;
 	const char *Name; int Type;
 	__device__ unistd_access(const char *name, int type)
-		: Base(true, UNISTD_ACCESS, 1024, SENTINELPREPARE(Prepare)), Name(name), Type(type) { sentinelDeviceSend(&Base, sizeof(unistd_access)); }
+		: Base(true, UNISTD_ACCESS, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare), SENTINEL_LANELATENCY), Name(name), Type(type) { sentinelDeviceSend(&Base, sizeof(unistd_access)); }
 	int RC;
 };
 
@@ -83,15 +74,27 @@ struct unistd_read {
 	static __forceinline __device__ char *Prepare(unistd_read *t, char *data, char *dataEnd, intptr_t offset)
 	{
 		t->Ptr = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += 1024);
+		char *end = (char *)(data += t->Size);
 		if (end > dataEnd) return nullptr;
 		return end;
 	}
+	static __forceinline __device__ char *PreparePooled(unistd_read *t, char *data, char *dataEnd, intptr_t offset)
+	{
+		t->Ptr = (char *)t->Dest + offset;
+		return data + _ROUND8(sizeof(*t));
+	}
+	static __forceinline __device__ void Complete(unistd_read *t, char *data)
+	{
+		if (t->RC != (size_t)-1) memcpy(t->Dest, data + _ROUND8(sizeof(*t)), t->RC);
+	}
 	sentinelMessage Base;
 	int Handle; void *Ptr; size_t Size;
-	__device__ unistd_read(bool wait, int fd, void *buf, size_t nbytes)
-		: Base(wait, UNISTD_READ, 1024, SENTINELPREPARE(Prepare)), Handle(fd), Ptr(buf), Size(nbytes) { sentinelDeviceSend(&Base, sizeof(unistd_read)); }
+	__device__ unistd_read(bool wait, int fd, void *buf, size_t nbytes, bool pooled = false)
+		: Base(wait, UNISTD_READ, SENTINEL_MSGSIZE, pooled ? SENTINELPREPARE(PreparePooled) : SENTINELPREPARE(Prepare)), Handle(fd), Ptr(buf), Size(nbytes), Dest(buf) { sentinelDeviceSend(&Base, sizeof(unistd_read)); }
+	__device__ unistd_read(sentinelTicket *ticket, int fd, void *buf, size_t nbytes)
+		: Base(true, UNISTD_READ, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Handle(fd), Ptr(buf), Size(nbytes), Dest(buf) { sentinelDeviceSendAsync(&Base, sizeof(unistd_read), ticket, SENTINELCOMPLETE(Complete)); }
 	size_t RC;
+	void *Dest;
 };
 
 struct unistd_write {
@@ -105,61 +108,44 @@ struct unistd_write {
 		t->Ptr = (char *)ptr + offset;
 		return end;
 	}
+	static __forceinline __device__ char *PreparePooled(unistd_write *t, char *data, char *dataEnd, intptr_t offset)
+	{
+		t->Ptr = (char *)t->Ptr + offset;
+		return data + _ROUND8(sizeof(*t));
+	}
 	sentinelMessage Base;
 	int Handle; const void *Ptr; size_t Size;
-	__device__ unistd_write(bool wait, int fd, const void *buf, size_t n)
-		: Base(wait, UNISTD_WRITE, 1024, SENTINELPREPARE(Prepare)), Handle(fd), Ptr(buf), Size(n) { sentinelDeviceSend(&Base, sizeof(unistd_write)); }
+	__device__ unistd_write(bool wait, int fd, const void *buf, size_t n, bool pooled = false)
+		: Base(wait, UNISTD_WRITE, SENTINEL_MSGSIZE, pooled ? SENTINELPREPARE(PreparePooled) : SENTINELPREPARE(Prepare)), Handle(fd), Ptr(buf), Size(n) { sentinelDeviceSend(&Base, sizeof(unistd_write)); }
+	__device__ unistd_write(sentinelTicket *ticket, int fd, const void *buf, size_t n)
+		: Base(true, UNISTD_WRITE, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Handle(fd), Ptr(buf), Size(n) { sentinelDeviceSendAsync(&Base, sizeof(unistd_write), ticket); }
 	size_t RC;
 };
 
 struct unistd_chown {
-	static __forceinline __device__ char *Prepare(unistd_chown *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(unistd_chown, SENTINELIN(unistd_chown, Str))
 	sentinelMessage Base;
 	const char *Str; int Owner; int Group;
 	__device__ unistd_chown(const char *str, int owner, int group)
-		: Base(true, UNISTD_CHOWN, 1024, SENTINELPREPARE(Prepare)), Str(str), Owner(owner), Group(group) { sentinelDeviceSend(&Base, sizeof(unistd_chown)); }
+		: Base(true, UNISTD_CHOWN, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str), Owner(owner), Group(group) { sentinelDeviceSend(&Base, sizeof(unistd_chown)); }
 	int RC;
 };
 
 struct unistd_chdir {
-	static __forceinline __device__ char *Prepare(unistd_chdir *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(unistd_chdir, SENTINELIN(unistd_chdir, Str))
 	sentinelMessage Base;
 	const char *Str;
 	__device__ unistd_chdir(const char *str)
-		: Base(true, UNISTD_CHDIR, 1024, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(unistd_chdir)); }
+		: Base(true, UNISTD_CHDIR, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(unistd_chdir)); }
 	int RC;
 };
 
 struct unistd_getcwd {
-	static __forceinline __device__ char *Prepare(unistd_getcwd *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		t->Ptr = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += 1024);
-		if (end > dataEnd) return nullptr;
-		return end;
-	}
+	SENTINELMARSHAL(unistd_getcwd, SENTINELOUT(unistd_getcwd, Ptr, 1024))
 	sentinelMessage Base;
 	char *Ptr; size_t Size;
 	__device__ unistd_getcwd(char *buf, size_t size)
-		: Base(true, UNISTD_GETCWD, 1024, SENTINELPREPARE(Prepare)), Ptr(buf), Size(size) { sentinelDeviceSend(&Base, sizeof(unistd_getcwd)); }
+		: Base(true, UNISTD_GETCWD, 1024, SENTINELPREPARE(Prepare), SENTINEL_LANELATENCY), Ptr(buf), Size(size) { sentinelDeviceSend(&Base, sizeof(unistd_getcwd)); }
 	char *RC;
 };
 
@@ -172,38 +158,20 @@ struct unistd_dup {
 };
 
 struct unistd_unlink {
-	static __forceinline __device__ char *Prepare(unistd_unlink *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(unistd_unlink, SENTINELIN(unistd_unlink, Str))
 	sentinelMessage Base;
 	const char *Str;
 	__device__ unistd_unlink(const char *str)
-		: Base(true, UNISTD_UNLINK, 1024, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(unistd_unlink)); }
+		: Base(true, UNISTD_UNLINK, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(unistd_unlink)); }
 	int RC;
 };
 
 struct unistd_rmdir {
-	static __forceinline __device__ char *Prepare(unistd_rmdir *t, char *data, char *dataEnd, intptr_t offset)
-	{
-		int strLength = (t->Str ? (int)strlen(t->Str) + 1 : 0);
-		char *str = (char *)(data += _ROUND8(sizeof(*t)));
-		char *end = (char *)(data += strLength);
-		if (end > dataEnd) return nullptr;
-		memcpy(str, t->Str, strLength);
-		t->Str = str + offset;
-		return end;
-	}
+	SENTINELMARSHAL(unistd_rmdir, SENTINELIN(unistd_rmdir, Str))
 	sentinelMessage Base;
 	const char *Str;
 	__device__ unistd_rmdir(const char *str)
-		: Base(true, UNISTD_RMDIR, 1024, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(unistd_rmdir)); }
+		: Base(true, UNISTD_RMDIR, SENTINEL_MSGSIZE, SENTINELPREPARE(Prepare)), Str(str) { sentinelDeviceSend(&Base, sizeof(unistd_rmdir)); }
 	int RC;
 };
 
@@ -41,77 +41,293 @@ extern "C" {
 #endif
 
 #define SENTINEL_MAGIC (unsigned short)0xC811
+#ifndef SENTINEL_MSGSIZE
 #define SENTINEL_MSGSIZE 4096
-#define SENTINEL_MSGCOUNT 1
+#endif
+#ifndef SENTINEL_MSGCOUNT
+#define SENTINEL_MSGCOUNT 16 // ring slots per map, must be a power of two so tickets wrap cleanly
+#endif
+static_assert((SENTINEL_MSGCOUNT & (SENTINEL_MSGCOUNT - 1)) == 0, "SENTINEL_MSGCOUNT must be a power of two");
+#ifndef SENTINEL_POOLSIZE
+#define SENTINEL_POOLSIZE 0x400000 // buffer pool trailing the lanes of each map, payloads placed there cross without a copy
+#endif
+#define SENTINEL_POOLBLOCK 4096 // pool allocation granularity
+#define SENTINEL_POOLBLOCKS (SENTINEL_POOLSIZE/SENTINEL_POOLBLOCK)
 #define SENTINEL_NAME "Sentinel" //"Global\\Sentinel"
-#define SENTINEL_DEVICEMAPS 1
+#ifndef SENTINEL_DEVICEMAPS
+#define SENTINEL_DEVICEMAPS 8 // most device maps, sentinelServerInitialize sets how many are in use
+#endif
+#ifndef SENTINEL_ROUTE
+#define SENTINEL_ROUTE(block, thread, maps) ((unsigned int)(block) % (unsigned int)(maps)) // device map a sender publishes through, by block so a block's commands stay on one ring
+#endif
+#define SENTINEL_LANES 2 // rings per map, each claimed by threads and executed by workers of its own
+#ifndef SENTINEL_LANEWORKERS
+#define SENTINEL_LANEWORKERS 1 // host worker threads of each lane past the bulk lane, which gets the workers of sentinelServerInitialize
+#endif
+#ifndef SENTINEL_CLIENTS
+#define SENTINEL_CLIENTS 8 // client processes given a ring of their own, the rest share the host map
+#endif
+#ifndef SENTINEL_WORKERS
+#define SENTINEL_WORKERS 4 // host worker threads executing commands, 0 executes on the map threads
+#endif
+#define SENTINEL_SERIAL ((intptr_t)-1) // affinity of a command ordered against every other command
+#define SENTINEL_OPCOUNT 256 // one dispatch table entry per value of sentinelMessage::OP
+
+	enum {
+		SENTINEL_LANEBULK, // data movement and anything long running
+		SENTINEL_LANELATENCY, // short control and metadata calls, kept from queueing behind bulk ones
+	};
 
 	struct sentinelMessage {
 		bool Wait;
 		char OP;
+		signed char Lane; // SENTINEL_LANE*, or -1 for the lane the server gives OP
 		int Size;
 		char *(*Prepare)(void*,char*,char*,intptr_t);
-		__device__ sentinelMessage(bool wait, char op, int size = 0, char *(*prepare)(void*,char*,char*,intptr_t) = nullptr)
-			: Wait(wait), OP(op), Size(size), Prepare(prepare) { }
+		__device__ sentinelMessage(bool wait, char op, int size = 0, char *(*prepare)(void*,char*,char*,intptr_t) = nullptr, signed char lane = -1)
+			: Wait(wait), OP(op), Lane(lane), Size(size), Prepare(prepare) { }
 	public:
 	};
 #define SENTINELPREPARE(P) ((char *(*)(void*,char*,char*,intptr_t))&P)
 
 	typedef struct __align__(8) {
 		unsigned short Magic;
-		volatile long Status;
+		volatile int Status; // 32-bit on every host so it can double as a futex word
+		volatile int Seq; // ticket allowed to fill this slot next, advanced by SENTINEL_MSGCOUNT when the slot is released
 		int Length;
-#ifndef _WIN64
-		int Unknown;
-#endif
+		int Block, Thread; // sender, the device block and thread or the host process and thread, kept for traces
+		struct sentinelTicket *Ticket; // the device sender's, found by Block and Thread when a full ring holds it back from collecting
 		char Data[1];
 		void Dump();
 	} sentinelCommand;
 
 	typedef struct __align__(8) {
-		long GetId;
-		volatile long SetId;
+		volatile unsigned int GetId; // next ticket the server will take
+		volatile unsigned int SetId; // next ticket handed to a sender
 		intptr_t Offset;
+		volatile int Sleepers; // host threads blocked on a Status or Seq word of this map
+		volatile int Replies; // bumped on each host reply while ReplySleepers is set, the doorbell of sentinelClientWaitAny
+		volatile int ReplySleepers;
+		int SlotSize, SlotCount; // SENTINEL_MSGSIZE and SENTINEL_MSGCOUNT of the server, checked by clients
+		int Lane; // a map is SENTINEL_LANES of these back to back, map - Lane is the first
+		volatile unsigned char Lanes[SENTINEL_OPCOUNT]; // lane of each opcode for messages leaving Lane at -1, kept in the first
 		char Data[SENTINEL_MSGSIZE*SENTINEL_MSGCOUNT];
 		void Dump();
 	} sentinelMap;
 
+	typedef struct __align__(8) {
+		volatile int Lock; // taken by senders of the map only, never by the server
+		int Blocks[SENTINEL_POOLBLOCKS]; // block count at the first block of each allocation, 0 when free
+		char Data[SENTINEL_POOLSIZE];
+	} sentinelPool;
+#define SENTINEL_MAPSIZE (sizeof(sentinelMap)*SENTINEL_LANES + sizeof(sentinelPool)) // the lanes of a map and the one pool they share
+#define SENTINEL_POOL(map) ((sentinelPool *)((map) + SENTINEL_LANES)) // of the map whose first lane is map
+#define SENTINEL_POOLED(pool, ptr, size) (_WITHIN(ptr, (pool)->Data, (pool)->Data + SENTINEL_POOLSIZE) && (size) <= (size_t)((pool)->Data + SENTINEL_POOLSIZE - (char *)(ptr)))
+
+	/* First fit over the block table of a pool. The caller holds its Lock. */
+	static __forceinline __host__ __device__ char *sentinelPoolTake(sentinelPool *pool, int blocks)
+	{
+		volatile int *table = pool->Blocks;
+		for (int i = 0, j; i < SENTINEL_POOLBLOCKS; i = j) {
+			if (table[i]) { j = i + table[i]; continue; }
+			for (j = i; j < SENTINEL_POOLBLOCKS && !table[j] && j - i < blocks; j++) { }
+			if (j - i == blocks) { table[i] = blocks; return pool->Data + i * SENTINEL_POOLBLOCK; }
+		}
+		return nullptr;
+	}
+
+	/* Give back the allocation ptr starts, false for a pointer into the middle of one or already given back. The caller holds its Lock. */
+	static __forceinline __host__ __device__ bool sentinelPoolGive(sentinelPool *pool, void *ptr)
+	{
+		size_t offset = (size_t)((char *)ptr - pool->Data);
+		volatile int *table = pool->Blocks;
+		if (offset % SENTINEL_POOLBLOCK || !table[offset / SENTINEL_POOLBLOCK]) return false;
+		table[offset / SENTINEL_POOLBLOCK] = 0;
+		return true;
+	}
+#define SENTINEL_SLOT(map, id) ((sentinelCommand *)&(map)->Data[((id)&(SENTINEL_MSGCOUNT-1))*SENTINEL_MSGSIZE])
+#define SENTINEL_LANEMAP(map, msg) ((map) + (unsigned int)((msg)->Lane >= 0 ? (msg)->Lane : (map)->Lanes[(unsigned char)(msg)->OP]) % SENTINEL_LANES)
+
+	typedef struct {
+		volatile int State; // 0 free, 1 being taken or given back, 2 connected
+		int Pid;
+		int Weight; // commands drained per round under SENTINEL_DRAINWEIGHTED
+	} sentinelClientEntry;
+
+	typedef struct {
+		// one doorbell per lane, not per client: a single host thread drains every ring of a lane and can block on one word only
+		volatile int Doorbell[SENTINEL_LANES]; // bumped by clients publishing while the server sleeps, on any ring of the lane
+		volatile int Sleepers[SENTINEL_LANES];
+		int Count; // rings the server could offer
+		sentinelClientEntry Client[SENTINEL_CLIENTS];
+	} sentinelClientTable;
+
+	enum {
+		SENTINEL_DRAINROUNDROBIN, // one command from each ring per round
+		SENTINEL_DRAINWEIGHTED, // up to each client's weight per round
+	};
+
+	typedef struct sentinelTicket {
+		sentinelMap *Map;
+		sentinelCommand *Cmd; // null once the reply has been collected
+		unsigned int Id;
+		sentinelMessage *Msg;
+		int Length;
+		void (*Complete)(void*,char*); // copies a reply payload out of the slot before it is released
+		sentinelTicket *Next; // the sending host thread's outstanding tickets, a sender held by a full ring collects its own replies
+		bool Collected; // collected that way while the sender waited, WaitAny still owes it to the caller
+	} sentinelTicket;
+#define SENTINELCOMPLETE(C) ((void (*)(void*,char*))&C)
+
 	typedef struct sentinelExecutor {
 		sentinelExecutor *Next;
 		const char *Name;
 		bool (*Executor)(void*,sentinelMessage*,int,char*(**)(void*,char*,char*,intptr_t));
 		void *Tag;
+		bool (*Affinity)(void*,sentinelMessage*,int,intptr_t*); // optional: false if the opcode is not ours, else *key picks the worker (0 any, SENTINEL_SERIAL none)
 	} sentinelExecutor;
 
+	enum {
+		SENTINEL_WAITHOST = 0,		// server thread draining the host map
+		SENTINEL_WAITDEVICE,		// server threads draining the device maps
+		SENTINEL_WAITCLIENT,		// host clients waiting on a reply
+		SENTINEL_WAITCOUNT,
+	};
+
+	typedef struct sentinelWaitPolicy {
+		int SpinCount;				// Busy-spin polls before yielding
+		int YieldCount;				// Yielding polls before blocking
+		int BlockMs;				// Longest single block on the doorbell before polling again
+	} sentinelWaitPolicy;
+
+	typedef struct sentinelWaitStats {
+		long long SpinHits;			// Waits satisfied while spinning
+		long long YieldHits;		// Waits satisfied while yielding
+		long long BlockHits;		// Waits satisfied after blocking
+		long long Spins;			// Spin polls burned
+		long long Yields;			// Yields burned
+		long long Blocks;			// Times a waiter blocked on the doorbell
+		long long Wakes;			// Doorbell wakes issued to blocked waiters
+	} sentinelWaitStats;
+
+	typedef struct sentinelWorkerStats {
+		long long Commands;			// Commands executed
+		int Depth;					// Commands queued or running now
+		int MaxDepth;				// High-water mark of Depth
+	} sentinelWorkerStats;
+
+#define SENTINEL_HISTOGRAM 24 // log2 time buckets, bucket i counts times under 256ns << i and the last takes the rest
+	typedef struct sentinelOpStats {
+		long long Commands;			// Commands executed
+		long long Bytes;			// Slot bytes carried, the message plus its reserved payload
+		long long QueueNs;			// Time from being claimed off the ring to reaching an executor
+		long long ExecNs;			// Time in the executors, host prepare included
+		long long QueueHistogram[SENTINEL_HISTOGRAM];
+		long long ExecHistogram[SENTINEL_HISTOGRAM];
+	} sentinelOpStats;
+
+	typedef struct sentinelRingStats {
+		long long Claims;			// Commands claimed off the ring
+		long long Occupancy[SENTINEL_MSGCOUNT+1]; // Claims by the number of slots taken at the time, the claimed one included
+		int MaxOccupancy;			// High-water mark of slots taken
+	} sentinelRingStats;
+
+#define SENTINEL_TRACEMAGIC 0x43525453 // "STRC"
+#define SENTINEL_TRACEVERSION 1
+	typedef struct sentinelTraceHeader {
+		int Magic;
+		int Version;
+		int RecordSize;				// sizeof(sentinelTraceRecord) of the writer
+		int SlotSize;				// SENTINEL_MSGSIZE of the writer
+	} sentinelTraceHeader;
+
+	typedef struct sentinelTraceRecord {
+		unsigned char OP;
+		signed char Map;			// Device map index, -1 for the host map
+		unsigned char Wait;			// The sender waited on a reply
+		unsigned char Lane;			// SENTINEL_LANE* the command came through
+		int Length;					// The message
+		int Size;					// Payload reserved behind the message
+		unsigned int Digest;		// FNV-1a of the request past the sentinelMessage header, equal requests hash alike
+		int Block, Thread;			// Sender, as stamped in the command
+		long long Claimed;			// Nanoseconds from the start of the trace to being claimed off the ring
+		long long Started;			// ... to reaching an executor
+		long long Finished;			// ... to the executors returning
+	} sentinelTraceRecord;
+
 	typedef struct sentinelContext {
 		sentinelMap *DeviceMap[SENTINEL_DEVICEMAPS];
+		int DeviceMapCount; // device maps in use, each drained by threads of its own
 		sentinelMap *HostMap;
 		sentinelExecutor *HostList;
 		sentinelExecutor *DeviceList;
+		sentinelExecutor *volatile HostOps[SENTINEL_OPCOUNT]; // executor owning each opcode, tried before the list
+		sentinelExecutor *volatile DeviceOps[SENTINEL_OPCOUNT];
 	} sentinelContext;
 
 #if HAS_HOSTSENTINEL
 	extern sentinelMap *_sentinelHostMap;
 	extern intptr_t _sentinelHostMapOffset;
+	extern sentinelClientTable *_sentinelHostClients;
 #endif
 #if HAS_DEVICESENTINEL
 	extern __constant__ sentinelMap *_sentinelDeviceMap[SENTINEL_DEVICEMAPS];
+	extern __constant__ int _sentinelDeviceMapCount;
 #endif
+	extern sentinelMap *_sentinelEmulatedMap[SENTINEL_DEVICEMAPS];
+	extern int _sentinelEmulatedMapCount;
 
 	extern bool sentinelDefaultExecutor(void *tag, sentinelMessage *data, int length, char *(**hostPrepare)(void*,char*,char*,intptr_t));
-	extern void sentinelServerInitialize(sentinelExecutor *executor = nullptr, char *mapHostName = SENTINEL_NAME, bool hostSentinel = true, bool deviceSentinel = true);
+	extern bool sentinelDefaultAffinity(void *tag, sentinelMessage *data, int length, intptr_t *key);
+	extern void sentinelServerInitialize(sentinelExecutor *executor = nullptr, const char *mapHostName = SENTINEL_NAME, bool hostSentinel = true, bool deviceSentinel = true, int workers = SENTINEL_WORKERS, int deviceMaps = 1);
 	extern void sentinelServerShutdown();
+#if HAS_HOSTSENTINEL
+	extern void sentinelSetDrainPolicy(int policy);
+#endif
 #if HAS_DEVICESENTINEL
 	extern __device__ void sentinelDeviceSend(sentinelMessage *msg, int msgLength);
+	extern __device__ void sentinelDeviceSendAsync(sentinelMessage *msg, int msgLength, sentinelTicket *ticket, void (*complete)(void*,char*) = nullptr);
+	extern __device__ bool sentinelDevicePoll(sentinelTicket *ticket);
+	extern __device__ void sentinelDeviceWait(sentinelTicket *ticket);
+	extern __device__ int sentinelDeviceWaitAny(sentinelTicket *tickets, int count);
+	extern __device__ void *sentinelDeviceAlloc(size_t size);
+	extern __device__ void sentinelDeviceFree(void *ptr);
+	extern __device__ bool sentinelDevicePooled(const void *ptr, size_t size);
 #endif
 #if HAS_HOSTSENTINEL
-	extern void sentinelClientInitialize(char *mapHostName = SENTINEL_NAME);
+	extern void sentinelClientInitialize(const char *mapHostName = SENTINEL_NAME, int weight = 1);
 	extern void sentinelClientShutdown();
 	extern void sentinelClientSend(sentinelMessage *msg, int msgLength);
+	extern void sentinelClientSendAsync(sentinelMessage *msg, int msgLength, sentinelTicket *ticket, void (*complete)(void*,char*) = nullptr);
+	extern bool sentinelClientPoll(sentinelTicket *ticket);
+	extern void sentinelClientWait(sentinelTicket *ticket);
+	extern int sentinelClientWaitAny(sentinelTicket *tickets, int count);
+	extern void *sentinelClientAlloc(size_t size);
+	extern void sentinelClientFree(void *ptr);
+	extern bool sentinelClientPooled(const void *ptr, size_t size);
 #endif
+	extern bool sentinelEmulatorInitialize();
+	extern void sentinelEmulatedSend(sentinelMessage *msg, int msgLength);
+	extern void sentinelEmulatedSendAsync(sentinelMessage *msg, int msgLength, sentinelTicket *ticket, void (*complete)(void*,char*) = nullptr);
+	extern bool sentinelEmulatedPoll(sentinelTicket *ticket);
+	extern void sentinelEmulatedWait(sentinelTicket *ticket);
+	extern int sentinelEmulatedWaitAny(sentinelTicket *tickets, int count);
+	extern void sentinelEmulatedSetBlock(int block);
 	extern sentinelExecutor *sentinelFindExecutor(const char *name, bool forDevice = true);
 	extern void sentinelRegisterExecutor(sentinelExecutor *exec, bool makeDefault = false, bool forDevice = true);
 	extern void sentinelUnregisterExecutor(sentinelExecutor *exec, bool forDevice = true);
+	extern void sentinelRegisterExecutorOps(sentinelExecutor *exec, int opFirst, int opLast, bool forDevice = true);
+	extern void sentinelSetOpLane(int op, int lane);
+	extern void sentinelSetWaitPolicy(int waiter, const sentinelWaitPolicy *policy);
+	extern void sentinelGetWaitPolicy(int waiter, sentinelWaitPolicy *policy);
+	extern void sentinelGetWaitStats(int waiter, sentinelWaitStats *stats, bool reset = false);
+	extern bool sentinelGetWorkerStats(int worker, sentinelWorkerStats *stats, bool reset = false);
+	extern bool sentinelGetOpStats(int op, sentinelOpStats *stats, bool reset = false);
+	extern bool sentinelGetRingStats(int map, sentinelRingStats *stats, bool reset = false, int lane = SENTINEL_LANEBULK);
+	extern void sentinelDumpStats();
+	extern void sentinelSetStatsDump(int ms);
+	extern bool sentinelTraceStart(const char *path);
+	extern void sentinelTraceStop();
 	// file-utils
 	extern void sentinelRegisterFileUtils();
 
@@ -119,4 +335,93 @@ extern "C" {
 }
 #endif
 
+// STREAMING
+#if defined(__cplusplus) && HAS_DEVICESENTINEL
+#include <new>
+#ifndef SENTINEL_WINDOW
+#define SENTINEL_WINDOW 4 // chunks of one streamed transfer in flight at once
+#endif
+/* Payload bytes left in a slot after the command header and a message of msgLength. */
+#define SENTINEL_PAYLOAD(msgLength) ((size_t)(SENTINEL_MSGSIZE - offsetof(sentinelCommand, Data) - _ROUND8(msgLength)))
+
+/* Move LENGTH bytes as consecutive chunks of message T, each filling a slot, with SENTINEL_WINDOW of them in flight so the host works on one chunk
+** while the next is copied in. send(msg, ticket, offset, length) constructs a chunk in place and result(msg) gives the bytes it moved, or -1. A short
+** chunk stops further chunks; for a read (BASE set) the ones already in flight are still counted, pulled down to follow it, as the host ran them in
+** order. Returns the bytes moved, or -1 if nothing moved before an error. */
+template <class T, class Send, class Result> __device__ size_t sentinelDeviceStream(char *base, size_t length, Send send, Result result)
+{
+	const size_t chunk = SENTINEL_PAYLOAD(sizeof(T));
+	unsigned long long msgs[SENTINEL_WINDOW][(sizeof(T) + 7) / 8];
+	sentinelTicket tickets[SENTINEL_WINDOW];
+	size_t chunks = length ? (length + chunk - 1) / chunk : 1, next = 0, oldest = 0, done = 0;
+	bool stop = false, counting = true, failed = false;
+	while (oldest < next || (next < chunks && !stop)) {
+		if (next < chunks && !stop && next - oldest < SENTINEL_WINDOW) {
+			size_t offset = next * chunk;
+			send((T *)msgs[next % SENTINEL_WINDOW], &tickets[next % SENTINEL_WINDOW], offset, _MIN(chunk, length - offset));
+			next++;
+			continue;
+		}
+		// collect in issue order
+		int i = (int)(oldest % SENTINEL_WINDOW);
+		size_t offset = oldest * chunk, want = _MIN(chunk, length - offset);
+		sentinelDeviceWait(&tickets[i]);
+		size_t got = result((T *)msgs[i]);
+		if (got == (size_t)-1) { failed = counting && !done; stop = true; counting = false; }
+		else if (counting) {
+			if (base && done != offset && got) memmove(base + done, base + offset, got);
+			done += got;
+			if (got < want) { stop = true; counting = base != nullptr; }
+		}
+		oldest++;
+	}
+	return failed ? (size_t)-1 : done;
+}
+#endif
+
+// MARSHAL
+#ifdef __cplusplus
+// Prepare functions generated from a message's field list: SENTINELMARSHAL(T, fields...) packs each field after the message in the slot, in
+// order, bounded by the slot rather than a reserve guessed up front. The publisher then records what was packed as the message's Size.
+
+/* A NUL terminated string copied in one pass, the field re-aimed at the copy as the host sees it. A null field stays null. */
+template <class T, class P, P T::*F> struct sentinelIn {
+	static __forceinline __device__ char *Pack(T *t, char *data, char *dataEnd, intptr_t offset)
+	{
+		const char *s = t->*F;
+		if (!s) return data;
+		char *d = data;
+		do { if (d == dataEnd) return nullptr; } while ((*d++ = *s++));
+		t->*F = (P)(data + offset);
+		return d;
+	}
+};
+
+/* BYTES of the slot kept for the host to answer into, the field aimed at them as the sender sees them. */
+template <class T, class P, P T::*F, int BYTES> struct sentinelOut {
+	static __forceinline __device__ char *Pack(T *t, char *data, char *dataEnd, intptr_t offset)
+	{
+		if (dataEnd - data < BYTES) return nullptr;
+		t->*F = (P)data;
+		return data + BYTES;
+	}
+};
+
+template <class T, class... Fields> struct sentinelMarshal {
+	static __forceinline __device__ char *Pack(T *t, char *data, char *dataEnd, intptr_t offset) { return data; }
+};
+template <class T, class Field, class... Fields> struct sentinelMarshal<T, Field, Fields...> {
+	static __forceinline __device__ char *Pack(T *t, char *data, char *dataEnd, intptr_t offset)
+	{
+		return (data = Field::Pack(t, data, dataEnd, offset)) ? sentinelMarshal<T, Fields...>::Pack(t, data, dataEnd, offset) : nullptr;
+	}
+	static __forceinline __device__ char *Prepare(T *t, char *data, char *dataEnd, intptr_t offset) { return Pack(t, data + _ROUND8(sizeof(T)), dataEnd, offset); }
+};
+
+#define SENTINELIN(T, F) sentinelIn<T, decltype(T::F), &T::F>
+#define SENTINELOUT(T, F, bytes) sentinelOut<T, decltype(T::F), &T::F, bytes>
+#define SENTINELMARSHAL(T, ...) \
+	static __forceinline __device__ char *Prepare(T *t, char *data, char *dataEnd, intptr_t offset) { return sentinelMarshal<T, __VA_ARGS__>::Prepare(t, data, dataEnd, offset); }
+#endif
+
 #endif  /* _SENTINEL_H */
\ No newline at end of file
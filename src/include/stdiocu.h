@@ -29,7 +29,7 @@ THE SOFTWARE.
 #include <crtdefscu.h>
 
 #include <stdio.h>
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 #include <stdargcu.h>
 
 //typedef struct __STDIO_FILE_STRUCT FILE;
@@ -79,8 +79,9 @@ __BEGIN_DECLS;
 ///* Default path prefix for `mkstemp'.  */
 //#define P_tmpdir "/tmp"
 
-#define ISHOSTFILE(stream) ((stream) < __iob_streams || (stream) > __iob_streams + CORE_MAXFILESTREAM+3)
-extern __constant__ FILE __iob_streams[CORE_MAXFILESTREAM+3];
+#define ISHOSTFILE(stream) (!__iob_isstream(stream))
+extern __device__ bool __iob_isstream(FILE *stream);
+extern __constant__ FILE __iob_streams[3];
 #undef stdin
 #undef stdout
 #undef stderr
@@ -35,7 +35,7 @@ typedef int (*__compar_fn_t)(const void *, const void *);
 #endif
 
 #include <stdlib.h>
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __BEGIN_DECLS;
 
 extern __device__ unsigned long __strtol(register const char *__restrict str, char **__restrict endptr, int base, int sflag);
@@ -320,10 +320,12 @@ __END_DECLS;
 __BEGIN_DECLS;
 
 #if defined(ULLONG_MAX)
+#ifdef _MSC_VER
 /* Returned by `strtoq'.  */
 typedef long long int quad_t;
 /* Returned by `strtouq'.  */
 typedef unsigned long long int u_quad_t;
+#endif
 /* Convert a string to a quadword integer.  */
 __forceinline __device__ quad_t strtoq_(const char *__restrict nptr, char **__restrict endptr, int base) { return (quad_t)strtol(nptr, endptr, base); }
 #define strtoq strtoq_
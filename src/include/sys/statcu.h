@@ -34,7 +34,9 @@ THE SOFTWARE.
 //#define S_ISDIR(m) (((m) & _S_IFMT) == _S_IFDIR)
 
 //#include <bits/libcu_stat.h>
+#ifdef _MSC_VER
 typedef int mode_t;
+#endif
 //
 ///* Test macros for file types.	*/
 //#define	__S_ISTYPE(mode, mask)	(((mode) & __S_IFMT) == (mask))
@@ -66,7 +68,7 @@ typedef int mode_t;
 ///* Read, write, and execute by others.  */
 //#define	S_IRWXO	(S_IRWXG >> 3)
 
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __BEGIN_DECLS;
 
 #ifndef __USE_FILE_OFFSET64
@@ -29,10 +29,14 @@ THE SOFTWARE.
 #include <crtdefscu.h>
 
 //#include <sys/time.h>
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __BEGIN_DECLS;
 
+#if defined(LIBCU_HOST) && !defined(_MSC_VER)
+#include <sys/time.h>
+#elif !defined(LIBCU_HOST) || !defined(_WINSOCKAPI_)
 struct timeval { long tv_sec; long tv_usec; };
+#endif
 
 /* Get the current time of day and timezone information, putting it into *TV and *TZ.  If TZ is NULL, *TZ is not filled.
 Returns 0 on success, -1 on errors. */
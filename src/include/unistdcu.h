@@ -31,10 +31,12 @@ THE SOFTWARE.
 #include <_dirent.h>
 #include <_unistd.h>
 #include <sys/types.h>
+#ifdef _MSC_VER
 typedef short gid_t;
 typedef short uid_t;
+#endif
 
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __BEGIN_DECLS;
 
 #undef access
@@ -0,0 +1,293 @@
+// the standard containers go first, crtdefscu.h claims __R as a macro
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <stdio.h>
+#include <crtdefscu.h>
+#include <stdargcu.h> // ahead of stringcu.h, strbldAppendFormat takes libcu's own va_list
+#include <stringcu.h>
+#include <stdlibcu.h>
+#include <falloc.h>
+#include <ext/hash.h>
+#include <ext/memfile.h>
+
+// Host-only microbenchmarks of the runtime primitives libcu calls in tight loops, built from the libcu.host objects so they measure the
+// code the device runs less the device. Each benchmark runs -w warmup operations, then -r repetitions of -n operations, for each input
+// size; the report gives the fastest, median and slowest repetition per operation.
+//
+// libcu_bench [-b strlen,memcmp,strstr,qsort,strtod,strbld,hashFind,memfileRead,memfileWrite,fallocGetChunk] [-s 16,256,4096]
+//             [-n 1000] [-w 100] [-r 5] [-f csv|json]
+//
+// -s is bytes per operation for the string and memfile benchmarks, elements sorted for qsort, entries in the table for hashFind and the
+// chunk size for fallocGetChunk.
+
+static volatile size_t _benchSink; // results land here so the loops are not optimized away
+
+static long long benchClock()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CASES
+#pragma region CASES
+
+/* Every case sets up its input for size, times iterations operations on it and returns the nanoseconds they took. */
+typedef struct benchCase {
+	const char *Name;
+	long long (*Run)(size_t size, int iterations);
+	bool Bytes; // size is the bytes each operation processes
+} benchCase;
+
+static long long benchStrlen(size_t size, int iterations)
+{
+	std::vector<char> s(size + 1, 'a'); s[size] = 0;
+	size_t sink = 0;
+	long long started = benchClock();
+	for (int i = 0; i < iterations; i++) sink += strlen_(s.data());
+	long long elapsed = benchClock() - started;
+	_benchSink = sink;
+	return elapsed;
+}
+
+/* Equal buffers, so every byte is compared. */
+static long long benchMemcmp(size_t size, int iterations)
+{
+	std::vector<char> a(size + 1, 'a'), b(size + 1, 'a');
+	size_t sink = 0;
+	long long started = benchClock();
+	for (int i = 0; i < iterations; i++) sink += memcmp_(a.data(), b.data(), size);
+	long long elapsed = benchClock() - started;
+	_benchSink = sink;
+	return elapsed;
+}
+
+/* A needle that almost matches at every position and only matches at the end. */
+static long long benchStrstr(size_t size, int iterations)
+{
+	const char *needle = "aaab";
+	std::vector<char> s(std::max(size, (size_t)4) + 1, 'a'); s[s.size() - 1] = 0; s[s.size() - 2] = 'b';
+	size_t sink = 0;
+	long long started = benchClock();
+	for (int i = 0; i < iterations; i++) sink += (size_t)strstr_(s.data(), needle);
+	long long elapsed = benchClock() - started;
+	_benchSink = sink;
+	return elapsed;
+}
+
+static int benchCompare(const void *a, const void *b) { int x = *(const int *)a, y = *(const int *)b; return x < y ? -1 : x > y; }
+
+/* Sorts the same shuffled ints each time; the copy back in is part of the operation. */
+static long long benchQsort(size_t size, int iterations)
+{
+	std::vector<int> source(size), v(size);
+	unsigned int seed = 1;
+	for (size_t i = 0; i < size; i++) source[i] = (int)((seed = seed * 1103515245 + 12345) >> 8);
+	long long started = benchClock();
+	for (int i = 0; i < iterations; i++) { std::copy(source.begin(), source.end(), v.begin()); qsort_(v.data(), size, sizeof(int), benchCompare); }
+	long long elapsed = benchClock() - started;
+	_benchSink = size ? (size_t)v[0] : 0;
+	return elapsed;
+}
+
+/* Parses a run of numbers filling size bytes, each from where it was written. */
+static long long benchStrtod(size_t size, int iterations)
+{
+	std::vector<char> s;
+	std::vector<size_t> starts;
+	for (int i = 0; s.size() < size; i++) {
+		char number[32]; int n = snprintf(number, sizeof(number), "%d.%04de%d ", i * 37 % 10000, i * 7919 % 10000, i % 9 - 4);
+		starts.push_back(s.size());
+		s.insert(s.end(), number, number + n);
+	}
+	s.push_back(0);
+	double sink = 0;
+	long long started = benchClock();
+	for (int i = 0; i < iterations; i++)
+		for (size_t start : starts) sink += strtod_(s.data() + start, nullptr);
+	long long elapsed = benchClock() - started;
+	_benchSink = (size_t)sink;
+	return elapsed;
+}
+
+STDARG1void(benchAppendFormat, strbldAppendFormat(b, fmt, va), strbld_t *b, const char *fmt);
+
+/* Formats records into a builder over a fixed buffer until it holds size bytes. */
+static long long benchStrbld(size_t size, int iterations)
+{
+	std::vector<char> base(size + 64);
+	size_t sink = 0;
+	long long started = benchClock();
+	for (int i = 0; i < iterations; i++) {
+		strbld_t b;
+		strbldInit(&b, nullptr, base.data(), (int)base.size(), (int)base.size());
+		for (int j = 0; (size_t)b.index < size; j++) benchAppendFormat(&b, "%d:%s:%.3f;", j, "field", j * .5);
+		sink += b.index;
+	}
+	long long elapsed = benchClock() - started;
+	_benchSink = sink;
+	return elapsed;
+}
+
+/* Looks up each of size keys in turn, all present. */
+static long long benchHashFind(size_t size, int iterations)
+{
+	if (!size) size = 1;
+	std::vector<char> keys(size * 16);
+	hash_t h; hashInit(&h);
+	for (size_t i = 0; i < size; i++) { snprintf(&keys[i * 16], 16, "key%zu", i); hashInsert(&h, &keys[i * 16], &keys[i * 16]); }
+	size_t sink = 0;
+	long long started = benchClock();
+	for (int i = 0; i < iterations; i++) sink += (size_t)hashFind(&h, &keys[(size_t)i % size * 16]);
+	long long elapsed = benchClock() - started;
+	hashClear(&h);
+	_benchSink = sink;
+	return elapsed;
+}
+
+#define BENCH_MEMFILESIZE (1024 * 1024)
+
+/* Reads size bytes at a time through a file of BENCH_MEMFILESIZE, in order and wrapping. */
+static long long benchMemfileRead(size_t size, int iterations)
+{
+	size_t length = std::max(size, (size_t)BENCH_MEMFILESIZE);
+	std::vector<char> buf(std::max(size, (size_t)1), 0x5a);
+	memfile_t *f = (memfile_t *)malloc(__sizeofMemfile_t);
+	memfileOpen(f);
+	for (size_t offset = 0; offset < length; offset += buf.size()) memfileWrite(f, buf.data(), (int)std::min(buf.size(), length - offset), offset);
+	int64_t offset = 0;
+	long long started = benchClock();
+	for (int i = 0; i < iterations; i++) {
+		if (offset + (int64_t)size > (int64_t)length) offset = 0;
+		memfileRead(f, buf.data(), (int)size, offset);
+		offset += size;
+	}
+	long long elapsed = benchClock() - started;
+	memfileClose(f); free(f);
+	_benchSink = (size_t)buf[0];
+	return elapsed;
+}
+
+/* Appends size bytes, truncating once the file reaches BENCH_MEMFILESIZE; chunk allocation is part of the operation. */
+static long long benchMemfileWrite(size_t size, int iterations)
+{
+	std::vector<char> buf(std::max(size, (size_t)1), 0x5a);
+	memfile_t *f = (memfile_t *)malloc(__sizeofMemfile_t);
+	memfileOpen(f);
+	long long started = benchClock();
+	for (int i = 0; i < iterations; i++) {
+		int64_t offset = memfileGetFileSize(f);
+		if (offset >= BENCH_MEMFILESIZE) { memfileTruncate(f, 0); offset = 0; }
+		memfileWrite(f, buf.data(), (int)size, offset);
+	}
+	long long elapsed = benchClock() - started;
+	_benchSink = (size_t)memfileGetFileSize(f);
+	memfileClose(f); free(f);
+	return elapsed;
+}
+
+/* Takes a chunk of size bytes and gives it back. */
+static long long benchFallocGetChunk(size_t size, int iterations)
+{
+	cudaDeviceFallocHeap heap = cudaDeviceFallocHeapCreate(size, std::max(size, (size_t)1) * 64);
+	if (!heap.deviceHeap) { fprintf(stderr, "libcu_bench: falloc heap of %zu byte chunks failed\n", size); exit(1); }
+	fallocDeviceHeap *deviceHeap = (fallocDeviceHeap *)heap.deviceHeap;
+	size_t sink = 0;
+	long long started = benchClock();
+	for (int i = 0; i < iterations; i++) { void *obj = fallocGetChunk(deviceHeap); sink += (size_t)obj; fallocFreeChunk(obj, deviceHeap); }
+	long long elapsed = benchClock() - started;
+	cudaDeviceFallocHeapDestroy(heap);
+	_benchSink = sink;
+	return elapsed;
+}
+
+static const benchCase _benchCases[] = {
+	{ "strlen", benchStrlen, true },
+	{ "memcmp", benchMemcmp, true },
+	{ "strstr", benchStrstr, true },
+	{ "qsort", benchQsort, false },
+	{ "strtod", benchStrtod, true },
+	{ "strbld", benchStrbld, true },
+	{ "hashFind", benchHashFind, false },
+	{ "memfileRead", benchMemfileRead, true },
+	{ "memfileWrite", benchMemfileWrite, true },
+	{ "fallocGetChunk", benchFallocGetChunk, false },
+};
+
+#pragma endregion
+
+// RUN
+#pragma region RUN
+
+static const char *_benchFormat = "csv";
+static int _benchRows = 0;
+
+static void benchReport(const benchCase *c, size_t size, int iterations, std::vector<long long> &elapsed)
+{
+	std::sort(elapsed.begin(), elapsed.end());
+	double min = (double)elapsed.front() / iterations, median = (double)elapsed[elapsed.size() / 2] / iterations, max = (double)elapsed.back() / iterations;
+	double rate = median > 0 ? 1e9 / median : 0, mb = c->Bytes && median > 0 ? size * 1e3 / median : 0;
+	if (!strcmp(_benchFormat, "json"))
+		printf("%s  {\"bench\":\"%s\",\"size\":%zu,\"iterations\":%d,\"repetitions\":%d,\"min_ns\":%.3f,\"median_ns\":%.3f,\"max_ns\":%.3f,\"ops_per_s\":%.1f,\"mb_per_s\":%.3f}",
+			_benchRows ? ",\n" : "", c->Name, size, iterations, (int)elapsed.size(), min, median, max, rate, mb);
+	else
+		printf("%s,%zu,%d,%d,%.3f,%.3f,%.3f,%.1f,%.3f\n", c->Name, size, iterations, (int)elapsed.size(), min, median, max, rate, mb);
+	_benchRows++;
+	fflush(stdout);
+}
+
+/* Split a comma separated list of numbers. */
+static std::vector<long> benchList(const char *s)
+{
+	std::vector<long> values;
+	for (const char *p = s; *p; ) {
+		values.push_back(atol(p));
+		if (!(p = strchr(p, ','))) break;
+		p++;
+	}
+	return values;
+}
+
+/* Whether a comma separated list names item exactly, so strstr does not select str. */
+static bool benchListed(const char *s, const char *item)
+{
+	size_t n = strlen(item);
+	for (const char *p = s; p; p = strchr(p, ',') ? strchr(p, ',') + 1 : nullptr)
+		if (!strncmp(p, item, n) && (p[n] == ',' || !p[n])) return true;
+	return false;
+}
+
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+	std::vector<long> sizes = { 16, 256, 4096 };
+	int iterations = 1000, warmup = 100, repetitions = 5;
+	const char *benches = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 == argc) { fprintf(stderr, "libcu_bench: %s needs a value\n", argv[i]); return 1; }
+		if (!strcmp(argv[i], "-b")) benches = argv[++i];
+		else if (!strcmp(argv[i], "-s")) sizes = benchList(argv[++i]);
+		else if (!strcmp(argv[i], "-n")) iterations = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-w")) warmup = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-r")) repetitions = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-f")) _benchFormat = argv[++i];
+		else { fprintf(stderr, "usage: %s [-b strlen,memcmp,...] [-s 16,256,4096] [-n 1000] [-w 100] [-r 5] [-f csv|json]\n", argv[0]); return 1; }
+	}
+	if (iterations <= 0) iterations = 1;
+	if (repetitions <= 0) repetitions = 1;
+
+	if (!strcmp(_benchFormat, "json")) printf("[\n");
+	else printf("bench,size,iterations,repetitions,min_ns,median_ns,max_ns,ops_per_s,mb_per_s\n");
+	for (const benchCase &c : _benchCases) {
+		if (benches && !benchListed(benches, c.Name)) continue;
+		for (long size : sizes) {
+			if (size < 0) continue;
+			if (warmup > 0) c.Run((size_t)size, warmup);
+			std::vector<long long> elapsed(repetitions);
+			for (int r = 0; r < repetitions; r++) elapsed[r] = c.Run((size_t)size, iterations);
+			benchReport(&c, (size_t)size, iterations, elapsed);
+		}
+	}
+	if (!strcmp(_benchFormat, "json")) printf("\n]\n");
+	return 0;
+}
@@ -0,0 +1,378 @@
+#include <sentinel.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <vector>
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+// Host-only benchmark of the sentinel bus. Clients are threads of this process, copies of it started with -c that attach to the map
+// with sentinelClientInitialize, or threads posing as device threads through the emulator. They drive opcodes owned by the benchmark's
+// own executor, so nothing below the bus is measured.
+//
+// sentinel_bench [-t 1,4] [-p 2] [-d 4] [-g 1] [-n 10000] [-s 0,64,1024,3072] [-m sync,async,nowait] [-w workers] [-f csv|json]
+//
+// -g sets how many device maps the emulated device threads are routed across, one emulated block per thread.
+
+enum {
+	BENCH_WRITE = 120,
+	BENCH_READ,
+};
+
+#define BENCH_WINDOW 4 // tickets each async client keeps outstanding
+
+struct bench_write {
+	static char *Prepare(bench_write *t, char *data, char *dataEnd, intptr_t offset)
+	{
+		char *ptr = (char *)(data += _ROUND8(sizeof(*t)));
+		char *end = (char *)(data += t->Size);
+		if (end > dataEnd) return nullptr;
+		memcpy(ptr, t->Ptr, t->Size);
+		t->Ptr = ptr + offset;
+		return end;
+	}
+	sentinelMessage Base;
+	const void *Ptr; size_t Size;
+	bench_write(bool wait, const void *ptr, size_t size)
+		: Base(wait, BENCH_WRITE, (int)size, SENTINELPREPARE(Prepare)), Ptr(ptr), Size(size) { }
+	size_t RC;
+};
+
+struct bench_read {
+	static char *Prepare(bench_read *t, char *data, char *dataEnd, intptr_t offset)
+	{
+		char *ptr = (char *)(data += _ROUND8(sizeof(*t)));
+		char *end = (char *)(data += t->Size);
+		if (end > dataEnd) return nullptr;
+		t->Ptr = ptr + offset;
+		return end;
+	}
+	static void Complete(bench_read *t, char *data)
+	{
+		memcpy(t->Dest, data + _ROUND8(sizeof(*t)), t->RC);
+	}
+	sentinelMessage Base;
+	void *Ptr; size_t Size;
+	bench_read(void *dest, size_t size)
+		: Base(true, BENCH_READ, (int)size, SENTINELPREPARE(Prepare)), Ptr(nullptr), Size(size), Dest(dest) { }
+	size_t RC;
+	void *Dest;
+};
+
+static bool benchExecutor(void *tag, sentinelMessage *data, int length, char *(**hostPrepare)(void*,char*,char*,intptr_t))
+{
+	switch (data->OP) {
+	case BENCH_WRITE: { bench_write *msg = (bench_write *)data; msg->RC = msg->Size; return true; }
+	case BENCH_READ: { bench_read *msg = (bench_read *)data; memset(msg->Ptr, 0x5a, msg->Size); msg->RC = msg->Size; return true; }
+	}
+	return false;
+}
+
+static bool benchAffinity(void *tag, sentinelMessage *data, int length, intptr_t *key)
+{
+	*key = 0;
+	return data->OP == BENCH_WRITE || data->OP == BENCH_READ;
+}
+
+static sentinelExecutor _benchExecutor = { nullptr, "bench", benchExecutor, nullptr, benchAffinity };
+static sentinelExecutor _benchDeviceExecutor = { nullptr, "bench", benchExecutor, nullptr, benchAffinity }; // an executor sits on one list only
+
+static long long benchClock()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// CLIENT
+#pragma region CLIENT
+
+typedef struct benchTransport {
+	void (*Send)(sentinelMessage *, int);
+	void (*SendAsync)(sentinelMessage *, int, sentinelTicket *, void (*)(void*,char*));
+	void (*Wait)(sentinelTicket *);
+	int (*WaitAny)(sentinelTicket *, int);
+} benchTransport;
+
+static const benchTransport _benchHost = { sentinelClientSend, sentinelClientSendAsync, sentinelClientWait, sentinelClientWaitAny };
+static const benchTransport _benchDevice = { sentinelEmulatedSend, sentinelEmulatedSendAsync, sentinelEmulatedWait, sentinelEmulatedWaitAny };
+
+typedef struct benchRun {
+	const char *Transport; // thread or process on the host map, device on the emulated device maps
+	const char *Mode; // sync, async or nowait
+	const char *Op; // write or read
+	int Clients;
+	size_t Size;
+	int Iterations;
+} benchRun;
+
+/* Send run->Iterations messages, filling latencies with the nanoseconds each took from send to reply (to hand-off for nowait). */
+static void benchClient(const benchRun *run, long long *latencies)
+{
+	const benchTransport *bus = !strcmp(run->Transport, "device") ? &_benchDevice : &_benchHost;
+	bool read = !strcmp(run->Op, "read");
+	std::vector<char> buf(run->Size + 1, 0x33);
+	if (!strcmp(run->Mode, "async")) {
+		union { char Write[sizeof(bench_write)]; char Read[sizeof(bench_read)]; long long Align; } msgs[BENCH_WINDOW];
+		sentinelTicket tickets[BENCH_WINDOW];
+		memset(tickets, 0, sizeof(tickets));
+		std::vector<char> dest((size_t)BENCH_WINDOW * (run->Size + 1));
+		long long started[BENCH_WINDOW];
+		int sent = 0, done = 0;
+		for (int i = 0; done < run->Iterations; ) {
+			if (i < BENCH_WINDOW && sent < run->Iterations) {
+				started[i] = benchClock(); sent++;
+				if (read) { bench_read *msg = new (&msgs[i]) bench_read(&dest[i * (run->Size + 1)], run->Size); bus->SendAsync(&msg->Base, sizeof(bench_read), &tickets[i], SENTINELCOMPLETE(bench_read::Complete)); }
+				else { bench_write *msg = new (&msgs[i]) bench_write(true, buf.data(), run->Size); bus->SendAsync(&msg->Base, sizeof(bench_write), &tickets[i], nullptr); }
+				// fill the window first, then refill whichever ticket completes
+				i = sent < BENCH_WINDOW ? i + 1 : BENCH_WINDOW;
+				continue;
+			}
+			if ((i = bus->WaitAny(tickets, BENCH_WINDOW)) < 0) break;
+			latencies[done++] = benchClock() - started[i];
+		}
+		return;
+	}
+	bool wait = strcmp(run->Mode, "nowait") != 0;
+	for (int i = 0; i < run->Iterations; i++) {
+		long long started = benchClock();
+		if (read) { bench_read msg(buf.data(), run->Size); sentinelTicket ticket; bus->SendAsync(&msg.Base, sizeof(bench_read), &ticket, SENTINELCOMPLETE(bench_read::Complete)); bus->Wait(&ticket); }
+		else { bench_write msg(wait, buf.data(), run->Size); bus->Send(&msg.Base, sizeof(bench_write)); }
+		latencies[i] = benchClock() - started;
+	}
+	// a waited send drains the ring behind the fire-and-forget ones
+	if (!wait) { bench_write msg(true, buf.data(), 0); bus->Send(&msg.Base, sizeof(bench_write)); }
+}
+
+#pragma endregion
+
+// PROCESSES
+#pragma region PROCESSES
+
+#if !defined(_WIN32)
+typedef struct benchProcess {
+	pid_t Pid;
+	int In; // parent writes the start signal
+	int Out; // parent reads ready and the latencies
+} benchProcess;
+
+static bool benchReadAll(int fd, void *data, size_t size)
+{
+	for (char *p = (char *)data; size; ) {
+		ssize_t n = read(fd, p, size);
+		if (n <= 0) return false;
+		p += n; size -= n;
+	}
+	return true;
+}
+
+static bool benchSpawn(benchProcess *p, char **args)
+{
+	int in[2], out[2];
+	if (pipe(in) || pipe(out)) return false;
+	if ((p->Pid = fork()) < 0) return false;
+	if (!p->Pid) {
+		dup2(in[0], 0); dup2(out[1], 1);
+		close(in[0]); close(in[1]); close(out[0]); close(out[1]);
+		execv(args[0], args);
+		_exit(127);
+	}
+	close(in[0]); close(out[1]);
+	p->In = in[1]; p->Out = out[0];
+	return true;
+}
+
+/* Entry point of a client started with -c: attach, report ready, wait for the start signal, then send and write back the latencies. */
+static int benchChild(char **argv)
+{
+	benchRun run = { "process", argv[1], argv[2], 1, (size_t)atol(argv[3]), atoi(argv[4]) };
+	sentinelClientInitialize(argv[0]);
+	std::vector<long long> latencies(run.Iterations);
+	char c = 'r';
+	if (write(1, &c, 1) != 1 || !benchReadAll(0, &c, 1)) return 1;
+	benchClient(&run, latencies.data());
+	bool ok = write(1, latencies.data(), latencies.size() * sizeof(long long)) == (ssize_t)(latencies.size() * sizeof(long long));
+	sentinelClientShutdown();
+	return ok ? 0 : 1;
+}
+#endif
+
+#pragma endregion
+
+// RUN
+#pragma region RUN
+
+static const char *_benchFormat = "csv";
+static const char *_benchSelf;
+static char _benchMapName[64];
+static int _benchRows = 0;
+
+static double benchPercentile(const std::vector<long long> &sorted, double pct)
+{
+	if (sorted.empty()) return 0;
+	size_t i = (size_t)(pct * (sorted.size() - 1) + .5);
+	return sorted[i] / 1000.0;
+}
+
+static void benchReport(const benchRun *run, std::vector<long long> &latencies, long long elapsed)
+{
+	std::sort(latencies.begin(), latencies.end());
+	double seconds = elapsed / 1e9, messages = (double)latencies.size();
+	double rate = seconds > 0 ? messages / seconds : 0, mb = seconds > 0 ? messages * run->Size / seconds / 1e6 : 0;
+	double p50 = benchPercentile(latencies, .5), p90 = benchPercentile(latencies, .9), p99 = benchPercentile(latencies, .99), p999 = benchPercentile(latencies, .999), max = benchPercentile(latencies, 1);
+	if (!strcmp(_benchFormat, "json"))
+		printf("%s  {\"transport\":\"%s\",\"mode\":\"%s\",\"op\":\"%s\",\"clients\":%d,\"size\":%zu,\"messages\":%.0f,\"seconds\":%.6f,\"msgs_per_s\":%.1f,\"mb_per_s\":%.3f,\"p50_us\":%.3f,\"p90_us\":%.3f,\"p99_us\":%.3f,\"p999_us\":%.3f,\"max_us\":%.3f}",
+			_benchRows ? ",\n" : "", run->Transport, run->Mode, run->Op, run->Clients, run->Size, messages, seconds, rate, mb, p50, p90, p99, p999, max);
+	else
+		printf("%s,%s,%s,%d,%zu,%.0f,%.6f,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+			run->Transport, run->Mode, run->Op, run->Clients, run->Size, messages, seconds, rate, mb, p50, p90, p99, p999, max);
+	_benchRows++;
+	fflush(stdout);
+}
+
+static void benchThreads(const benchRun *run)
+{
+	std::vector<long long> latencies((size_t)run->Clients * run->Iterations);
+	std::vector<std::thread> threads;
+	long long started = benchClock();
+	for (int i = 0; i < run->Clients; i++)
+		threads.emplace_back(benchClient, run, latencies.data() + (size_t)i * run->Iterations);
+	for (auto &t : threads) t.join();
+	benchReport(run, latencies, benchClock() - started);
+}
+
+static void benchProcesses(const benchRun *run)
+{
+#if !defined(_WIN32)
+	char size[32], iterations[32];
+	snprintf(size, sizeof(size), "%zu", run->Size);
+	snprintf(iterations, sizeof(iterations), "%d", run->Iterations);
+	char *args[] = { (char *)_benchSelf, (char *)"-c", _benchMapName, (char *)run->Mode, (char *)run->Op, size, iterations, nullptr };
+	std::vector<benchProcess> procs(run->Clients);
+	std::vector<long long> latencies((size_t)run->Clients * run->Iterations);
+	char c;
+	bool ok = true;
+	for (int i = 0; i < run->Clients; i++)
+		if (!benchSpawn(&procs[i], args) || !benchReadAll(procs[i].Out, &c, 1)) { fprintf(stderr, "sentinel_bench: client process %d failed to start\n", i); exit(1); }
+	long long started = benchClock();
+	for (int i = 0; i < run->Clients; i++)
+		ok &= write(procs[i].In, "g", 1) == 1;
+	for (int i = 0; i < run->Clients; i++)
+		ok &= benchReadAll(procs[i].Out, latencies.data() + (size_t)i * run->Iterations, run->Iterations * sizeof(long long));
+	long long elapsed = benchClock() - started;
+	for (int i = 0; i < run->Clients; i++) {
+		int status;
+		close(procs[i].In); close(procs[i].Out);
+		waitpid(procs[i].Pid, &status, 0);
+		ok &= WIFEXITED(status) && !WEXITSTATUS(status);
+	}
+	if (!ok) { fprintf(stderr, "sentinel_bench: client processes failed\n"); exit(1); }
+	benchReport(run, latencies, elapsed);
+#endif
+}
+
+/* Split a comma separated list of numbers. */
+static std::vector<long> benchList(const char *s)
+{
+	std::vector<long> values;
+	for (const char *p = s; *p; ) {
+		values.push_back(atol(p));
+		if (!(p = strchr(p, ','))) break;
+		p++;
+	}
+	return values;
+}
+
+/* Whether a comma separated list names item exactly, so async does not select sync. */
+static bool benchListed(const char *s, const char *item)
+{
+	size_t n = strlen(item);
+	for (const char *p = s; p; p = strchr(p, ',') ? strchr(p, ',') + 1 : nullptr)
+		if (!strncmp(p, item, n) && (p[n] == ',' || !p[n])) return true;
+	return false;
+}
+
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+#if !defined(_WIN32)
+	if (argc == 7 && !strcmp(argv[1], "-c"))
+		return benchChild(argv + 2);
+#endif
+	std::vector<long> threads = { 1, 4 }, devices = { 4 }, sizes = { 0, 64, 1024, 3072 };
+	int processes = 2, iterations = 10000, workers = SENTINEL_WORKERS, maps = 1;
+	const char *modes = "sync,async,nowait";
+	for (int i = 1; i < argc; i++) {
+		if (i + 1 == argc) { fprintf(stderr, "sentinel_bench: %s needs a value\n", argv[i]); return 1; }
+		if (!strcmp(argv[i], "-t")) threads = benchList(argv[++i]);
+		else if (!strcmp(argv[i], "-p")) processes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-d")) devices = benchList(argv[++i]);
+		else if (!strcmp(argv[i], "-g")) maps = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-n")) iterations = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-s")) sizes = benchList(argv[++i]);
+		else if (!strcmp(argv[i], "-m")) modes = argv[++i];
+		else if (!strcmp(argv[i], "-w")) workers = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-f")) _benchFormat = argv[++i];
+		else { fprintf(stderr, "usage: %s [-t 1,4] [-p 2] [-d 4] [-g 1] [-n 10000] [-s 0,64,1024,3072] [-m sync,async,nowait] [-w workers] [-f csv|json]\n", argv[0]); return 1; }
+	}
+	if (iterations <= 0) iterations = 1;
+#if defined(__linux__)
+	_benchSelf = "/proc/self/exe";
+#else
+	_benchSelf = argv[0];
+#endif
+#if defined(_WIN32)
+	if (processes) { fprintf(stderr, "sentinel_bench: process clients are not supported on Windows\n"); processes = 0; }
+#endif
+
+	// the slot holds the command header, the message and its payload
+	size_t maxSize = SENTINEL_MSGSIZE - offsetof(sentinelCommand, Data) - _ROUND8(std::max(sizeof(bench_write), sizeof(bench_read)));
+	snprintf(_benchMapName, sizeof(_benchMapName), "SentinelBench%d", (int)getpid());
+	sentinelServerInitialize(nullptr, _benchMapName, true, false, workers, maps);
+	sentinelRegisterExecutor(&_benchExecutor, true, false);
+	sentinelRegisterExecutorOps(&_benchExecutor, BENCH_WRITE, BENCH_READ, false);
+	// the emulator drains its maps through the device executors
+	bool emulated = devices.size() && devices[0] > 0;
+	if (emulated && !sentinelEmulatorInitialize()) { fprintf(stderr, "sentinel_bench: device emulator failed to start\n"); emulated = false; }
+	sentinelRegisterExecutor(&_benchDeviceExecutor, true, true);
+	sentinelRegisterExecutorOps(&_benchDeviceExecutor, BENCH_WRITE, BENCH_READ, true);
+
+	if (!strcmp(_benchFormat, "json")) printf("[\n");
+	else printf("transport,mode,op,clients,size,messages,seconds,msgs_per_s,mb_per_s,p50_us,p90_us,p99_us,p999_us,max_us\n");
+	const char *allModes[] = { "sync", "async", "nowait" }, *ops[] = { "write", "read" };
+	for (const char *mode : allModes) {
+		if (!benchListed(modes, mode)) continue;
+		for (const char *op : ops) {
+			// a read needs its reply
+			if (!strcmp(mode, "nowait") && !strcmp(op, "read")) continue;
+			for (long size : sizes) {
+				if (size < 0 || (size_t)size > maxSize) { fprintf(stderr, "sentinel_bench: size %ld skipped, a slot carries at most %zu\n", size, maxSize); continue; }
+				for (long clients : threads) {
+					if (clients <= 0) continue;
+					benchRun run = { "thread", mode, op, (int)clients, (size_t)size, iterations };
+					benchThreads(&run);
+				}
+				if (processes > 0) {
+					benchRun run = { "process", mode, op, processes, (size_t)size, iterations };
+					benchProcesses(&run);
+				}
+				for (long clients : devices) {
+					if (!emulated || clients <= 0) continue;
+					benchRun run = { "device", mode, op, (int)clients, (size_t)size, iterations };
+					benchThreads(&run);
+				}
+			}
+		}
+	}
+	if (!strcmp(_benchFormat, "json")) printf("\n]\n");
+	sentinelServerShutdown();
+	return 0;
+}
@@ -0,0 +1,258 @@
+// the tree containers go first, crtdefscu.h claims __R as a macro
+#include <map>
+#include <set>
+#include <tuple>
+#include <sentinel.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <thread>
+#include <vector>
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+// Replays a trace written by sentinelTraceStart (or SENTINEL_TRACE) against a server of its own. Each recorded sender becomes a thread
+// re-issuing its commands in order, through the host client for host map records and through the emulator for device map records. The
+// messages stand in for the recorded ones: same opcode, length, payload and wait, but owned by the replay executor, which takes every
+// opcode and with -x holds each for its recorded execution time. Transports and executors can so be compared on the same traffic
+// without repeating its I/O. -l lists the trace by sender and opcode instead, busiest first.
+//
+// sentinel_replay trace [-r speed] [-x] [-w workers] [-f csv|json] [-l]
+
+#define REPLAY_THREADS 64 // senders beyond this share threads, each keeping its own order
+
+struct replay_msg {
+	static char *Prepare(replay_msg *t, char *data, char *dataEnd, intptr_t offset)
+	{
+		// stand in for the payload copy of the recorded message
+		char *ptr = data + _ROUND8(t->Length);
+		if (ptr < dataEnd) memset(ptr, 0x5a, dataEnd - ptr);
+		return dataEnd;
+	}
+	sentinelMessage Base;
+	int Length; // recorded message length, the message sent is never shorter than this struct
+	int Sender;
+	long long ExecNs;
+	replay_msg(bool wait, char op, int size, int length, int sender, long long execNs)
+		: Base(wait, op, size, SENTINELPREPARE(Prepare)), Length(length), Sender(sender), ExecNs(execNs) { }
+};
+
+static bool _replayExec = false;
+
+static long long replayClock()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool replayExecutor(void *tag, sentinelMessage *data, int length, char *(**hostPrepare)(void*,char*,char*,intptr_t))
+{
+	if (length < (int)sizeof(replay_msg)) return false;
+	replay_msg *msg = (replay_msg *)data;
+	if (_replayExec && msg->ExecNs > 0)
+		for (long long until = replayClock() + msg->ExecNs; replayClock() < until; ) { }
+	return true;
+}
+
+static bool replayAffinity(void *tag, sentinelMessage *data, int length, intptr_t *key)
+{
+	// a sender's commands stay in order, as the executor that first ran them is likely to have kept them
+	if (length < (int)sizeof(replay_msg)) return false;
+	*key = ((replay_msg *)data)->Sender + 1;
+	return true;
+}
+
+static sentinelExecutor _replayExecutor = { nullptr, "replay", replayExecutor, nullptr, replayAffinity };
+static sentinelExecutor _replayDeviceExecutor = { nullptr, "replay", replayExecutor, nullptr, replayAffinity }; // an executor sits on one list only
+
+// TRACE
+#pragma region TRACE
+
+static bool replayLoad(const char *path, std::vector<sentinelTraceRecord> &records)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) { fprintf(stderr, "sentinel_replay: cannot open %s\n", path); return false; }
+	sentinelTraceHeader header;
+	if (fread(&header, sizeof(header), 1, f) != 1 || header.Magic != SENTINEL_TRACEMAGIC || header.Version != SENTINEL_TRACEVERSION || header.RecordSize != (int)sizeof(sentinelTraceRecord)) {
+		fprintf(stderr, "sentinel_replay: %s is not a version %d sentinel trace\n", path, SENTINEL_TRACEVERSION);
+		fclose(f);
+		return false;
+	}
+	if (header.SlotSize != SENTINEL_MSGSIZE)
+		fprintf(stderr, "sentinel_replay: trace slots are %d bytes, ours are %d, payloads are clipped to fit\n", header.SlotSize, SENTINEL_MSGSIZE);
+	sentinelTraceRecord r;
+	while (fread(&r, sizeof(r), 1, f) == 1) records.push_back(r);
+	fclose(f);
+	// records land as commands finish, replay wants them as they were claimed
+	std::stable_sort(records.begin(), records.end(), [](const sentinelTraceRecord &a, const sentinelTraceRecord &b) { return a.Claimed < b.Claimed; });
+	return true;
+}
+
+/* Slot bytes a record carried, its message plus the payload reserved behind it. */
+static int replayBytes(const sentinelTraceRecord *r)
+{
+	return std::min(r->Length + std::max(r->Size, 0), SENTINEL_MSGSIZE - (int)offsetof(sentinelCommand, Data));
+}
+
+/* Print one row per sender and opcode, busiest first, with how many distinct requests it made. */
+static void replayList(const std::vector<sentinelTraceRecord> &records, const char *format)
+{
+	typedef std::tuple<int, int, int, int> key; // map, block, thread, op
+	struct row { long long Count, Bytes, ExecNs; std::set<unsigned int> Digests; };
+	std::map<key, row> rows;
+	for (const sentinelTraceRecord &r : records) {
+		row &w = rows[key(r.Map, r.Block, r.Thread, r.OP)];
+		w.Count++; w.Bytes += replayBytes(&r); w.ExecNs += r.Finished - r.Started;
+		w.Digests.insert(r.Digest);
+	}
+	std::vector<std::pair<key, row *>> sorted;
+	for (auto &i : rows) sorted.push_back(std::make_pair(i.first, &i.second));
+	std::stable_sort(sorted.begin(), sorted.end(), [](const std::pair<key, row *> &a, const std::pair<key, row *> &b) { return a.second->Count > b.second->Count; });
+	bool json = !strcmp(format, "json");
+	if (json) printf("[\n");
+	else printf("map,block,thread,op,commands,bytes,distinct,exec_us\n");
+	for (size_t i = 0; i < sorted.size(); i++) {
+		const key &k = sorted[i].first; row *w = sorted[i].second;
+		if (json) printf("%s  {\"map\":%d,\"block\":%d,\"thread\":%d,\"op\":%d,\"commands\":%lld,\"bytes\":%lld,\"distinct\":%zu,\"exec_us\":%.3f}", i ? ",\n" : "",
+			std::get<0>(k), std::get<1>(k), std::get<2>(k), std::get<3>(k), w->Count, w->Bytes, w->Digests.size(), w->ExecNs / 1000.0);
+		else printf("%d,%d,%d,%d,%lld,%lld,%zu,%.3f\n", std::get<0>(k), std::get<1>(k), std::get<2>(k), std::get<3>(k), w->Count, w->Bytes, w->Digests.size(), w->ExecNs / 1000.0);
+	}
+	if (json) printf("\n]\n");
+}
+
+#pragma endregion
+
+// REPLAY
+#pragma region REPLAY
+
+typedef struct replaySender {
+	std::vector<const sentinelTraceRecord *> Records;
+	std::vector<long long> Latencies;
+} replaySender;
+
+static const char *_replayFormat = "csv";
+static int _replayRows = 0;
+static bool _replayEmulated = false;
+
+/* Re-issue one thread's share of the trace, paced against the recording unless speed is 0. */
+static void replayThread(replaySender *sender, int index, long long first, long long started, double speed)
+{
+	alignas(8) char buf[SENTINEL_MSGSIZE];
+	for (const sentinelTraceRecord *r : sender->Records) {
+		if (speed > 0)
+			for (long long due = started + (long long)((r->Claimed - first) / speed); replayClock() < due; ) std::this_thread::yield();
+		int length = std::min(std::max(r->Length, (int)sizeof(replay_msg)), (int)sizeof(buf));
+		memset(buf, 0, length);
+		replay_msg *msg = new (buf) replay_msg(r->Wait != 0, (char)r->OP, std::max(r->Size, 0), r->Length, index, r->Finished - r->Started);
+		msg->Base.Lane = (signed char)r->Lane;
+		long long sent = replayClock();
+		// posing as the recorded block routes the command back onto its recorded map
+		if (r->Map >= 0 && _replayEmulated) { sentinelEmulatedSetBlock(r->Block); sentinelEmulatedSend(&msg->Base, length); }
+		else sentinelClientSend(&msg->Base, length);
+		sender->Latencies.push_back(replayClock() - sent);
+	}
+	// a waited send down each lane drains the rings behind the fire-and-forget ones
+	if (sender->Records.size() && !sender->Records.back()->Wait)
+		for (int lane = 0; lane < SENTINEL_LANES; lane++) {
+			const sentinelTraceRecord *r = sender->Records.back();
+			replay_msg msg(true, (char)r->OP, 0, (int)sizeof(replay_msg), index, 0);
+			msg.Base.Lane = (signed char)lane;
+			if (r->Map >= 0 && _replayEmulated) sentinelEmulatedSend(&msg.Base, sizeof(replay_msg));
+			else sentinelClientSend(&msg.Base, sizeof(replay_msg));
+		}
+}
+
+static double replayPercentile(const std::vector<long long> &sorted, double pct)
+{
+	if (sorted.empty()) return 0;
+	size_t i = (size_t)(pct * (sorted.size() - 1) + .5);
+	return sorted[i] / 1000.0;
+}
+
+static void replayReport(const char *run, int senders, std::vector<long long> &latencies, long long bytes, long long elapsed)
+{
+	std::sort(latencies.begin(), latencies.end());
+	double seconds = elapsed / 1e9, messages = (double)latencies.size();
+	double rate = seconds > 0 ? messages / seconds : 0, mb = seconds > 0 ? bytes / seconds / 1e6 : 0;
+	double p50 = replayPercentile(latencies, .5), p90 = replayPercentile(latencies, .9), p99 = replayPercentile(latencies, .99), p999 = replayPercentile(latencies, .999), max = replayPercentile(latencies, 1);
+	if (!strcmp(_replayFormat, "json"))
+		printf("%s  {\"run\":\"%s\",\"senders\":%d,\"messages\":%.0f,\"bytes\":%lld,\"seconds\":%.6f,\"msgs_per_s\":%.1f,\"mb_per_s\":%.3f,\"p50_us\":%.3f,\"p90_us\":%.3f,\"p99_us\":%.3f,\"p999_us\":%.3f,\"max_us\":%.3f}",
+			_replayRows ? ",\n" : "", run, senders, messages, bytes, seconds, rate, mb, p50, p90, p99, p999, max);
+	else
+		printf("%s,%d,%.0f,%lld,%.6f,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", run, senders, messages, bytes, seconds, rate, mb, p50, p90, p99, p999, max);
+	_replayRows++;
+	fflush(stdout);
+}
+
+#pragma endregion
+
+int main(int argc, char **argv)
+{
+	const char *path = nullptr;
+	double speed = 0;
+	int workers = SENTINEL_WORKERS;
+	bool list = false;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-x")) { _replayExec = true; continue; }
+		if (!strcmp(argv[i], "-l")) { list = true; continue; }
+		if (argv[i][0] != '-') { path = argv[i]; continue; }
+		if (i + 1 == argc) { fprintf(stderr, "sentinel_replay: %s needs a value\n", argv[i]); return 1; }
+		if (!strcmp(argv[i], "-r")) speed = atof(argv[++i]);
+		else if (!strcmp(argv[i], "-w")) workers = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-f")) _replayFormat = argv[++i];
+		else { path = nullptr; break; }
+	}
+	if (!path) { fprintf(stderr, "usage: %s trace [-r speed] [-x] [-w workers] [-f csv|json] [-l]\n", argv[0]); return 1; }
+	std::vector<sentinelTraceRecord> records;
+	if (!replayLoad(path, records)) return 1;
+	if (list) { replayList(records, _replayFormat); return 0; }
+
+	// one sender per recorded block and thread of each map
+	std::map<std::tuple<int, int, int>, int> ids;
+	for (const sentinelTraceRecord &r : records)
+		ids.insert(std::make_pair(std::make_tuple(r.Map < 0 ? -1 : (int)r.Map, r.Block, r.Thread), (int)ids.size()));
+	std::vector<replaySender> senders(std::min((int)ids.size(), REPLAY_THREADS));
+	long long recordedBytes = 0;
+	std::vector<long long> recorded;
+	for (const sentinelTraceRecord &r : records) {
+		senders[ids[std::make_tuple(r.Map < 0 ? -1 : (int)r.Map, r.Block, r.Thread)] % REPLAY_THREADS].Records.push_back(&r);
+		recorded.push_back(r.Finished - r.Claimed);
+		recordedBytes += replayBytes(&r);
+	}
+
+	char mapName[64];
+	snprintf(mapName, sizeof(mapName), "SentinelReplay%d", (int)getpid());
+	int maps = 1;
+	for (const sentinelTraceRecord &r : records) maps = std::max(maps, r.Map + 1);
+	sentinelServerInitialize(nullptr, mapName, true, false, workers, maps);
+	sentinelRegisterExecutor(&_replayExecutor, true, false);
+	sentinelRegisterExecutorOps(&_replayExecutor, 0, SENTINEL_OPCOUNT - 1, false);
+	bool device = std::any_of(records.begin(), records.end(), [](const sentinelTraceRecord &r) { return r.Map >= 0; });
+	if (device && !(_replayEmulated = sentinelEmulatorInitialize()))
+		fprintf(stderr, "sentinel_replay: device emulator failed to start, device records go through the host map\n");
+	sentinelRegisterExecutor(&_replayDeviceExecutor, true, true);
+	sentinelRegisterExecutorOps(&_replayDeviceExecutor, 0, SENTINEL_OPCOUNT - 1, true);
+
+	if (!strcmp(_replayFormat, "json")) printf("[\n");
+	else printf("run,senders,messages,bytes,seconds,msgs_per_s,mb_per_s,p50_us,p90_us,p99_us,p999_us,max_us\n");
+	// the recording's latencies run from claim to finish on the server, the replay's from send to reply on the client
+	replayReport("recorded", (int)ids.size(), recorded, recordedBytes, records.empty() ? 0 : records.back().Finished - records.front().Claimed);
+	std::vector<std::thread> threads;
+	long long first = records.empty() ? 0 : records.front().Claimed, started = replayClock();
+	for (size_t i = 0; i < senders.size(); i++)
+		threads.emplace_back(replayThread, &senders[i], (int)i, first, started, speed);
+	for (auto &t : threads) t.join();
+	long long elapsed = replayClock() - started;
+	std::vector<long long> latencies;
+	for (replaySender &s : senders) latencies.insert(latencies.end(), s.Latencies.begin(), s.Latencies.end());
+	replayReport("replay", (int)ids.size(), latencies, recordedBytes, elapsed);
+	if (!strcmp(_replayFormat, "json")) printf("\n]\n");
+	sentinelServerShutdown();
+	return 0;
+}
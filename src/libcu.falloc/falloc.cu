@@ -93,7 +93,7 @@ extern "C" cudaDeviceFallocHeap cudaDeviceFallocHeapCreate(size_t chunkSize, siz
 		writeChunkRefHost(r, (fallocChunkHeader *)chunk);
 	// transfer to heap
 	*error = cudaMemcpy(hostDeviceHeap.chunkRefs, hostChunkRefs, sizeof(fallocChunkRef) * chunks, cudaMemcpyHostToDevice);
-	delete hostChunkRefs;
+	delete[] hostChunkRefs;
 	if (*error != cudaSuccess)
 		return heap;
 	// return the heap
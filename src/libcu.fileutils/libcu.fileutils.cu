@@ -15,10 +15,12 @@
 #include "drmdir.cuh"
 #include "dpwd.cuh"
 #include "dcd.cuh"
+#include "sentinel-fileutilsmsg.h"
 
 bool sentinelFileUtilsExecutor(void *tag, sentinelMessage *data, int length, char *(**hostPrepare)(void*,char*,char*,intptr_t));
 static sentinelExecutor _fileUtilsExecutor = { nullptr, "fileutils", sentinelFileUtilsExecutor, nullptr };
 void sentinelRegisterFileUtils()
 {
 	sentinelRegisterExecutor(&_fileUtilsExecutor, true, false);
+	sentinelRegisterExecutorOps(&_fileUtilsExecutor, FILEUTILS_DCAT, FILEUTILS_DCD, false);
 }
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include <cuda_runtime.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// BUILTINS
+#pragma region BUILTINS
+
+thread_local uint3 threadIdx = { 0, 0, 0 };
+thread_local uint3 blockIdx = { 0, 0, 0 };
+thread_local dim3 blockDim;
+thread_local dim3 gridDim;
+
+/* The threads running one block, hostLaunch's team. Blocks are handed over through the same barrier __syncthreads waits on. */
+struct hostTeam {
+	std::mutex Lock;
+	std::condition_variable Arrived;
+	int Size, Waiting = 0;
+	unsigned int Phase = 0;
+	int Block = -1; // block the team runs, -1 once the grid is done
+	int Shared = 0; // threads of the team inside a __shared__ scope, guarded by _sharedLock
+	void Sync()
+	{
+		std::unique_lock<std::mutex> lock(Lock);
+		unsigned int phase = Phase;
+		if (++Waiting == Size) { Waiting = 0; Phase++; Arrived.notify_all(); return; }
+		Arrived.wait(lock, [&]() { return Phase != phase; });
+	}
+};
+static thread_local hostTeam *_hostTeam = nullptr;
+
+/* A thread outside a launch, or a lone one, has no one to wait for. */
+extern "C" void __syncthreads()
+{
+	if (_hostTeam && _hostTeam->Size > 1) _hostTeam->Sync();
+}
+
+/* __shared__ variables are static, one copy for all blocks. The first thread of a team to reach one takes them for the team, the last of
+** its threads to leave the scope gives them up, and other teams wait in between; a block's threads all pass the declaration before the
+** __syncthreads that publishes what it holds, so none leaves while another has yet to arrive. */
+static std::mutex _sharedLock;
+static std::condition_variable _sharedFree;
+static hostTeam *_sharedOwner = nullptr;
+
+hostSharedScope::hostSharedScope()
+{
+	hostTeam *team = _hostTeam;
+	if (!team) return;
+	std::unique_lock<std::mutex> lock(_sharedLock);
+	// another thread of the team may take them while this one waits
+	_sharedFree.wait(lock, [team]() { return !_sharedOwner || _sharedOwner == team; });
+	_sharedOwner = team;
+	team->Shared++;
+}
+
+hostSharedScope::~hostSharedScope()
+{
+	hostTeam *team = _hostTeam;
+	if (!team) return;
+	std::lock_guard<std::mutex> lock(_sharedLock);
+	if (!--team->Shared) { _sharedOwner = nullptr; _sharedFree.notify_all(); }
+}
+
+#pragma endregion
+
+// RUNTIME
+#pragma region RUNTIME
+
+static thread_local cudaError_t _lastError = cudaSuccess;
+static __forceinline cudaError_t cudaSetLastError(cudaError_t error) { if (error != cudaSuccess) _lastError = error; return error; }
+
+extern "C" const char *cudaGetErrorString(cudaError_t error)
+{
+	switch (error) {
+	case cudaSuccess: return "no error";
+	case cudaErrorMemoryAllocation: return "out of memory";
+	case cudaErrorInvalidValue: return "invalid argument";
+	default: return "unknown error";
+	}
+}
+extern "C" cudaError_t cudaGetLastError() { cudaError_t error = _lastError; _lastError = cudaSuccess; return error; }
+extern "C" cudaError_t cudaPeekAtLastError() { return _lastError; }
+
+extern "C" cudaError_t cudaGetDeviceCount(int *count) { *count = 1; return cudaSuccess; }
+extern "C" cudaError_t cudaGetDeviceProperties(struct cudaDeviceProp *prop, int device)
+{
+	if (device) return cudaSetLastError(cudaErrorInvalidValue);
+	memset(prop, 0, sizeof(*prop));
+	strcpy(prop->name, "libcu.host");
+	prop->major = prop->minor = 9999; // as the emulation device reports itself
+	prop->multiProcessorCount = 1;
+	prop->computeMode = cudaComputeModeDefault;
+	return cudaSuccess;
+}
+extern "C" cudaError_t cudaSetDevice(int device) { return device ? cudaSetLastError(cudaErrorInvalidValue) : cudaSuccess; }
+extern "C" cudaError_t cudaDeviceSetLimit(enum cudaLimit limit, size_t value) { return cudaSuccess; }
+extern "C" cudaError_t cudaDeviceReset() { return cudaSuccess; }
+extern "C" cudaError_t cudaDeviceSynchronize() { return cudaSuccess; }
+
+extern "C" cudaError_t cudaMalloc(void **devPtr, size_t size)
+{
+	if (!(*devPtr = malloc(size ? size : 1))) return cudaSetLastError(cudaErrorMemoryAllocation);
+	return cudaSuccess;
+}
+extern "C" cudaError_t cudaFree(void *devPtr) { free(devPtr); return cudaSuccess; }
+extern "C" cudaError_t cudaHostAlloc(void **pHost, size_t size, unsigned int flags) { return cudaMalloc(pHost, size); }
+extern "C" cudaError_t cudaFreeHost(void *ptr) { free(ptr); return cudaSuccess; }
+extern "C" cudaError_t cudaHostGetDevicePointer(void **pDevice, void *pHost, unsigned int flags) { *pDevice = pHost; return cudaSuccess; }
+extern "C" cudaError_t cudaMemcpy(void *dst, const void *src, size_t count, enum cudaMemcpyKind kind) { memmove(dst, src, count); return cudaSuccess; }
+extern "C" cudaError_t cudaMemset(void *devPtr, int value, size_t count) { memset(devPtr, value, count); return cudaSuccess; }
+
+struct cudaEventHost { long long time; };
+extern "C" cudaError_t cudaEventCreate(cudaEvent_t *event)
+{
+	if (!(*event = (cudaEvent_t)malloc(sizeof(cudaEventHost)))) return cudaSetLastError(cudaErrorMemoryAllocation);
+	(*event)->time = 0;
+	return cudaSuccess;
+}
+extern "C" cudaError_t cudaEventDestroy(cudaEvent_t event) { free(event); return cudaSuccess; }
+extern "C" cudaError_t cudaEventRecord(cudaEvent_t event, cudaStream_t stream) { event->time = clock64(); return cudaSuccess; }
+extern "C" cudaError_t cudaEventSynchronize(cudaEvent_t event) { return cudaSuccess; }
+extern "C" cudaError_t cudaEventElapsedTime(float *ms, cudaEvent_t start, cudaEvent_t end) { *ms = (float)(end->time - start->time) / 1000000.0f; return cudaSuccess; }
+
+#pragma endregion
+
+// LAUNCH
+#pragma region LAUNCH
+
+static int _hostWorkers = -1;
+
+void cudaHostSetWorkers(int workers) { _hostWorkers = workers < 0 ? 0 : workers; }
+
+/* The blocks of a launch, dealt round robin over one deque per team. A team takes from the front of its own and steals from the back of
+** the others, so a team whose blocks run long is relieved by the rest. */
+struct hostGrid {
+	std::vector<std::deque<int>> Blocks;
+	std::vector<std::mutex> Locks;
+	hostGrid(int teams, int blocks) : Blocks(teams), Locks(teams) { for (int i = 0; i < blocks; i++) Blocks[i % teams].push_back(i); }
+	int Next(int team)
+	{
+		int teams = (int)Blocks.size();
+		for (int i = 0; i < teams; i++) {
+			int t = (team + i) % teams;
+			std::lock_guard<std::mutex> lock(Locks[t]);
+			if (Blocks[t].empty()) continue;
+			int block;
+			if (!i) { block = Blocks[t].front(); Blocks[t].pop_front(); }
+			else { block = Blocks[t].back(); Blocks[t].pop_back(); }
+			return block;
+		}
+		return -1;
+	}
+};
+
+/* One thread of a team: the first takes each block off the grid and the barrier hands it to the others, then all run it. */
+static void hostThread(hostGrid *grid, hostTeam *team, int teamId, int thread, dim3 gridShape, dim3 blockShape, void (*run)(void *), void *arg)
+{
+	_hostTeam = team;
+	gridDim = gridShape; blockDim = blockShape;
+	threadIdx.x = thread % blockShape.x; threadIdx.y = thread / blockShape.x % blockShape.y; threadIdx.z = thread / (blockShape.x * blockShape.y);
+	while (true) {
+		if (!thread) team->Block = grid->Next(teamId);
+		team->Sync();
+		int block = team->Block;
+		if (block < 0) break;
+		blockIdx.x = block % gridShape.x; blockIdx.y = block / gridShape.x % gridShape.y; blockIdx.z = block / (gridShape.x * gridShape.y);
+		run(arg);
+		team->Sync(); // the block is done before the next is taken
+	}
+	_hostTeam = nullptr;
+	threadIdx = blockIdx = uint3();
+	gridDim = blockDim = dim3();
+}
+
+cudaError_t cudaHostLaunch(dim3 gridShape, dim3 blockShape, void (*run)(void *), void *arg)
+{
+	int blocks = (int)(gridShape.x * gridShape.y * gridShape.z), threads = (int)(blockShape.x * blockShape.y * blockShape.z);
+	if (blocks <= 0 || threads <= 0) return cudaSetLastError(cudaErrorInvalidValue);
+	if (_hostWorkers < 0) { const char *workers = getenv("LIBCU_HOSTWORKERS"); _hostWorkers = workers ? atoi(workers) : 0; }
+	int teams = _hostWorkers;
+	if (!teams) { teams = (int)std::thread::hardware_concurrency() / threads; if (teams < 1) teams = 1; }
+	if (teams > blocks) teams = blocks;
+	hostGrid grid(teams, blocks);
+	std::vector<hostTeam> team(teams);
+	std::vector<std::thread> thread;
+	thread.reserve(teams * threads);
+	for (int t = 0; t < teams; t++) {
+		team[t].Size = threads;
+		for (int i = 0; i < threads; i++)
+			thread.emplace_back(hostThread, &grid, &team[t], t, i, gridShape, blockShape, run, arg);
+	}
+	for (auto &t : thread) t.join();
+	return cudaSuccess;
+}
+
+#pragma endregion
@@ -0,0 +1,169 @@
+// libcu.host: the parts of the CUDA runtime and device builtins libcu uses, for compiling the runtime as host code.
+//
+// A host thread stands in for one device thread. threadIdx, blockIdx, blockDim and gridDim are per-thread and read as a lone thread of a
+// lone block until whatever runs the code sets them; __syncthreads waits on that block's barrier when there is one. Atomics and fences
+// are the compiler's own, device memory is host memory and every copy is a memcpy.
+#ifndef __CUDA_RUNTIME_H__
+#define __CUDA_RUNTIME_H__
+
+#include <host_defines.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// BUILTINS
+#pragma region BUILTINS
+
+struct uint3 { unsigned int x, y, z; };
+struct dim3 {
+	unsigned int x, y, z;
+#ifdef __cplusplus
+	dim3(unsigned int vx = 1, unsigned int vy = 1, unsigned int vz = 1) : x(vx), y(vy), z(vz) { }
+	dim3(uint3 v) : x(v.x), y(v.y), z(v.z) { }
+	operator uint3() const { uint3 v = { x, y, z }; return v; }
+#endif
+};
+
+#ifdef __cplusplus
+extern thread_local uint3 threadIdx;
+extern thread_local uint3 blockIdx;
+extern thread_local dim3 blockDim;
+extern thread_local dim3 gridDim;
+#define warpSize 32
+
+extern "C" void __syncthreads();
+#define __threadfence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __threadfence_block() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define __threadfence_system() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+// the operand converts to the target's type, as it would to the parameter of the matching cuda overload
+template <typename T, typename V> static __forceinline T atomicAdd(T *address, V val) { return __atomic_fetch_add(address, (T)val, __ATOMIC_SEQ_CST); }
+template <typename T, typename V> static __forceinline T atomicSub(T *address, V val) { return __atomic_fetch_sub(address, (T)val, __ATOMIC_SEQ_CST); }
+template <typename T, typename V> static __forceinline T atomicAnd(T *address, V val) { return __atomic_fetch_and(address, (T)val, __ATOMIC_SEQ_CST); }
+template <typename T, typename V> static __forceinline T atomicOr(T *address, V val) { return __atomic_fetch_or(address, (T)val, __ATOMIC_SEQ_CST); }
+template <typename T, typename V> static __forceinline T atomicExch(T *address, V val) { return __atomic_exchange_n(address, (T)val, __ATOMIC_SEQ_CST); }
+template <typename T, typename V> static __forceinline T atomicMax(T *address, V val)
+{
+	T old = __atomic_load_n(address, __ATOMIC_SEQ_CST);
+	while (old < (T)val && !__atomic_compare_exchange_n(address, &old, (T)val, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) { }
+	return old;
+}
+template <typename T, typename U, typename V> static __forceinline T atomicCAS(T *address, U compare, V val) { T expected = (T)compare; __atomic_compare_exchange_n(address, &expected, (T)val, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); return expected; }
+static __forceinline float atomicAdd(float *address, float val)
+{
+	float old = *address, sum;
+	do sum = old + val; while (!__atomic_compare_exchange(address, &old, &sum, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+	return old;
+}
+static __forceinline long long clock64() { struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts); return ts.tv_sec * 1000000000LL + ts.tv_nsec; }
+#endif
+
+#pragma endregion
+
+// RUNTIME
+#pragma region RUNTIME
+
+typedef enum cudaError {
+	cudaSuccess = 0,
+	cudaErrorMemoryAllocation = 2,
+	cudaErrorInvalidValue = 11,
+} cudaError_t;
+
+enum cudaMemcpyKind {
+	cudaMemcpyHostToHost = 0,
+	cudaMemcpyHostToDevice = 1,
+	cudaMemcpyDeviceToHost = 2,
+	cudaMemcpyDeviceToDevice = 3,
+	cudaMemcpyDefault = 4,
+};
+
+enum cudaComputeMode {
+	cudaComputeModeDefault = 0,
+	cudaComputeModeProhibited = 2,
+};
+
+enum cudaLimit {
+	cudaLimitStackSize = 0,
+	cudaLimitPrintfFifoSize = 1,
+	cudaLimitMallocHeapSize = 2,
+};
+
+/* The one device there is, the host. */
+struct cudaDeviceProp {
+	char name[256];
+	size_t totalGlobalMem;
+	int major, minor;
+	int multiProcessorCount;
+	int clockRate;
+	int computeMode;
+};
+
+typedef struct cudaEventHost *cudaEvent_t;
+typedef struct cudaStreamHost *cudaStream_t;
+
+#define cudaHostAllocDefault 0
+#define cudaHostAllocPortable 1
+#define cudaHostAllocMapped 2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+	extern const char *cudaGetErrorString(cudaError_t error);
+	extern cudaError_t cudaGetLastError();
+	extern cudaError_t cudaPeekAtLastError();
+	extern cudaError_t cudaGetDeviceCount(int *count);
+	extern cudaError_t cudaGetDeviceProperties(struct cudaDeviceProp *prop, int device);
+	extern cudaError_t cudaSetDevice(int device);
+	extern cudaError_t cudaDeviceSetLimit(enum cudaLimit limit, size_t value);
+	extern cudaError_t cudaDeviceReset();
+	extern cudaError_t cudaDeviceSynchronize();
+	extern cudaError_t cudaMalloc(void **devPtr, size_t size);
+	extern cudaError_t cudaFree(void *devPtr);
+	extern cudaError_t cudaHostAlloc(void **pHost, size_t size, unsigned int flags);
+	extern cudaError_t cudaFreeHost(void *ptr);
+	extern cudaError_t cudaHostGetDevicePointer(void **pDevice, void *pHost, unsigned int flags);
+	extern cudaError_t cudaMemcpy(void *dst, const void *src, size_t count, enum cudaMemcpyKind kind);
+	extern cudaError_t cudaMemset(void *devPtr, int value, size_t count);
+	extern cudaError_t cudaEventCreate(cudaEvent_t *event);
+	extern cudaError_t cudaEventDestroy(cudaEvent_t event);
+	extern cudaError_t cudaEventRecord(cudaEvent_t event, cudaStream_t stream = 0);
+	extern cudaError_t cudaEventSynchronize(cudaEvent_t event);
+	extern cudaError_t cudaEventElapsedTime(float *ms, cudaEvent_t start, cudaEvent_t end);
+#ifdef __cplusplus
+}
+
+/* A __constant__ or __device__ symbol is a host variable here. */
+template <class T> static __forceinline cudaError_t cudaMemcpyToSymbol(T &symbol, const void *src, size_t count, size_t offset = 0, enum cudaMemcpyKind kind = cudaMemcpyHostToDevice) { memcpy((char *)&symbol + offset, src, count); return cudaSuccess; }
+template <class T> static __forceinline cudaError_t cudaMemcpyFromSymbol(void *dst, const T &symbol, size_t count, size_t offset = 0, enum cudaMemcpyKind kind = cudaMemcpyDeviceToHost) { memcpy(dst, (const char *)&symbol + offset, count); return cudaSuccess; }
+#endif
+
+#pragma endregion
+
+// LAUNCH
+#pragma region LAUNCH
+#ifdef __cplusplus
+
+/* Run run(arg) as every thread of grid x block and return once all have. The threads of a block run together, one host thread each, so
+** __syncthreads holds; blocks are dealt over cudaHostSetWorkers teams which steal from each other when their own run out. __shared__
+** variables are static, so a block using them has them to itself until it leaves their scope, blocks of other teams wait. */
+extern cudaError_t cudaHostLaunch(dim3 grid, dim3 block, void (*run)(void *), void *arg);
+/* Set the blocks run at once, 0 for one per hardware thread a block's threads fit in, also read from LIBCU_HOSTWORKERS. */
+extern void cudaHostSetWorkers(int workers);
+
+template <class F> static void cudaHostRun(void *f) { (*(F *)f)(); }
+template <typename... P> struct cudaHostGrid {
+	void (*Kernel)(P...);
+	dim3 Grid, Block;
+	template <typename... A> cudaError_t operator()(A... args) { auto run = [&]() { Kernel(args...); }; return cudaHostLaunch(Grid, Block, cudaHostRun<decltype(run)>, &run); }
+};
+template <typename... P> static __forceinline cudaHostGrid<P...> cudaHostKernel(void (*kernel)(P...), dim3 grid, dim3 block) { cudaHostGrid<P...> g = { kernel, grid, block }; return g; }
+
+/* kernel<<<grid, block>>>(args) as cudaLaunchGrid(kernel, grid, block)(args). */
+#define cudaLaunchGrid(kernel, grid, block) cudaHostKernel(kernel, grid, block)
+
+#endif
+#pragma endregion
+
+#endif /* __CUDA_RUNTIME_H__ */
@@ -0,0 +1,2 @@
+// libcu.host: the runtime API lives in the same shim as the builtins.
+#include <cuda_runtime.h>
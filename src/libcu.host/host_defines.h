@@ -0,0 +1,26 @@
+// libcu.host: the CUDA qualifiers mean nothing to a host compiler, every function and variable is plain host code.
+#ifndef __HOST_DEFINES_H__
+#define __HOST_DEFINES_H__
+
+#define __device__
+#define __host__
+#define __global__
+#define __constant__
+#ifdef __cplusplus
+/* __shared__ storage is static, one copy for every block, so a block holds it from the declaration to the end of the enclosing scope and
+** blocks of other teams wait their turn, see cuda_runtime.cpp. */
+struct hostSharedScope { hostSharedScope(); ~hostSharedScope(); };
+#define __HOSTSHARED2(n) hostSharedScope _hostShared##n; static
+#define __HOSTSHARED(n) __HOSTSHARED2(n)
+#define __shared__ __HOSTSHARED(__COUNTER__)
+#else
+#define __shared__ static
+#endif
+#define __managed__
+#define __align__(n) __attribute__((aligned(n)))
+#ifndef __forceinline
+#define __forceinline inline __attribute__((always_inline))
+#endif
+#define __restrict__ __restrict
+
+#endif /* __HOST_DEFINES_H__ */
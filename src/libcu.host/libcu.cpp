@@ -0,0 +1,2 @@
+// libcu.cu compiled as host code.
+#include "../libcu/libcu.cu"
@@ -0,0 +1,2 @@
+// libcu.falloc.cu compiled as host code.
+#include "../libcu.falloc/libcu.falloc.cu"
@@ -0,0 +1,2 @@
+// libcu.stdlib.cu compiled as host code.
+#include "../libcu/libcu.stdlib.cu"
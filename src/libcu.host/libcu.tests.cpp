@@ -0,0 +1,2 @@
+// libcu.tests.cu compiled as host code, its kernels run by cudaHostLaunch.
+#include "../libcu.tests/libcu.tests.cu"
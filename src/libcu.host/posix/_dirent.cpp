@@ -0,0 +1,44 @@
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// The layout of posix/_dirent.h, under other names so the platform's own can sit beside it.
+namespace host {
+	struct dirent { long d_ino; unsigned short d_reclen; size_t d_namlen; int d_type; char d_name[260]; };
+	struct DIR { struct dirent ent; ::DIR *wdirp; };
+}
+
+extern "C" host::DIR *direntHostOpen(const char *dirname)
+{
+	::DIR *wdirp = opendir(dirname);
+	if (!wdirp) return nullptr;
+	host::DIR *dirp = (host::DIR *)malloc(sizeof(host::DIR));
+	if (!dirp) { closedir(wdirp); errno = ENOMEM; return nullptr; }
+	dirp->wdirp = wdirp;
+	return dirp;
+}
+
+extern "C" host::dirent *direntHostRead(host::DIR *dirp)
+{
+	struct ::dirent *e = readdir(dirp->wdirp);
+	if (!e) return nullptr;
+	host::dirent *ent = &dirp->ent;
+	ent->d_ino = (long)e->d_ino;
+	ent->d_reclen = sizeof(host::dirent);
+	strncpy(ent->d_name, e->d_name, sizeof(ent->d_name) - 1); ent->d_name[sizeof(ent->d_name) - 1] = 0;
+	ent->d_namlen = strlen(ent->d_name);
+	ent->d_type = e->d_type == DT_DIR ? S_IFDIR : e->d_type == DT_REG ? S_IFREG : e->d_type == DT_LNK ? S_IFLNK : 0; // the DT_ values of _dirent.h
+	return ent;
+}
+
+extern "C" int direntHostClose(host::DIR *dirp)
+{
+	if (!dirp) { errno = EBADF; return -1; }
+	int rc = closedir(dirp->wdirp);
+	free(dirp);
+	return rc;
+}
+
+extern "C" void direntHostRewind(host::DIR *dirp) { rewinddir(dirp->wdirp); }
@@ -0,0 +1,55 @@
+// libcu.host outside Windows: the dirent types of include/_dirent.h, which libcu lays its directory entries out with, over the platform's
+// directory calls in place of Win32's. The platform's <dirent.h> will not do, its DIR is opaque.
+#ifndef DIRENT_H
+#define DIRENT_H
+#include <limits.h>
+#include <sys/stat.h>
+
+#define _DIRENT_HAVE_D_TYPE
+#define _DIRENT_HAVE_D_NAMLEN
+
+#define DT_UNKNOWN 0
+#define DT_REG S_IFREG
+#define DT_DIR S_IFDIR
+#define DT_FIFO S_IFIFO
+#define DT_SOCK S_IFSOCK
+#define DT_CHR S_IFCHR
+#define DT_BLK S_IFBLK
+#define DT_LNK S_IFLNK
+#define IFTODT(mode) ((mode) & S_IFMT)
+#define DTTOIF(type) (type)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dirent {
+	long d_ino;
+	unsigned short d_reclen;
+	size_t d_namlen;
+	int d_type;
+	char d_name[260]; // MAX_PATH, as Win32 lays it out, a PATH_MAX name would not fit the sentinel reply of readdir
+};
+typedef struct dirent dirent;
+
+struct DIR {
+	struct dirent ent;
+	void *wdirp; // the platform's DIR
+};
+typedef struct DIR DIR;
+
+/* _dirent.cpp, where the platform's <dirent.h> is in scope */
+extern DIR *direntHostOpen(const char *dirname);
+extern struct dirent *direntHostRead(DIR *dirp);
+extern int direntHostClose(DIR *dirp);
+extern void direntHostRewind(DIR *dirp);
+
+static DIR *opendir(const char *dirname) { return direntHostOpen(dirname); }
+static struct dirent *readdir(DIR *dirp) { return direntHostRead(dirp); }
+static int closedir(DIR *dirp) { return direntHostClose(dirp); }
+static void rewinddir(DIR *dirp) { direntHostRewind(dirp); }
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,2 @@
+// libcu.host outside Windows: include/_unistd.h stands in for unistd.h on Windows, here the platform's own does.
+#include <unistd.h>
@@ -0,0 +1,9 @@
+// libcu.host outside Windows: crtdefscu.h expects the MSVC runtime's crtdefs.h, nothing in it is needed here.
+#ifndef _INC_CRTDEFS
+#define _INC_CRTDEFS
+#include <stddef.h>
+typedef int errno_t;
+#define MAX_PATH 260 // windef.h's, fsystem sizes paths by it
+#define _stat64 stat // off_t is 64 bits on the hosts this builds for
+#define _fstat64 fstat
+#endif /* _INC_CRTDEFS */
@@ -0,0 +1,2 @@
+// libcu.host outside Windows: the low-level I/O io.h declares on Windows is unistd.h's here.
+#include <unistd.h>
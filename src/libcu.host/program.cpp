@@ -0,0 +1,2 @@
+// program.cu compiled as host code.
+#include "../libcu.tests/program.cu"
@@ -33,4 +33,4 @@ static __global__ void g_crtdefs_test1()
 	/* Determines where you are based on number(handle) */
 	bool f0a = ISHOSTHANDLE(1); bool f0b = ISHOSTHANDLE(INT_MAX-CORE_MAXFILESTREAM); bool f0c = ISHOSTHANDLE(INT_MAX); assert(f0a && !f0b && !f0c);
 }
-cudaError_t crtdefs_test1() { g_crtdefs_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
\ No newline at end of file
+cudaError_t crtdefs_test1() { cudaLaunchGrid(g_crtdefs_test1, 1, 1)(); return cudaDeviceSynchronize(); }
\ No newline at end of file
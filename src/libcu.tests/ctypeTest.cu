@@ -55,7 +55,7 @@ static __global__ void g_ctype_test1()
 	//bool d0 = ispoweroftwo(2); bool d0n = ispoweroftwo(3); assert(d0 && !d0n);
 	//bool d1 = isalpha2('a'); bool d1n = isalpha2('A'); assert(d1 && d1n);
 }
-cudaError_t ctype_test1() { g_ctype_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t ctype_test1() { cudaLaunchGrid(g_ctype_test1, 1, 1)(); return cudaDeviceSynchronize(); }
 
 
 
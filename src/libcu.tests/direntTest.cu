@@ -51,5 +51,5 @@ static __global__ void g_dirent_test1()
 	DIR *d1a = opendir("test"); testReading(d1a); int d1b = closedir(d1a); assert(d1a && !d1b);
 
 }
-cudaError_t dirent_test1() { g_dirent_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t dirent_test1() { cudaLaunchGrid(g_dirent_test1, 1, 1)(); return cudaDeviceSynchronize(); }
 
@@ -20,4 +20,4 @@ static __global__ void g_errno_test1()
 	int b1 = _get_errno(nullptr); assert(b1 == 3);
 	int b1a, b1b = _get_errno(&b1a); assert(b1a == 3); assert(b1b == 3);
 }
-cudaError_t errno_test1() { g_errno_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
\ No newline at end of file
+cudaError_t errno_test1() { cudaLaunchGrid(g_errno_test1, 1, 1)(); return cudaDeviceSynchronize(); }
\ No newline at end of file
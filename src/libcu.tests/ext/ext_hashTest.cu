@@ -16,4 +16,4 @@ static __global__ void g_ext_hash_test1()
 	///* Remove all entries from a hash table.  Reclaim all memory. Call this routine to delete a hash table or to reset a hash table to the empty state. */
 	//extern __device__ void hashClear(hash_t *h);
 }
-cudaError_t ext_hash_test1() { g_ext_hash_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
\ No newline at end of file
+cudaError_t ext_hash_test1() { cudaLaunchGrid(g_ext_hash_test1, 1, 1)(); return cudaDeviceSynchronize(); }
\ No newline at end of file
@@ -7,4 +7,4 @@ static __global__ void g_ext_memfile_test1()
 {
 	printf("ext_memfile_test1\n");
 }
-cudaError_t ext_memfile_test1() { g_ext_memfile_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
\ No newline at end of file
+cudaError_t ext_memfile_test1() { cudaLaunchGrid(g_ext_memfile_test1, 1, 1)(); return cudaDeviceSynchronize(); }
\ No newline at end of file
@@ -8,7 +8,7 @@ static __global__ void g_falloc_lauched_cuda_kernel()
 	int gtid = blockIdx.x*blockDim.x + threadIdx.x;
 	assert(gtid < 1);
 }
-cudaError_t falloc_lauched_cuda_kernel() { g_falloc_lauched_cuda_kernel<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t falloc_lauched_cuda_kernel() { cudaLaunchGrid(g_falloc_lauched_cuda_kernel, 1, 1)(); return cudaDeviceSynchronize(); }
 
 // alloc with get chunk
 static __global__ void g_falloc_alloc_with_getchunk()
@@ -23,7 +23,7 @@ static __global__ void g_falloc_alloc_with_getchunk()
 	assert(obj2 != nullptr);
 	fallocFreeChunk(obj2);
 }
-cudaError_t falloc_alloc_with_getchunk() { g_falloc_alloc_with_getchunk<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t falloc_alloc_with_getchunk() { cudaDeviceFallocHeap heap = cudaDeviceFallocHeapCreate(); cudaFallocSetDefaultHeap(heap); cudaLaunchGrid(g_falloc_alloc_with_getchunk, 1, 1)(); cudaError_t error = cudaDeviceSynchronize(); cudaDeviceFallocHeapDestroy(heap); return error; }
 
 // alloc with get chunks
 static __global__ void g_falloc_alloc_with_getchunks()
@@ -36,7 +36,7 @@ static __global__ void g_falloc_alloc_with_getchunks()
 	//assert(obj2 != nullptr);
 	//fallocFreeChunks(obj2);
 }
-cudaError_t falloc_alloc_with_getchunks() { g_falloc_alloc_with_getchunks<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t falloc_alloc_with_getchunks() { cudaLaunchGrid(g_falloc_alloc_with_getchunks, 1, 1)(); return cudaDeviceSynchronize(); }
 
 // alloc with context
 static __global__ void g_falloc_alloc_with_context()
@@ -49,7 +49,7 @@ static __global__ void g_falloc_alloc_with_context()
 	assert(testInteger != nullptr);
 	fallocDisposeCtx(ctx);
 }
-cudaError_t falloc_alloc_with_context() { g_falloc_alloc_with_context<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t falloc_alloc_with_context() { cudaDeviceFallocHeap heap = cudaDeviceFallocHeapCreate(); cudaFallocSetDefaultHeap(heap); cudaLaunchGrid(g_falloc_alloc_with_context, 1, 1)(); cudaError_t error = cudaDeviceSynchronize(); cudaDeviceFallocHeapDestroy(heap); return error; }
 
 // alloc with context as stack
 static __global__ void g_falloc_alloc_with_context_as_stack()
@@ -63,4 +63,4 @@ static __global__ void g_falloc_alloc_with_context_as_stack()
 	assert(b == 2 && a == 1);
 	fallocDisposeCtx(ctx);
 }
-cudaError_t falloc_alloc_with_context_as_stack() { g_falloc_alloc_with_context_as_stack<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t falloc_alloc_with_context_as_stack() { cudaDeviceFallocHeap heap = cudaDeviceFallocHeapCreate(); cudaFallocSetDefaultHeap(heap); cudaLaunchGrid(g_falloc_alloc_with_context_as_stack, 1, 1)(); cudaError_t error = cudaDeviceSynchronize(); cudaDeviceFallocHeapDestroy(heap); return error; }
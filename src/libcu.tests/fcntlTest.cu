@@ -72,7 +72,7 @@ static __global__ void g_fcntl_test1()
 	makeAFile("test.txt");
 	int h1a = creat("test.txt", O_RDONLY); int h1b = close(h1a); assert(h1a && !h1b);
 }
-cudaError_t fcntl_test1() { g_fcntl_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t fcntl_test1() { cudaLaunchGrid(g_fcntl_test1, 1, 1)(); return cudaDeviceSynchronize(); }
 
 
 
@@ -6,6 +6,9 @@ using namespace System::Collections::Generic;
 using namespace Microsoft::VisualStudio::TestTools::UnitTesting;
 
 cudaError_t fsystem_test1();
+cudaError_t fsystem_descriptors();
+cudaError_t fsystem_concurrent();
+cudaError_t fsystem_image();
 namespace libcutests
 {
 	[TestClass]
@@ -29,5 +32,8 @@ namespace libcutests
 #pragma endregion 
 
 		[TestMethod, TestCategory("fsystem")] void fsystem_test1() { Assert::AreEqual("no error", gcnew String(cudaGetErrorString(::fsystem_test1()))); }
+		[TestMethod, TestCategory("fsystem")] void fsystem_descriptors() { Assert::AreEqual("no error", gcnew String(cudaGetErrorString(::fsystem_descriptors()))); }
+		[TestMethod, TestCategory("fsystem")] void fsystem_concurrent() { Assert::AreEqual("no error", gcnew String(cudaGetErrorString(::fsystem_concurrent()))); }
+		[TestMethod, TestCategory("fsystem")] void fsystem_image() { Assert::AreEqual("no error", gcnew String(cudaGetErrorString(::fsystem_image()))); }
 	};
 }
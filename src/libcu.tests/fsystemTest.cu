@@ -65,7 +65,261 @@ static __global__ void g_fsystem_test1()
 	dirEnt_t *k0a = fsystemOpen(":\\", 0, &fd); int k0b = !strcmp(__cwd, ":\\");
 	//assert(k0a);
 
+	// INDEX
+	fsystemMkdir(":\\b", 0, &r); fsystemMkdir(":\\a", 0, &r); fsystemMkdir("c", 0, &r); fsystemMkdir(":\\a\\x", 0, &r);
+	dirCursor_t l0a; dirent l0b[3]; bool l0c = fsystemCursorOpen(":\\", &l0a) && fsystemCursorRead(&l0a, &l0b[0]) && fsystemCursorRead(&l0a, &l0b[1]) && fsystemCursorRead(&l0a, &l0b[2]); fsystemCursorClose(&l0a);
+	assert(l0c && !strcmp(l0b[0].d_name, "a") && !strcmp(l0b[1].d_name, "b") && !strcmp(l0b[2].d_name, "c"));
+	int l1a = fsystemChdir("a\\x"); dirEnt_t *l1b = fsystemOpendir("..\\..\\b"); assert(!l1a && l1b && l1b == fsystemOpendir(":\\b"));
+	int l2a = fsystemUnlink(":\\b", true); assert(!l2a && !fsystemOpendir(":\\b") && fsystemOpendir(":\\c"));
+	int l3a = fsystemChdir(":\\missing"); dirEnt_t *l3b = fsystemOpendir(":\\c\\missing\\x"); assert(l3a == -1 && !l3b);
+
+	// RENAME SUBTREE
+	fsystemMkdir(":\\a\\x\\y", 0, &r); fsystemChdir(":\\a\\x\\y");
+	int m0a = fsystemRename(":\\a", ":\\c\\z"); dirEnt_t *m0b = fsystemOpendir(":\\c\\z\\x\\y"); assert(!m0a && m0b && !fsystemOpendir(":\\a") && !strcmp(__cwd, ":\\c\\z\\x\\y"));
+	int m1a = fsystemRename(":\\c", ":\\c\\z\\q"); int m1b = fsystemRename(":\\", ":\\q"); assert(m1a == -1 && m1b == -1);
+	int m2a = fsystemRename("..", "..\\..\\w"); int m2b = fsystemChdir(":\\c\\z\\w\\y"); assert(!m2a && !m2b && fsystemPath(m0b, newPath, MAX_PATH) && !strcmp(newPath, ":\\c\\z\\w\\y"));
+
+	// RESET
+	fsystemReset();
+}
+cudaError_t fsystem_test1() { cudaLaunchGrid(g_fsystem_test1, 1, 1)(); return cudaDeviceSynchronize(); }
+
+#define DESCRIPTOR_BLOCKS 4
+#define DESCRIPTOR_THREADS 64
+static __device__ FILE *_heldStreams[DESCRIPTOR_BLOCKS*DESCRIPTOR_THREADS];
+
+static __global__ void g_fsystem_descriptors_create()
+{
+	int fd; fsystemOpen(":\\held", O_WRONLY|O_CREAT, &fd); fsystemClose(fd);
+}
+
+static __global__ void g_fsystem_descriptors_open()
+{
+	_heldStreams[blockIdx.x*blockDim.x + threadIdx.x] = fopen(":\\held", "r");
+}
+
+static __global__ void g_fsystem_descriptors()
+{
+	printf("fsystem_descriptors\n");
+	const int n = DESCRIPTOR_BLOCKS*DESCRIPTOR_THREADS;
+	// HELD, every thread has a stream and descriptor of its own
+	int a0a = 1;
+	for (int i = 0; i < n; i++) {
+		if (!_heldStreams[i] || ISHOSTFILE(_heldStreams[i])) { a0a = 0; break; }
+		for (int j = 0; j < i; j++)
+			if (_heldStreams[i] == _heldStreams[j] || fileno(_heldStreams[i]) == fileno(_heldStreams[j])) a0a = 0;
+	}
+	int a1a, a1b; slotGetStats(&__iob_streamTable, &a1a, &a1b);
+	int a2a, a2b; slotGetStats(&__iob_files, &a2a, &a2b);
+	assert(a0a && a1a == n && a1b == n && a2a == n && a2b == n);
+
+	// CLOSED, slots are reused and the high-water marks stay
+	for (int i = 0; i < n; i++) fclose(_heldStreams[i]);
+	int b0a, b0b; slotGetStats(&__iob_streamTable, &b0a, &b0b);
+	int b1a, b1b; slotGetStats(&__iob_files, &b1a, &b1b);
+	assert(!b0a && b0b == n && !b1a && b1b == n);
+	FILE *b2a = fopen(":\\held", "r"); int b2b = slotIndexOf(&__iob_streamTable, b2a); assert(b2a && b2b >= 0 && b2b < n);
+	fclose(b2a);
+	FILE *b3a = fopen(":\\missing\\held", "w"); assert(!b3a && errno == ENOENT);
+
+	// PINNED, what a stream or descriptor stands on outlives its removal
+	int r; fsystemMkdir(":\\p", 0, &r); int fd;
+	fsystemOpen(":\\p\\a", O_WRONLY|O_CREAT, &fd); fsystemClose(fd); fsystemOpen(":\\p\\c", O_WRONLY|O_CREAT, &fd); fsystemClose(fd);
+	dirEnt_t *c0a = fsystemOpen(":\\p\\b", O_WRONLY|O_CREAT, &fd);
+	dirCursor_t c0b; dirent c0c; bool c0d = fsystemCursorOpen(":\\p", &c0b) && fsystemCursorRead(&c0b, &c0c) && !strcmp(c0c.d_name, "a");
+	int c0e = fsystemUnlink(":\\p\\b", false); memfileWrite(c0a->u.file, "kept", 4, 0); int c0f = (int)memfileGetFileSize(c0a->u.file); fsystemClose(fd);
+	assert(c0a && c0d && !c0e && c0f == 4);
+	bool c1a = fsystemCursorRead(&c0b, &c0c) && !strcmp(c0c.d_name, "c") && !fsystemCursorRead(&c0b, &c0c);
+	fsystemCursorRewind(&c0b); bool c1b = fsystemCursorRead(&c0b, &c0c) && !strcmp(c0c.d_name, "a");
+	int c1c = fsystemRename(":\\p\\c", ":\\p\\d"); bool c1d = fsystemCursorRead(&c0b, &c0c) && !strcmp(c0c.d_name, "d");
+	fsystemCursorClose(&c0b);
+	assert(c1a && c1b && !c1c && c1d);
+
+	// RESET
+	fsystemReset();
+}
+cudaError_t fsystem_descriptors()
+{
+	cudaLaunchGrid(g_fsystem_descriptors_create, 1, 1)();
+	cudaLaunchGrid(g_fsystem_descriptors_open, DESCRIPTOR_BLOCKS, DESCRIPTOR_THREADS)();
+	cudaLaunchGrid(g_fsystem_descriptors, 1, 1)(); return cudaDeviceSynchronize();
+}
+
+#define CONCURRENT_BLOCKS 8
+#define CONCURRENT_THREADS 32
+static __device__ int _concurrentMade, _concurrentErrors;
+
+static __device__ char *concurrentPath(char *path, const char *dir, char prefix, int i)
+{
+	strcpy(path, dir);
+	char *d = path + strlen(path);
+	*d++ = prefix;
+	char digits[12]; int n = 0;
+	do digits[n++] = '0' + i % 10; while (i /= 10);
+	while (n) *d++ = digits[--n];
+	*d = 0;
+	return path;
+}
+
+static __device__ int concurrentRead(const char *path)
+{
+	int value = -1;
+	FILE *s = fopen(path, "r");
+	if (!s) return -1;
+	fread(&value, sizeof(value), 1, s); fclose(s);
+	return value;
+}
+
+static __device__ int concurrentCount(const char *path, char prefix)
+{
+	dirCursor_t c; dirent ent, last;
+	if (!fsystemCursorOpen(path, &c)) return -1;
+	int n = 0;
+	for (; fsystemCursorRead(&c, &ent); n++, last = ent)
+		if (ent.d_name[0] != prefix || (n && stricmp(last.d_name, ent.d_name) >= 0)) { n = -1; break; }
+	fsystemCursorClose(&c);
+	return n;
+}
+
+static __global__ void g_fsystem_concurrent_create()
+{
+	int id = blockIdx.x*blockDim.x + threadIdx.x, n = gridDim.x*blockDim.x, r; char dir[MAX_PATH], path[MAX_PATH];
+	// every thread of a block makes the block's directory, one wins
+	concurrentPath(dir, ":\\b", 'x', blockIdx.x); strcat(dir, "\\");
+	fsystemMkdir(concurrentPath(path, ":\\b", 'x', blockIdx.x), 0, &r);
+	if (!r) atomicAdd(&_concurrentMade, 1);
+	else if (r != 1) atomicAdd(&_concurrentErrors, 1);
+	// a file of its own in it and one in the directory all share, while looking up the next thread's
+	FILE *s = fopen(concurrentPath(path, dir, 'f', threadIdx.x), "w"); fwrite(&id, sizeof(id), 1, s); fclose(s);
+	s = fopen(concurrentPath(path, ":\\shared\\", 't', id), "w"); fwrite(&id, sizeof(id), 1, s); fclose(s);
+	int fd; dirEnt_t *ent = fsystemOpen(concurrentPath(path, ":\\shared\\", 't', (id + 1) % n), O_RDONLY, &fd);
+	if (ent) {
+		if (ent->dir.d_type != 2 || strcmp(ent->dir.d_name, path + 9)) atomicAdd(&_concurrentErrors, 1);
+		fsystemClose(fd);
+	}
+}
+
+static __global__ void g_fsystem_concurrent_move()
+{
+	int id = blockIdx.x*blockDim.x + threadIdx.x; char dir[MAX_PATH], path[MAX_PATH], newPath[MAX_PATH];
+	// move the shared file into the block's directory in place of its own, which goes
+	concurrentPath(dir, ":\\b", 'x', blockIdx.x); strcat(dir, "\\");
+	if (fsystemRename(concurrentPath(path, ":\\shared\\", 't', id), concurrentPath(newPath, dir, 'r', threadIdx.x))) atomicAdd(&_concurrentErrors, 1);
+	if (fsystemUnlink(concurrentPath(path, dir, 'f', threadIdx.x), false)) atomicAdd(&_concurrentErrors, 1);
+	// the block's directory cannot go while it holds files
+	if (!fsystemUnlink(concurrentPath(path, ":\\b", 'x', blockIdx.x), true)) atomicAdd(&_concurrentErrors, 1);
+}
+
+static __global__ void g_fsystem_concurrent(int phase)
+{
+	const int n = CONCURRENT_BLOCKS*CONCURRENT_THREADS; char dir[MAX_PATH], path[MAX_PATH];
+	if (!phase) {
+		printf("fsystem_concurrent\n");
+		int r; fsystemMkdir(":\\shared", 0, &r);
+		return;
+	}
+	// CREATED, a directory a block and every file once, in name order
+	if (phase == 1) {
+		int a0a = 1;
+		for (int i = 0; i < n; i++) {
+			concurrentPath(dir, ":\\b", 'x', i / CONCURRENT_THREADS); strcat(dir, "\\");
+			if (concurrentRead(concurrentPath(path, ":\\shared\\", 't', i)) != i || concurrentRead(concurrentPath(path, dir, 'f', i % CONCURRENT_THREADS)) != i) a0a = 0;
+		}
+		int a1a = concurrentCount(":\\shared", 't'); int a1b = concurrentCount(concurrentPath(path, ":\\b", 'x', 0), 'f');
+		int a2a, a2b; slotGetStats(&__iob_files, &a2a, &a2b);
+		assert(a0a && a1a == n && a1b == CONCURRENT_THREADS && _concurrentMade == CONCURRENT_BLOCKS && !_concurrentErrors && !a2a);
+		return;
+	}
+	// MOVED, the shared directory is empty and the moved files read back
+	int b0a = 1;
+	for (int i = 0; i < n; i++) {
+		concurrentPath(dir, ":\\b", 'x', i / CONCURRENT_THREADS); strcat(dir, "\\");
+		if (concurrentRead(concurrentPath(path, dir, 'r', i % CONCURRENT_THREADS)) != i) b0a = 0;
+	}
+	int b1a = concurrentCount(":\\shared", 't'); int b1b = concurrentCount(concurrentPath(path, ":\\b", 'x', CONCURRENT_BLOCKS - 1), 'r');
+	assert(b0a && !b1a && b1b == CONCURRENT_THREADS && !_concurrentErrors);
+
 	// RESET
 	fsystemReset();
 }
-cudaError_t fsystem_test1() { g_fsystem_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t fsystem_concurrent()
+{
+	cudaLaunchGrid(g_fsystem_concurrent, 1, 1)(0);
+	cudaLaunchGrid(g_fsystem_concurrent_create, CONCURRENT_BLOCKS, CONCURRENT_THREADS)();
+	cudaLaunchGrid(g_fsystem_concurrent, 1, 1)(1);
+	cudaLaunchGrid(g_fsystem_concurrent_move, CONCURRENT_BLOCKS, CONCURRENT_THREADS)();
+	cudaLaunchGrid(g_fsystem_concurrent, 1, 1)(2); return cudaDeviceSynchronize();
+}
+
+static __device__ bool imageRead(const char *path, const char *expected)
+{
+	char buf[64]; int length = (int)strlen(expected);
+	int fd; dirEnt_t *ent = fsystemOpen(path, O_RDONLY, &fd);
+	if (!ent) return false;
+	fsystemClose(fd);
+	if (memfileGetFileSize(ent->u.file) != length) return false;
+	if (length) memfileRead(ent->u.file, buf, length, 0);
+	return !memcmp(buf, expected, length);
+}
+
+static __global__ void g_fsystem_image(const char *image, size_t size)
+{
+	printf("fsystem_image\n");
+	int r; fsystemMkdir(":\\a", 0, &r);
+	// LOADED, merged with what is there and served from the image
+	int a0a = fsystemLoad(image, size); dirCursor_t a0b; dirent a0c[2];
+	bool a0d = fsystemCursorOpen(":\\a\\b", &a0b) && fsystemCursorRead(&a0b, &a0c[0]) && fsystemCursorRead(&a0b, &a0c[1]) && !fsystemCursorRead(&a0b, &a0c[1]); fsystemCursorClose(&a0b);
+	assert(!a0a && a0d && !strcmp(a0c[0].d_name, "c.txt") && !strcmp(a0c[1].d_name, "D.txt"));
+	bool a1a = imageRead(":\\a\\b\\c.txt", "hello"); bool a1b = imageRead(":\\A\\B\\d.TXT", "world!"); bool a1c = imageRead(":\\empty", ""); dirEnt_t *a1d = fsystemOpendir(":\\e");
+	assert(a1a && a1b && a1c && a1d && !a1d->u.list);
+
+	// WRITTEN, a write moves the file off the image
+	int fd; dirEnt_t *b0a = fsystemOpen(":\\a\\b\\c.txt", O_RDONLY, &fd); fsystemClose(fd);
+	memfileWrite(b0a->u.file, ", you", 5, memfileGetFileSize(b0a->u.file));
+	bool b0b = imageRead(":\\a\\b\\c.txt", "hello, you"); int b0c = memcmp(fsimageData((fsimage_t *)image), "hello", 5);
+	assert(b0b && !b0c);
+
+	// SAVED, and loaded back in place of what was there
+	size_t c0a = fsystemSave(nullptr, 0); char *c0b = (char *)malloc(c0a); size_t c0c = fsystemSave(c0b, c0a);
+	assert(c0a > sizeof(fsimage_t) && c0c == c0a);
+	fsystemReset();
+	int c1a = fsystemLoad(c0b, c0a); bool c1b = imageRead(":\\a\\b\\c.txt", "hello, you"); bool c1c = imageRead(":\\a\\b\\d.txt", "world!"); dirEnt_t *c1d = fsystemOpendir(":\\e");
+	char *c1e = (char *)malloc(c0a); size_t c1f = fsystemSave(c1e, c0a);
+	assert(!c1a && c1b && c1c && c1d && c1f == c0a && !memcmp(c0b, c1e, c0a));
+	free(c1e);
+
+	// INVALID
+	int d0a = fsystemLoad(c0b, sizeof(fsimage_t) - 1); int d0b = fsystemLoad(image, 8); ((fsimage_t *)c0b)->magic = 0; int d0c = fsystemLoad(c0b, c0a);
+	assert(d0a == -1 && d0b == -1 && d0c == -1);
+	// an entity under a file
+	fsimageEnt_t *d1a = fsimageEnts((fsimage_t *)c0b); int d1b = 0; while (d1a[d1b].type != 2) d1b++;
+	((fsimage_t *)c0b)->magic = FSIMAGE_MAGIC; d1a[d1b + 1].parent = d1b; fsystemReset(); int d1c = fsystemLoad(c0b, c0a);
+	assert(d1c == -1 && errno == EINVAL && !__iob_root.u.list);
+
+	// RESET
+	fsystemReset();
+	free(c0b);
+}
+cudaError_t fsystem_image()
+{
+	const char hello[] = "hello", world[] = "world!";
+	fsimageFile_t files[] = {
+		{ "a/b/c.txt", hello, sizeof(hello) - 1 },
+		{ "a\\B\\D.txt", world, sizeof(world) - 1 },
+		{ "empty", nullptr, 0 },
+		{ "e", nullptr, 0, true },
+	};
+	fsimageFile_t conflicts[] = {
+		{ "a/b", hello, sizeof(hello) - 1 },
+		{ "A/B/c.txt", world, sizeof(world) - 1 },
+	};
+	if (fsimageBuild(nullptr, 0, conflicts, _LENGTHOF(conflicts))) return cudaErrorInvalidValue;
+	size_t size = fsimageBuild(nullptr, 0, files, _LENGTHOF(files));
+	char *image = (char *)malloc(size), *d_image;
+	fsimageBuild(image, size, files, _LENGTHOF(files));
+	cudaMalloc((void **)&d_image, size); cudaMemcpy(d_image, image, size, cudaMemcpyHostToDevice);
+	free(image);
+	cudaLaunchGrid(g_fsystem_image, 1, 1)(d_image, size); cudaError_t rc = cudaDeviceSynchronize();
+	cudaFree(d_image);
+	return rc;
+}
@@ -18,4 +18,4 @@ static __global__ void g_grp_test1()
 	struct group *c0a = getgrent(); assert(c0a); int c0b = 1; while ((c0a = getgrent()) != nullptr) c0b++; assert(c0b == 1);
 	struct group *d0a = getgrent(); setgrent(); struct group *d0b = getgrent(); endgrent(); struct group *d0c = getgrent(); assert(!d0a && d0b && d0c);
 }
-cudaError_t grp_test1() { g_grp_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
\ No newline at end of file
+cudaError_t grp_test1() { cudaLaunchGrid(g_grp_test1, 1, 1)(); return cudaDeviceSynchronize(); }
\ No newline at end of file
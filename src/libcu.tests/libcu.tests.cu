@@ -1,3 +1,4 @@
+#include <cuda_runtimecu.h>
 #include "crtdefsTest.cu"
 #include "ctypeTest.cu"
 #include "direntTest.cu"
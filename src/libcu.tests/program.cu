@@ -13,6 +13,9 @@ cudaError_t falloc_alloc_with_getchunks();
 cudaError_t falloc_alloc_with_context();
 cudaError_t fcntl_test1(); // fails
 cudaError_t fsystem_test1();
+cudaError_t fsystem_descriptors();
+cudaError_t fsystem_concurrent();
+cudaError_t fsystem_image();
 cudaError_t grp_test1();
 cudaError_t pwd_test1();
 cudaError_t regex_test1();
@@ -25,6 +28,7 @@ cudaError_t stdio_test1(); // fails
 cudaError_t stdio_64bit();
 cudaError_t stdio_ganging();
 cudaError_t stdio_scanf();
+cudaError_t stdio_hostwrite();
 cudaError_t stdlib_test1(); // fails
 cudaError_t stdlib_strtol();
 cudaError_t stdlib_strtoq();
@@ -35,7 +39,8 @@ cudaError_t unistd_test1();
 int main(int argc, char ** argv)
 {
 	int testId = atoi(argv[1]);
-	sentinelServerInitialize();
+	// a map name of its own lets test processes run side by side
+	sentinelServerInitialize(nullptr, argc > 2 ? argv[2] : SENTINEL_NAME);
 
 	// Choose which GPU to run on, change this on a multi-GPU system.
 	cudaError_t cudaStatus = cudaSetDevice(gpuGetMaxGflopsDevice());
@@ -76,6 +81,11 @@ int main(int argc, char ** argv)
 	case 25: cudaStatus = string_test1(); break;
 	case 26: cudaStatus = time_test1(); break;
 	case 27: cudaStatus = unistd_test1(); break;
+	case 28: cudaStatus = fsystem_test1(); break;
+	case 29: cudaStatus = fsystem_descriptors(); break;
+	case 30: cudaStatus = fsystem_concurrent(); break;
+	case 31: cudaStatus = fsystem_image(); break;
+	case 32: cudaStatus = stdio_hostwrite(); break;
 		// default
 	default: cudaStatus = crtdefs_test1(); break;
 	}
@@ -18,5 +18,5 @@ static __global__ void g_pwd_test1()
 	struct passwd *c0a = getpwent(); assert(c0a); int c0b = 1; while ((c0a = getpwent()) != nullptr) c0b++; assert(c0b == 1);
 	struct passwd *d0a = getpwent(); setpwent(); struct passwd *d0b = getpwent(); endpwent(); struct passwd *d0c = getpwent(); assert(!d0a && d0b && d0c);
 }
-cudaError_t pwd_test1() { g_pwd_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t pwd_test1() { cudaLaunchGrid(g_pwd_test1, 1, 1)(); return cudaDeviceSynchronize(); }
 
@@ -35,5 +35,5 @@ static __global__ void g_regex_test1()
 	//extern __device__ void regfree_(regex_t *preg);
 	exact();
 }
-cudaError_t regex_test1() { g_regex_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t regex_test1() { cudaLaunchGrid(g_regex_test1, 1, 1)(); return cudaDeviceSynchronize(); }
 
@@ -32,4 +32,4 @@ static __global__ void g_sentinel_test1()
 	//// SENTINELREGISTERFILEUTILS ////
 	//	extern void sentinelRegisterFileUtils();
 }
-cudaError_t sentinel_test1() { g_sentinel_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
\ No newline at end of file
+cudaError_t sentinel_test1() { cudaLaunchGrid(g_sentinel_test1, 1, 1)(); return cudaDeviceSynchronize(); }
\ No newline at end of file
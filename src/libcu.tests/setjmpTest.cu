@@ -17,4 +17,4 @@ static __global__ void g_setjmp_test1()
 	//// LONGJMP ////
 	//extern __device__ void longjmp_(jmp_buf env, int val);
 }
-cudaError_t setjmp_test1() { g_setjmp_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
\ No newline at end of file
+cudaError_t setjmp_test1() { cudaLaunchGrid(g_setjmp_test1, 1, 1)(); return cudaDeviceSynchronize(); }
\ No newline at end of file
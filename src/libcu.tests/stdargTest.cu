@@ -14,7 +14,7 @@ static __global__ void g_stdarg_parse()
 	va_end(va);
 #endif
 }
-cudaError_t stdarg_parse() { g_stdarg_parse<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t stdarg_parse() { cudaLaunchGrid(g_stdarg_parse, 1, 1)(); return cudaDeviceSynchronize(); }
 
 __device__ void methodVoid_(int cnt, va_list va)
 {
@@ -85,4 +85,4 @@ static __global__ void g_stdarg_call()
 	assert(methodRet(19, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19) == 19);
 	assert(methodRet(20, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20) == 20);
 }
-cudaError_t stdarg_call() { g_stdarg_call<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t stdarg_call() { cudaLaunchGrid(g_stdarg_call, 1, 1)(); return cudaDeviceSynchronize(); }
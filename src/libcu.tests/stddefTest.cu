@@ -15,5 +15,5 @@ static __global__ void g_stddef_test1()
 	//__forceinline __device__ void tagfree(void *tag, void *p) { }
 	//__forceinline __device__ void *tagrealloc(void *tag, void *old, size_t size) { return nullptr; }
 }
-cudaError_t stddef_test1() { g_stddef_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t stddef_test1() { cudaLaunchGrid(g_stddef_test1, 1, 1)(); return cudaDeviceSynchronize(); }
 
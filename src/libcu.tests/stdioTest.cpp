@@ -9,6 +9,7 @@ cudaError_t stdio_test1();
 cudaError_t stdio_64bit();
 cudaError_t stdio_ganging();
 cudaError_t stdio_scanf();
+cudaError_t stdio_hostwrite();
 namespace libcutests
 {
 	[TestClass]
@@ -35,5 +36,6 @@ namespace libcutests
 		[TestMethod, TestCategory("core")] void stdio_64bit() { Assert::AreEqual("no error", gcnew String(cudaGetErrorString(::stdio_64bit()))); }
 		[TestMethod, TestCategory("core")] void stdio_ganging() { Assert::AreEqual("no error", gcnew String(cudaGetErrorString(::stdio_ganging()))); }
 		[TestMethod, TestCategory("core")] void stdio_scanf() { Assert::AreEqual("no error", gcnew String(cudaGetErrorString(::stdio_scanf()))); }
+		[TestMethod, TestCategory("core")] void stdio_hostwrite() { Assert::AreEqual("no error", gcnew String(cudaGetErrorString(::stdio_hostwrite()))); }
 	};
 }
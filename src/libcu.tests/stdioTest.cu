@@ -12,7 +12,7 @@ static __device__ void makeAFile(char *file)
 }
 #endif
 
-extern __constant__ FILE __iob_streams[CORE_MAXFILESTREAM+3];
+extern __constant__ FILE __iob_streams[3];
 static __global__ void g_stdio_test1()
 {
 	printf("stdio_test1\n");
@@ -176,7 +176,7 @@ static __global__ void g_stdio_test1()
 	//__device__ char *vmsnprintf_(char *__restrict s, size_t maxlen, const char *format, va_list va);
 
 }
-cudaError_t stdio_test1() { g_stdio_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t stdio_test1() { cudaLaunchGrid(g_stdio_test1, 1, 1)(); return cudaDeviceSynchronize(); }
 
 
 
@@ -194,7 +194,7 @@ static __global__ void g_stdio_64bit()
 	printf("val = %Lx\n", val);
 	*/
 }
-cudaError_t stdio_64bit() { g_stdio_64bit<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t stdio_64bit() { cudaLaunchGrid(g_stdio_64bit, 1, 1)(); return cudaDeviceSynchronize(); }
 
 #pragma endregion
 
@@ -204,7 +204,7 @@ static __global__ void g_stdio_ganging()
 {
 	printf("stdio_ganging\n");
 }
-cudaError_t stdio_ganging() { g_stdio_ganging<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t stdio_ganging() { cudaLaunchGrid(g_stdio_ganging, 1, 1)(); return cudaDeviceSynchronize(); }
 
 #pragma endregion
 
@@ -232,6 +232,33 @@ static __global__ void g_stdio_scanf()
 	return 0;
 	*/
 }
-cudaError_t stdio_scanf() { g_stdio_scanf<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t stdio_scanf() { cudaLaunchGrid(g_stdio_scanf, 1, 1)(); return cudaDeviceSynchronize(); }
+
+#pragma endregion
+
+#pragma region HostWrite
+
+static __global__ void g_stdio_hostwrite()
+{
+	printf("stdio_hostwrite\n");
+	size_t size = (1 << 20) + 10;
+	char *data = (char *)malloc(size); assert(data);
+	for (size_t i = 0; i < size; i++) data[i] = (char)i;
+
+	// a write past the host buffer follows what it holds and is counted by the host
+	FILE *a0a = fopen("C:\\T_\\hostwrite.bin", "w"); assert(a0a);
+	size_t a0b = fwrite(data, 1, 10, a0a); assert(a0b == 10);
+	size_t a0c = fwrite(data + 10, 1, size - 10, a0a); assert(a0c == size - 10);
+	fclose(a0a);
+	FILE *a1a = fopen("C:\\T_\\hostwrite.bin", "r"); assert(a1a);
+	fseek(a1a, 0, SEEK_END); long a1b = ftell(a1a); assert(a1b == (long)size);
+
+	// and a host that cannot write says so
+	size_t a2a = fwrite(data, 1, size, a1a); assert(a2a == 0);
+	fclose(a1a);
+	remove("C:\\T_\\hostwrite.bin");
+	free(data);
+}
+cudaError_t stdio_hostwrite() { cudaLaunchGrid(g_stdio_hostwrite, 1, 1)(); return cudaDeviceSynchronize(); }
 
 #pragma endregion
@@ -66,8 +66,8 @@ static __global__ void g_stdlib_test1()
 	//// MKTEMP, MKSTEMP ////
 	//extern __device__ char *mktemp_(char *template_);
 	//extern __device__ int mkstemp_(char *template_);
-	char *g0a = mktemp("Test"); assert(g0a);
-	int g1a = mkstemp("Test"); assert(g1a);
+	char g0[] = "TestXXXXXX"; char *g0a = mktemp(g0); assert(g0a);
+	char g1[] = "TestXXXXXX"; int g1a = mkstemp(g1); assert(g1a);
 
 	//// SYSTEM ////
 	//__forceinline __device__ int system_(const char *command); #sentinel
@@ -103,11 +103,12 @@ static __global__ void g_stdlib_test1()
 	//extern __device__ int wctomb_(char *s, wchar_t wchar);
 	//extern __device__ size_t mbstowcs_(wchar_t *__restrict pwcs, const char *__restrict s, size_t n);
 	//extern __device__ size_t wcstombs_(char *__restrict s, const wchar_t *__restrict pwcs, size_t n);
-	char buf[10];
-	int m0a = mblen("test", 4); assert(m0a == 4);
-	int m1a = mbtowc(L"test", buf, sizeof(buf)); assert(m1a == 4);
-	int m2a = wctomb(buf, L'a'); bool m2b = (buf[0] == 1 && buf[1] == 0); assert(m2a && m2b);
-	size_t m3a = mbstowcs(L"test", buf, sizeof(buf));
+	char buf[10]; wchar_t wbuf[10];
+	int m0a = mblen("test", 4); assert(m0a == 1);
+	int m1a = mbtowc(wbuf, "test", 4); assert(m1a == 1 && wbuf[0] == L't');
+	int m2a = wctomb(buf, L'a'); bool m2b = (buf[0] == 'a'); assert(m2a == 1 && m2b);
+	size_t m3a = mbstowcs(wbuf, "test", _LENGTHOF(wbuf)); assert(m3a == 4 && wbuf[4] == 0);
+	size_t m4a = wcstombs(buf, wbuf, sizeof(buf)); assert(m4a == 4 && !strcmp(buf, "test"));
 
 	//// STRTOQ, STRTOUQ ////
 	//__forceinline __device__ quad_t strtoq_(const char *__restrict nptr, char **__restrict endptr, int base);
@@ -116,7 +117,7 @@ static __global__ void g_stdlib_test1()
 	//// MALLOCZERO //// ??different than calloc??
 	//__forceinline __device__ void *mallocZero(size_t size);
 }
-cudaError_t stdlib_test1() { g_stdlib_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t stdlib_test1() { cudaLaunchGrid(g_stdlib_test1, 1, 1)(); return cudaDeviceSynchronize(); }
 
 #pragma region qsort
 
@@ -255,7 +256,7 @@ __global__ void g_stdlib_strtol()
 	strtol_test(16); strtol_utest(16);
 	strtol_test(36); strtol_utest(36);
 }
-cudaError_t stdlib_strtol() { g_stdlib_strtol<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t stdlib_strtol() { cudaLaunchGrid(g_stdlib_strtol, 1, 1)(); return cudaDeviceSynchronize(); }
 
 #pragma endregion
 
@@ -338,7 +339,7 @@ __global__ void g_stdlib_strtoq()
 	strtoq_test(16);
 	strtoq_test(36);
 }
-cudaError_t stdlib_strtoq() { g_stdlib_strtoq<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t stdlib_strtoq() { cudaLaunchGrid(g_stdlib_strtoq, 1, 1)(); return cudaDeviceSynchronize(); }
 
 #pragma endregion
 
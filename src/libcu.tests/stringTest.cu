@@ -8,7 +8,7 @@ static __global__ void g_string_test1()
 {
 	printf("string_test1\n");
 
-	char *src = "abcdefghijklmnopqrstuvwxyz";
+	char src[] = "abcdefghijklmnopqrstuvwxyz";
 	char *dest[100];
 
 	//// MEMCPY, MEMMOVE, MEMSET, MEMCPY, MEMCHR ////
@@ -19,7 +19,7 @@ static __global__ void g_string_test1()
 	//extern __device__ void *memchr_(const void *s, int c, size_t n);
 	void *a0a = memcpy(dest, src, 0); void *a0b = memcpy(dest, src, 1); //assert(a0a && a0b);
 	void *a1a = memmove(src, dest, 0); void *a1b = memmove(src, src, 1); void *a1c = memmove(src, dest, 10); void *a1d = memmove(dest, dest + 1, 10); //assert(a1a && a1b && a1c);
-	void *a2a = memset(dest, 0, 0); void *a0b = memset(dest, 0, 1); //assert(a2a && a2b);
+	void *a2a = memset(dest, 0, 0); void *a2b = memset(dest, 0, 1); //assert(a2a && a2b);
 	int a3a = memcmp(nullptr, nullptr, 0); int a3b = memcmp("abc", "abc", 2); int a3c = memcmp("abc", "abc", 10); int a3d = memcmp("abc", "axc", 10); //assert(a3a && a3b && a3c && a3d);
 
 	//// STRCPY, STRNCPY, STRCAT, STRNCAT ////
@@ -65,4 +65,4 @@ static __global__ void g_string_test1()
 	//extern __device__ char *strerror_(int errnum);
 
 }
-cudaError_t string_test1() { g_string_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t string_test1() { cudaLaunchGrid(g_string_test1, 1, 1)(); return cudaDeviceSynchronize(); }
@@ -7,4 +7,4 @@ static __global__ void g_sys_stat_test1()
 {
 	printf("sys_stat_test1\n");
 }
-cudaError_t sys_stat_test1() { g_sys_stat_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
\ No newline at end of file
+cudaError_t sys_stat_test1() { cudaLaunchGrid(g_sys_stat_test1, 1, 1)(); return cudaDeviceSynchronize(); }
\ No newline at end of file
@@ -24,4 +24,4 @@ static __global__ void g_time_test1()
 	//__forceinline __device__ char *ctime_(const time_t *timer);
 
 }
-cudaError_t time_test1() { g_time_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t time_test1() { cudaLaunchGrid(g_time_test1, 1, 1)(); return cudaDeviceSynchronize(); }
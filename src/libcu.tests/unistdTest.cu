@@ -51,4 +51,4 @@ static __global__ void g_unistd_test1()
 	//__forceinline __device__ int rmdir_(const char *path); #sentinel-branch
 
 }
-cudaError_t unistd_test1() { g_unistd_test1<<<1, 1>>>(); return cudaDeviceSynchronize(); }
+cudaError_t unistd_test1() { cudaLaunchGrid(g_unistd_test1, 1, 1)(); return cudaDeviceSynchronize(); }
@@ -2,7 +2,7 @@
 
 __BEGIN_DECLS;
 
-extern __constant__ unsigned char __curtUpperToLower[256] = {
+__constant__ unsigned char __curtUpperToLower[256] = {
 	0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17,
 	18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35,
 	36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53,
@@ -20,7 +20,7 @@ extern __constant__ unsigned char __curtUpperToLower[256] = {
 	252,253,254,255
 };
 
-extern __constant__ unsigned char __curtCtypeMap[256] = {
+__constant__ unsigned char __curtCtypeMap[256] = {
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 00..07    ........ */
 	0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00,  /* 08..0f    ........ */
 	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 10..17    ........ */
@@ -4,7 +4,7 @@
 
 struct cuDIR {
 	struct DIR dir;
-	void *listIdx; void *list;
+	dirCursor_t cursor;
 	int fakeIdx; int fake;
 };
 
@@ -14,13 +14,10 @@ __constant__ struct dirent _dirpFakes[2] = { { 0, 0, 2, 0, ".." }, { 0, 0, 1, 0,
 __device__ DIR *opendir_(const char *name)
 {
 	if (ISHOSTPATH(name)) { dirent_opendir msg(name); return newhostptr<DIR>(msg.RC); }
-	dirEnt_t *ent = fsystemOpendir(name);
-	if (!ent) return nullptr;
 	cuDIR *dirp = (cuDIR *)malloc(sizeof(cuDIR));
-	memcpy(dirp, ent, sizeof(dirEnt_t));
-	// set first file
-	dirp->list = dirp->listIdx = ent->u.list;
-	dirp->fake = dirp->fakeIdx = ent != &__iob_root ? 2 : 0;
+	if (!fsystemCursorOpen(name, &dirp->cursor)) { free(dirp); return nullptr; }
+	memcpy(dirp, dirp->cursor.dir, sizeof(dirent));
+	dirp->fake = dirp->fakeIdx = dirp->cursor.dir != &__iob_root ? 2 : 0;
 	return (DIR *)dirp;
 }
 
@@ -29,6 +26,7 @@ __device__ int closedir_(DIR *dirp)
 {
 	if (ISHOSTPTR(dirp)) { dirent_closedir msg(hostptr<DIR>(dirp)); freehostptr<DIR>(dirp); return msg.RC; }
 	if (!dirp) return -1;
+	fsystemCursorClose(&((cuDIR *)dirp)->cursor);
 	free(dirp);
 	return 0;
 }
@@ -41,12 +39,10 @@ __device__ struct dirent *readdir_(DIR *dirp)
 {
 	if (ISHOSTPTR(dirp)) { dirent_readdir msg(hostptr<DIR>(dirp)); return msg.RC; }
 	cuDIR *p = (cuDIR *)dirp;
-	if (!p || !p->listIdx) return nullptr;
+	if (!p || p->cursor.at == p->cursor.count) return nullptr;
 	if (p->fakeIdx)
 		return (struct dirent *)&_dirpFakes[--p->fakeIdx];
-	memcpy(p, p->listIdx, sizeof(dirent));
-	p->listIdx = ((dirEnt_t *)p->listIdx)->next;
-	return (struct dirent *)p;
+	return fsystemCursorRead(&p->cursor, &p->dir.ent) ? &p->dir.ent : nullptr;
 }
 
 #ifdef __USE_LARGEFILE64
@@ -54,12 +50,10 @@ __device__ struct dirent64 *readdir64_(DIR *dirp)
 {
 	if (ISHOSTPTR(dirp)) { dirent_readdir64 msg(hostptr<DIR>(dirp)); return msg.RC; }
 	cuDIR *p = (cuDIR *)dirp;
-	if (!p || !p->listIdx) return nullptr;
+	if (!p || p->cursor.at == p->cursor.count) return nullptr;
 	if (p->fakeIdx)
 		return (struct dirent *)&_dirpFakes[--p->fakeIdx];
-	memcpy(p, p->listIdx, sizeof(dirent));
-	p->listIdx = ((dirEnt_t *)p->listIdx)->next;
-	return (struct dirent *)p;
+	return fsystemCursorRead(&p->cursor, &p->dir.ent) ? (struct dirent *)&p->dir.ent : nullptr;
 }
 #endif
 
@@ -68,8 +62,7 @@ __device__ void rewinddir_(DIR *dirp)
 {
 	if (ISHOSTPTR(dirp)) { dirent_rewinddir msg(hostptr<DIR>(dirp)); return; }
 	cuDIR *p = (cuDIR *)dirp;
-	memcpy(p, p->list, sizeof(dirent));
-	p->listIdx = (dirEnt_t *)p->list;
+	fsystemCursorRewind(&p->cursor);
 	p->fakeIdx = p->fake;
 }
 
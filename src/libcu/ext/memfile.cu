@@ -26,6 +26,7 @@ extern "C" {
 		fileChunk_t *first;			// Head of in-memory chunk-list
 		filePoint_t endpoint;		// Pointer to the end of the file
 		filePoint_t readpoint;		// Pointer to the end of the last xRead()
+		const uint8_t *extent;		// Contents served in place until the first write, see memfileMap
 	} memfile_t;
 
 	__constant__ int __sizeofMemfile_t = sizeof(memfile_t);
@@ -36,11 +37,23 @@ extern "C" {
 		f->opened = true;
 	}
 
+	/* Open the file on size bytes at data, read in place; data must outlive the file, or its first write, which copies them to chunks. */
+	__device__ void memfileMap(memfile_t *f, const void *data, int64_t size)
+	{
+		memfileOpen(f);
+		f->extent = (const uint8_t *)data;
+		f->endpoint.offset = size;
+	}
+
 #define MIN(a, b) ((a) < (b) ? a : b)
 	__device__ void memfileRead(memfile_t *f, void *buffer, int amount, int64_t offset)
 	{
 		// never try to read past the end of an in-memory file
 		assert(offset + amount <= f->endpoint.offset);
+		if (f->extent) {
+			memcpy(buffer, f->extent + offset, amount);
+			return;
+		}
 		fileChunk_t *chunk;
 		if (f->readpoint.offset != offset || offset == 0) {
 			int64_t offset2 = 0;
@@ -68,6 +81,14 @@ extern "C" {
 	{
 		// An in-memory file should only ever be appended to.
 		assert(offset == f->endpoint.offset);
+		// a mapped file moves to chunks first
+		if (f->extent) {
+			const uint8_t *extent = f->extent;
+			int64_t size = f->endpoint.offset;
+			f->extent = nullptr; f->endpoint.offset = 0;
+			if (size && !memfileWrite(f, extent, (int)size, 0))
+				return false;
+		}
 		uint8_t *b = (uint8_t *)buffer;
 		while (amount > 0) {
 			fileChunk_t *chunk = f->endpoint.chunk;
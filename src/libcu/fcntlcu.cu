@@ -9,7 +9,7 @@ __BEGIN_DECLS;
 
 __device__ int fcntlv_(int fd, int cmd, va_list va)
 {
-#ifdef __CUDA_ARCH__
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 	if (ISHOSTHANDLE(fd)) { fcntl_fcntl msg(fd, cmd, va.i?va_arg(va, int):0); return msg.RC; }
 #endif
 	panic("Not Implemented");
@@ -32,7 +32,7 @@ __device__ int fcntlv_(int fd, int cmd, va_list va)
 #ifdef __USE_LARGEFILE64
 __device__ int fcntl64v_(int fd, int cmd, va_list va)
 {
-#ifdef __CUDA_ARCH__
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 	if (ISHOSTHANDLE(fd)) { fcntl_fcntl msg(fd, cmd, va.i?va_arg(va, int):0); return msg.RC; }
 #endif
 	panic("Not Implemented");
@@ -41,7 +41,7 @@ __device__ int fcntl64v_(int fd, int cmd, va_list va)
 
 __device__ int openv_(const char *file, int oflag, va_list va)
 {
-#ifdef __CUDA_ARCH__
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 	if (ISHOSTPATH(file)) { fcntl_open msg(file, oflag, va.i?va_arg(va, int):0); return msg.RC; }
 #endif
 	int fd; fsystemOpen(file, oflag, &fd); return fd;
@@ -49,7 +49,7 @@ __device__ int openv_(const char *file, int oflag, va_list va)
 #ifdef __USE_LARGEFILE64
 __device__ int openv64_(const char *file, int oflag, va_list va)
 {
-#ifdef __CUDA_ARCH__
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 	if (ISHOSTPATH(file)) { fcntl_open msg(file, oflag, va.i?va_arg(va, int):0); return msg.RC; }
 #endif
 	int fd; fsystemOpen(file, oflag, &fd); return fd;
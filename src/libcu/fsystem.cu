@@ -2,65 +2,334 @@
 #include <stdlibcu.h>
 #include <stdiocu.h>
 #include <stringcu.h>
-#include <ext/hash.h>
+#include <ctypecu.h>
 #include <errnocu.h>
 #include <assert.h>
 
 __BEGIN_DECLS;
 
-// FILES
-#pragma region FILES
+// SLOTS
+#pragma region SLOTS
 
-typedef struct __align__(8) {
-	file_t *file;			// reference
-	unsigned short id;		// ID of author
-	unsigned short threadid;// thread ID of author
-} fileRef;
+/* Take a slot, a freed one if there is any else the next never used, setting slot to it and returning its index; -1 with EMFILE once
+** CORE_MAXFILESTREAM are in use. */
+__device__ int slotGet(slotTable_t *t, void **slot)
+{
+	int index;
+	// pop the free stack, a free slot's first int links the next; a slot popped and pushed back meanwhile has bumped the tag, failing the swap
+	unsigned long long head = t->freeHead, prev;
+	while (head & 0xFFFFFFFF) {
+		index = (int)(head & 0xFFFFFFFF) - 1;
+		unsigned long long next = (head & 0xFFFFFFFF00000000ULL) | (unsigned int)*(volatile int *)slotAt(t, index);
+		if ((prev = atomicCAS((unsigned long long *)&t->freeHead, head, next)) == head)
+			goto got;
+		head = prev;
+	}
+	// else grow, the first to need a segment installs it
+	if (t->next >= CORE_MAXFILESTREAM || (index = atomicAdd((int *)&t->next, 1)) >= CORE_MAXFILESTREAM) {
+		_set_errno(EMFILE);
+		*slot = nullptr;
+		return -1;
+	}
+	{
+		int s = index / CORE_SLOTSEGMENT;
+		if (!t->segments[s]) {
+			char *segment = (char *)malloc(CORE_SLOTSEGMENT * t->size);
+			if (!segment)
+				panic("slotGet: out of memory");
+			// the bounds take in the segment before anyone can be handed a slot of it, one that loses the swap below only widens them
+			unsigned long long low = (unsigned long long)segment, high = low + CORE_SLOTSEGMENT * t->size, prevLow;
+			for (unsigned long long lowNow = t->low; (!lowNow || low < lowNow) && (prevLow = atomicCAS((unsigned long long *)&t->low, lowNow, low)) != lowNow; lowNow = prevLow) { }
+			atomicMax((unsigned long long *)&t->high, high);
+			__threadfence();
+			if (atomicCAS((unsigned long long *)&t->segments[s], 0ULL, (unsigned long long)segment))
+				free(segment);
+			if (s >= t->segmentCount)
+				atomicMax((int *)&t->segmentCount, s + 1);
+		}
+	}
+got:
+	int used = atomicAdd((int *)&t->used, 1) + 1;
+	if (used > t->highWater)
+		atomicMax((int *)&t->highWater, used);
+	*slot = slotAt(t, index);
+	return index;
+}
 
-__device__ fileRef __iob_fileRefs[CORE_MAXFILESTREAM]; // Start of circular buffer (set up by host)
-volatile __device__ fileRef *__iob_freeFilePtr = __iob_fileRefs; // Current atomically-incremented non-wrapped offset
-volatile __device__ fileRef *__iob_retnFilePtr = __iob_fileRefs; // Current atomically-incremented non-wrapped offset
-__constant__ file_t __iob_files[CORE_MAXFILESTREAM];
+/* Push a slot on the free stack. */
+__device__ void slotFree(slotTable_t *t, int index)
+{
+	volatile int *link = (volatile int *)slotAt(t, index);
+	unsigned long long head = t->freeHead, prev;
+	do {
+		prev = head;
+		*link = (int)(prev & 0xFFFFFFFF);
+		__threadfence();
+	} while ((head = atomicCAS((unsigned long long *)&t->freeHead, prev, ((prev >> 32) + 1) << 32 | (unsigned int)(index + 1))) != prev);
+	atomicSub((int *)&t->used, 1);
+}
 
-static __device__ __forceinline void writeFileRef(fileRef *ref, file_t *f)
+/* Index of the slot at ptr, -1 if ptr is not in the table. */
+__device__ int slotIndexOf(slotTable_t *t, const void *ptr)
 {
-	ref->file = f;
-	ref->id = gridDim.x*blockIdx.y + blockIdx.x;
-	ref->threadid = blockDim.x*blockDim.y*threadIdx.z + blockDim.x*threadIdx.y + threadIdx.x;
+	if (!slotWithin(t, ptr)) return -1;
+	int segmentCount = t->segmentCount, extent = CORE_SLOTSEGMENT * t->size;
+	for (int s = 0; s < segmentCount; s++) {
+		char *segment = t->segments[s];
+		if (segment && (char *)ptr >= segment && (char *)ptr < segment + extent)
+			return s * CORE_SLOTSEGMENT + (int)((char *)ptr - segment) / t->size;
+	}
+	return -1;
 }
 
+__device__ void slotGetStats(slotTable_t *t, int *used, int *highWater)
+{
+	if (used) *used = t->used;
+	if (highWater) *highWater = t->highWater;
+}
+
+#pragma endregion
+
+// FILES
+#pragma region FILES
+
+__device__ slotTable_t __iob_files = SLOTTABLEINIT(sizeof(file_t));
+
 static __device__ int fileGet(file_t **file)
 {
-	// advance circular buffer
-	size_t offset = (atomicAdd((uintptr_t *)&__iob_freeFilePtr, sizeof(fileRef)) - (size_t)&__iob_fileRefs);
-	offset %= (sizeof(fileRef)*CORE_MAXFILESTREAM);
-	int offsetId = offset / sizeof(fileRef);
-	fileRef *ref = (fileRef *)((char *)&__iob_fileRefs + offset);
-	file_t *f = ref->file;
-	if (!f) {
-		f = &__iob_files[offsetId];
-		writeFileRef(ref, f);
-	}
-	*file = f;
-	return GETFD(offsetId);
+	int index = slotGet(&__iob_files, (void **)file);
+	return index < 0 ? -1 : GETFD(index);
 }
 
 static __device__ void fileFree(int fd)
 {
-	//if (!f) return;
-	file_t *f = GETFILE(fd);
-	// advance circular buffer
-	size_t offset = atomicAdd((uintptr_t *)&__iob_retnFilePtr, sizeof(fileRef)) - (size_t)&__iob_fileRefs;
-	offset %= (sizeof(fileRef)*CORE_MAXFILESTREAM);
-	fileRef *ref = (fileRef *)((char *)&__iob_fileRefs + offset);
-	writeFileRef(ref, f);
+	slotFree(&__iob_files, GETFD(fd));
 }
 
 #pragma endregion
 
 __device__ char __cwd[MAX_PATH] = ":\\";
-__device__ dirEnt_t __iob_root = { { 0, 0, 0, 1, ":\\" }, nullptr, nullptr };
-__device__ hash_t __iob_dir = HASHINIT;
+__device__ dirEnt_t __iob_root = { { 0, 0, 0, 1, ":\\" }, nullptr, nullptr, nullptr, nullptr, 0, false };
+static __device__ dirEnt_t *__cwdEnt = &__iob_root; // node __cwd resolved to, relative paths start here
+
+// WALKERS
+#pragma region WALKERS
+
+/* Every call walks the tree without locks, so what a writer takes out of it is only retired, to be freed once no walk is left that
+** could have reached it: a walk ending with no other running frees what it took off the retired lists, else hands them back. DIR streams
+** and descriptors outlive their walk, so they pin the entities they stand on and the last unpin frees one retired meanwhile. */
+static __device__ volatile int __iob_walkers;
+static __device__ dirEnt_t *volatile __iob_retiredEnts; // linked through prev
+static __device__ dirIndex_t *volatile __iob_retiredIndexes;
+
+static __device__ void freeEnt(dirEnt_t *ent);
+
+static __device__ void retireEnts(dirEnt_t *first, dirEnt_t *last)
+{
+	dirEnt_t *head;
+	do {
+		head = __iob_retiredEnts;
+		last->prev = head;
+		__threadfence();
+	} while ((dirEnt_t *)atomicCAS((unsigned long long *)&__iob_retiredEnts, (unsigned long long)head, (unsigned long long)first) != head);
+}
+#define retireEnt(ent) retireEnts(ent, ent)
+
+/* Pin ent, reached in a walk. */
+static __device__ __forceinline dirEnt_t *pinEnt(dirEnt_t *ent)
+{
+	if (ent) atomicAdd((int *)&ent->pins, 1);
+	return ent;
+}
+
+static __device__ void unpinEnt(dirEnt_t *ent)
+{
+	if (ent && atomicSub((int *)&ent->pins, 1) == ENT_FREEING + 1)
+		freeEnt(ent);
+}
+
+/* Free ent, out of the tree, unless it is pinned: then its last unpin does. */
+static __device__ void releaseEnt(dirEnt_t *ent)
+{
+	ent->removed = true;
+	__threadfence();
+	if (!atomicOr((int *)&ent->pins, ENT_FREEING))
+		freeEnt(ent);
+}
+
+static __device__ void retireIndexes(dirIndex_t *first, dirIndex_t *last)
+{
+	dirIndex_t *head;
+	do {
+		head = __iob_retiredIndexes;
+		last->retired = head;
+		__threadfence();
+	} while ((dirIndex_t *)atomicCAS((unsigned long long *)&__iob_retiredIndexes, (unsigned long long)head, (unsigned long long)first) != head);
+}
+#define retireIndex(index) retireIndexes(index, index)
+
+static __device__ __forceinline void walkBegin()
+{
+	atomicAdd((int *)&__iob_walkers, 1);
+	__threadfence();
+}
+
+static __device__ void walkEnd()
+{
+	if (!__iob_retiredEnts && !__iob_retiredIndexes) {
+		atomicSub((int *)&__iob_walkers, 1);
+		return;
+	}
+	// what is taken here was out of the tree before, so once the count drops to none no walk can be on it
+	dirEnt_t *ents = (dirEnt_t *)atomicExch((unsigned long long *)&__iob_retiredEnts, 0ULL);
+	dirIndex_t *indexes = (dirIndex_t *)atomicExch((unsigned long long *)&__iob_retiredIndexes, 0ULL);
+	if (atomicSub((int *)&__iob_walkers, 1) == 1) {
+		while (ents) { dirEnt_t *next = ents->prev; releaseEnt(ents); ents = next; }
+		while (indexes) { dirIndex_t *next = indexes->retired; free(indexes); indexes = next; }
+		return;
+	}
+	if (ents) { dirEnt_t *last = ents; while (last->prev) last = last->prev; retireEnts(ents, last); }
+	if (indexes) { dirIndex_t *last = indexes; while (last->retired) last = last->retired; retireIndexes(indexes, last); }
+}
+
+/* Counts a call as a walk for as long as it runs. */
+struct fsystemWalk {
+	__device__ fsystemWalk() { walkBegin(); }
+	__device__ ~fsystemWalk() { walkEnd(); }
+};
+
+#pragma endregion
+
+// LOCKS
+#pragma region LOCKS
+
+static __device__ __forceinline bool isRepeat(volatile int **locks, int i)
+{
+	for (int j = 0; j < i; j++)
+		if (locks[j] == locks[i]) return true;
+	return false;
+}
+
+static __device__ void unlockAll(volatile int **locks, int n)
+{
+	__threadfence();
+	for (int i = 0; i < n; i++)
+		if (locks[i] && !isRepeat(locks, i))
+			atomicExch((int *)locks[i], 0);
+}
+
+/* Take all of locks or none, nullptr ones and repeats skipped. Callers loop on it with the critical section in the loop, as
+** HOSTBUFFER_LOCKED does, so a lane that loses loops back around instead of spinning ahead of the lane that won; and as no lock is held
+** while waiting on another, writers taking several cannot deadlock. */
+static __device__ bool lockAll(volatile int **locks, int n)
+{
+	for (int i = 0; i < n; i++)
+		if (locks[i] && !isRepeat(locks, i) && atomicCAS((int *)locks[i], 0, 1)) {
+			unlockAll(locks, i);
+			return false;
+		}
+	__threadfence();
+	return true;
+}
+
+#pragma endregion
+
+// INDEX
+#pragma region INDEX
+
+static __device__ unsigned int nameHash(const char *name)
+{
+	unsigned int h = 0;
+	unsigned char c;
+	while ((c = (unsigned char)*name++)) { h += __curtUpperToLower[c]; h *= 0x9e3779b1; }
+	return h ^ (h >> 16);
+}
+
+/* Whether ent is named name. A rename takes ent out of the index before rewriting its name, so a name caught mid-rewrite is no match. */
+static __device__ bool nameIs(dirEnt_t *ent, const char *name)
+{
+	unsigned int seq = ent->nameSeq;
+	__threadfence();
+	bool is = !stricmp(ent->dir.d_name, name);
+	__threadfence();
+	return is && !(seq & 1) && ent->nameSeq == seq;
+}
+
+/* Copy ent's dirent to d, again if a rename rewrote the name meanwhile. */
+static __device__ void copyDirent(dirEnt_t *ent, dirent *d)
+{
+	unsigned int seq;
+	do {
+		seq = ent->nameSeq;
+		__threadfence();
+		memcpy(d, &ent->dir, sizeof(dirent));
+		__threadfence();
+	} while ((seq & 1) || ent->nameSeq != seq);
+}
+
+/* The entity name in dir, dir itself for an empty name. Takes no lock: a slot only ever goes from empty to an entity, published whole,
+** or between an entity and DIRINDEX_REMOVED, and an index replaced stays readable until the walk ends. */
+static __device__ dirEnt_t *findEnt(dirEnt_t *dir, const char *name)
+{
+	if (!name[0]) return dir;
+	dirIndex_t *index = dir->index;
+	if (!index) return nullptr;
+	unsigned int mask = index->size - 1;
+	for (unsigned int i = nameHash(name) & mask; ; i = (i + 1) & mask) {
+		dirEnt_t *ent = index->slots[i];
+		if (!ent) return nullptr;
+		if (ent != DIRINDEX_REMOVED && nameIs(ent, name)) return ent;
+	}
+}
+
+static __device__ void indexPut(dirIndex_t *index, dirEnt_t *ent)
+{
+	unsigned int mask = index->size - 1, i = nameHash(ent->dir.d_name) & mask;
+	while (index->slots[i] && index->slots[i] != DIRINDEX_REMOVED) i = (i + 1) & mask;
+	if (!index->slots[i]) index->used++;
+	index->count++;
+	__threadfence();
+	index->slots[i] = ent;
+}
+
+/* Add ent to dir's index, replacing the index by one twice the entities when three quarters of its slots are taken. The caller holds
+** dir's lock. */
+static __device__ void indexAdd(dirEnt_t *dir, dirEnt_t *ent)
+{
+	dirIndex_t *index = dir->index;
+	if (!index || (index->used + 1) * 4 > index->size * 3) {
+		int size = 8, count = index ? index->count : 0;
+		while ((count + 1) * 2 > size) size <<= 1;
+		dirIndex_t *newIndex = (dirIndex_t *)malloc(sizeof(dirIndex_t) + (size - 1) * sizeof(dirEnt_t *));
+		memset(newIndex, 0, sizeof(dirIndex_t) + (size - 1) * sizeof(dirEnt_t *));
+		newIndex->size = size;
+		if (index)
+			for (int i = 0; i < index->size; i++) {
+				dirEnt_t *p = index->slots[i];
+				if (p && p != DIRINDEX_REMOVED) indexPut(newIndex, p);
+			}
+		__threadfence();
+		dir->index = newIndex;
+		if (index) retireIndex(index);
+		index = newIndex;
+	}
+	indexPut(index, ent);
+}
+
+/* The caller holds dir's lock. */
+static __device__ void indexRemove(dirEnt_t *dir, dirEnt_t *ent)
+{
+	dirIndex_t *index = dir->index;
+	unsigned int mask = index->size - 1;
+	for (unsigned int i = nameHash(ent->dir.d_name) & mask; index->slots[i]; i = (i + 1) & mask)
+		if (index->slots[i] == ent) {
+			index->slots[i] = DIRINDEX_REMOVED;
+			index->count--;
+			return;
+		}
+}
+
+#pragma endregion
 
 __device__ void expandPath(const char *path, char *newPath)
 {
@@ -91,197 +360,532 @@ __device__ void expandPath(const char *path, char *newPath)
 	d[c == '.' && i == 2 ? -2 : i == 1 ? -1 : 0] = 0;
 }
 
-static __device__ dirEnt_t *createEnt(dirEnt_t *parentEnt, const char *path, const char *name, int type, int extraSize)
+/* Walk path a component at a time, from the root when absolute or from the cwd's node when relative, with '.' and '..' taken on the
+** way. Returns the directory holding the last component and copies that component to name, empty when the path names the directory
+** itself. Returns nullptr with errno set when a directory on the way is missing. */
+static __device__ dirEnt_t *resolvePath(const char *path, char *name)
+{
+	dirEnt_t *dir = path[0] == ':' || path[0] == '\\' || path[0] == '/' ? &__iob_root : __cwdEnt;
+	const char *s = path[0] == ':' ? path + 1 : path;
+	name[0] = 0;
+	while (true) {
+		while (*s == '\\' || *s == '/') s++;
+		if (!*s) return dir;
+		// another component follows, so the last one must be a directory
+		if (name[0]) {
+			dirEnt_t *ent = findEnt(dir, name);
+			if (!ent || ent->dir.d_type != 1) {
+				_set_errno(!ent ? ENOENT : ENOTDIR);
+				return nullptr;
+			}
+			dir = ent;
+		}
+		const char *end = s;
+		while (*end && *end != '\\' && *end != '/') end++;
+		int length = (int)(end - s);
+		if (length >= MAX_PATH) {
+			_set_errno(ENAMETOOLONG);
+			return nullptr;
+		}
+		if (length == 1 && s[0] == '.') name[0] = 0; // self directory
+		else if (length == 2 && s[0] == '.' && s[1] == '.') { name[0] = 0; if (dir->parent) dir = dir->parent; } // parent directory
+		else { memcpy(name, s, length); name[length] = 0; }
+		s = end;
+	}
+}
+
+/* Add ent to parentEnt's index and to the front of its list, in constant time: a DIR stream sorts what it finds when it opens, so the list
+** keeps no order. The caller holds parentEnt's lock. */
+static __device__ void linkEnt(dirEnt_t *parentEnt, dirEnt_t *ent)
+{
+	ent->parent = parentEnt;
+	dirEnt_t *next = parentEnt->u.list;
+	ent->prev = nullptr; ent->next = next;
+	indexAdd(parentEnt, ent);
+	if (next) next->prev = ent;
+	__threadfence();
+	parentEnt->u.list = ent;
+}
+
+/* A new entity, whole but in no directory yet. */
+static __device__ dirEnt_t *createEnt(const char *name, int type, int extraSize)
 {
 	dirEnt_t *ent = (dirEnt_t *)malloc(_ROUND64(sizeof(dirEnt_t)) + extraSize);
-	char *newPath = (char *)malloc(strlen(path));
-	strcpy(newPath, path);
-	if (hashInsert(&__iob_dir, newPath, ent))
-		panic("removed entity");
-	ent->path = newPath;
+	memset(ent, 0, sizeof(dirEnt_t));
 	ent->dir.d_type = type;
 	strcpy(ent->dir.d_name, name);
-	// add to directory
-	ent->next = parentEnt->u.list; parentEnt->u.list = ent;
+	ent->dir.d_namlen = strlen(name);
+	if (type == 2) {
+		ent->u.file = (memfile_t *)((char *)ent + _ROUND64(sizeof(dirEnt_t)));
+		memfileOpen(ent->u.file);
+	}
 	return ent;
 }
 
+/* Take ent out of its directory's index and list. ent->next is left for a walk standing on ent. The caller holds the directory's lock. */
+static __device__ void unlinkEnt(dirEnt_t *ent)
+{
+	dirEnt_t *parentEnt = ent->parent;
+	indexRemove(parentEnt, ent);
+	if (ent->prev) ent->prev->next = ent->next;
+	else parentEnt->u.list = ent->next;
+	if (ent->next) ent->next->prev = ent->prev;
+}
+
+/* Take ent out of its directory for good, retiring it. The caller holds the locks of the directory and, for a directory, of ent. */
+static __device__ void removeEnt(dirEnt_t *ent)
+{
+	unlinkEnt(ent);
+	ent->removed = true;
+	// the cwd goes with its directory
+	if (ent == __cwdEnt) { __cwdEnt = &__iob_root; strcpy(__cwd, ":\\"); }
+	retireEnt(ent);
+}
+
 static __device__ void freeEnt(dirEnt_t *ent)
 {
 	if (ent->dir.d_type == 1) {
 		dirEnt_t *p = ent->u.list;
 		while (p) {
 			dirEnt_t *next = p->next;
-			freeEnt(p);
+			releaseEnt(p);
 			p = next;
 		}
+		free(ent->index); ent->index = nullptr;
 	} else if (ent->dir.d_type == 2)
 		memfileClose(ent->u.file);
-	if (ent != &__iob_root) {
-		free(ent->path);
+	if (ent != &__iob_root)
 		free(ent);
-	}
 	else __iob_root.u.list = nullptr;
 }
 
-static __device__ dirEnt_t *findDir(const char *path)
+__device__ int fsystemChdir(const char *path)
 {
-	dirEnt_t *ent = !strcmp(path, ":")
-		? &__iob_root 
-		: (dirEnt_t *)hashFind(&__iob_dir, path);
-	return ent;
+	fsystemWalk walk;
+	char name[MAX_PATH];
+	dirEnt_t *dirEnt = resolvePath(path, name);
+	if (!dirEnt) return -1;
+	dirEnt = findEnt(dirEnt, name);
+	if (!dirEnt || dirEnt->dir.d_type != 1) {
+		_set_errno(!dirEnt ? ENOENT : ENOTDIR);
+		return -1;
+	}
+	if (!fsystemPath(dirEnt, __cwd, MAX_PATH)) return -1;
+	__cwdEnt = dirEnt;
+	return 0;
 }
 
-static __device__ dirEnt_t *findDirInPath(const char *path, const char **file)
+__device__ dirEnt_t *fsystemOpendir(const char *path)
 {
-	char *file2 = strrchr((char *)path, '\\');
-	if (!file2) {
-		_set_errno(EINVAL);
+	fsystemWalk walk;
+	char name[MAX_PATH];
+	dirEnt_t *ent = resolvePath(path, name);
+	if (!ent) return nullptr;
+	ent = findEnt(ent, name);
+	if (!ent || ent->dir.d_type != 1) {
+		_set_errno(!ent ? ENOENT : ENOTDIR);
 		return nullptr;
 	}
-	*file2 = 0;
-	dirEnt_t *ent = !strcmp(path, ":")
-		? &__iob_root 
-		: (dirEnt_t *)hashFind(&__iob_dir, path);
-	*file2 = '\\';
-	*file = file2 + 1;
 	return ent;
 }
 
-__device__ int fsystemChdir(const char *path)
+static __device__ int nameCompare(const void *a, const void *b)
 {
-	char newPath[MAX_PATH]; expandPath(path, newPath);
-	strncpy(__cwd, newPath, MAX_PATH);
-	return 0;
+	return stricmp((*(dirEnt_t **)a)->dir.d_name, (*(dirEnt_t **)b)->dir.d_name);
 }
 
-__device__ dirEnt_t *fsystemOpendir(const char *path)
+/* Pin c's directory's entities and sort them by name. Taken under the directory's lock, which a rename in or out of it also holds, so no
+** name moves while it is compared. */
+static __device__ void cursorFill(dirCursor_t *c)
 {
-	char newPath[MAX_PATH]; expandPath(path, newPath);
-	dirEnt_t *ent = findDir(newPath);
-	if (!ent || ent->dir.d_type != 1) {
-		_set_errno(!ent ? ENOENT : ENOTDIR);
+	c->ents = nullptr; c->count = c->at = 0;
+	for (bool done = false; !done; ) {
+		volatile int *locks[] = { &c->dir->lock };
+		if (!lockAll(locks, 1)) continue;
+		int count = 0;
+		for (dirEnt_t *p = c->dir->u.list; p; p = p->next) count++;
+		if (count && (c->ents = (dirEnt_t **)malloc(count * sizeof(dirEnt_t *)))) {
+			for (dirEnt_t *p = c->dir->u.list; p; p = p->next) c->ents[c->count++] = pinEnt(p);
+			qsort(c->ents, c->count, sizeof(dirEnt_t *), nameCompare);
+		}
+		unlockAll(locks, 1);
+		done = true;
+	}
+}
+
+static __device__ void cursorEmpty(dirCursor_t *c)
+{
+	for (int i = 0; i < c->count; i++) unpinEnt(c->ents[i]);
+	free(c->ents);
+	c->ents = nullptr; c->count = c->at = 0;
+}
+
+/* Stand c before the first entity of the directory at path, pinning it and what it holds. */
+__device__ bool fsystemCursorOpen(const char *path, dirCursor_t *c)
+{
+	fsystemWalk walk;
+	if (!(c->dir = fsystemOpendir(path))) return false;
+	pinEnt(c->dir);
+	cursorFill(c);
+	return true;
+}
+
+/* Copy the entity c stands on to ent and step past it, false at the end. Entities taken out of the directory since it was sorted are
+** passed over, those added since are not seen until a rewind. */
+__device__ bool fsystemCursorRead(dirCursor_t *c, dirent *ent)
+{
+	while (c->at < c->count) {
+		dirEnt_t *p = c->ents[c->at++];
+		if (p->removed || p->parent != c->dir) continue;
+		copyDirent(p, ent);
+		return true;
+	}
+	return false;
+}
+
+__device__ void fsystemCursorRewind(dirCursor_t *c)
+{
+	fsystemWalk walk;
+	cursorEmpty(c);
+	cursorFill(c);
+}
+
+__device__ void fsystemCursorClose(dirCursor_t *c)
+{
+	cursorEmpty(c);
+	unpinEnt(c->dir);
+	c->dir = nullptr;
+}
+
+/* Names are kept per entity, so the path is built on demand from the parents, each name copied once so a rename cannot tear it. */
+__device__ char *fsystemPath(dirEnt_t *ent, char *path, int size)
+{
+	fsystemWalk walk;
+	char built[MAX_PATH];
+	char *d = built + MAX_PATH;
+	dirent name;
+	for (dirEnt_t *p = ent; p->parent; p = p->parent) {
+		copyDirent(p, &name);
+		int length = (int)name.d_namlen + (p->parent->parent ? 1 : 0);
+		if (length > d - built) {
+			_set_errno(ERANGE);
+			return nullptr;
+		}
+		d -= name.d_namlen; memcpy(d, name.d_name, name.d_namlen);
+		if (p->parent->parent) *--d = '\\';
+	}
+	int length = 2 + (int)(built + MAX_PATH - d);
+	if (length >= size) {
+		_set_errno(ERANGE);
 		return nullptr;
 	}
-	return ent;
+	path[0] = ':'; path[1] = '\\'; memcpy(path + 2, d, length - 2); path[length] = 0;
+	return path;
 }
 
-__device__ int fsystemRename(const char *old, const char *new_)
+static __device__ volatile int __iob_renameLock; // renames run one at a time, so no two can move directories below each other
+
+/* The part of fsystemRename under the locks, oldEnt being what newName held when they were taken. */
+static __device__ int renameLocked(dirEnt_t *ent, dirEnt_t *oldParentEnt, dirEnt_t *parentEnt, const char *newName, dirEnt_t *oldEnt)
 {
-	char newPath[MAX_PATH]; expandPath(old, newPath);
-	dirEnt_t *ent = (dirEnt_t *)hashFind(&__iob_dir, old);
-	if (!ent) {
+	if (ent->removed || ent->parent != oldParentEnt || parentEnt->removed) {
 		_set_errno(ENOENT);
 		return -1;
 	}
-	// todo: rename
+	// a directory cannot move below itself
+	for (dirEnt_t *p = parentEnt; p; p = p->parent)
+		if (p == ent) {
+			_set_errno(EINVAL);
+			return -1;
+		}
+	// replace what the new name holds, a file by a file or an empty directory by a directory
+	if (oldEnt == ent && !strcmp(ent->dir.d_name, newName))
+		return 0;
+	if (oldEnt && oldEnt != ent) {
+		if (oldEnt->dir.d_type != ent->dir.d_type || (oldEnt->dir.d_type == 1 && oldEnt->u.list)) {
+			_set_errno(oldEnt->dir.d_type != ent->dir.d_type ? (ent->dir.d_type == 1 ? ENOTDIR : EISDIR) : ENOTEMPTY);
+			return -1;
+		}
+		removeEnt(oldEnt);
+	}
+	// out of the index first, and the name rewritten under nameSeq for walks already holding ent
+	unlinkEnt(ent);
+	ent->nameSeq++;
+	__threadfence();
+	strcpy(ent->dir.d_name, newName);
+	ent->dir.d_namlen = strlen(newName);
+	__threadfence();
+	ent->nameSeq++;
+	linkEnt(parentEnt, ent);
+	// the cwd may have moved with the subtree
+	if (__cwd[0]) fsystemPath(__cwdEnt, __cwd, MAX_PATH);
 	return 0;
 }
 
-__device__ int fsystemUnlink(const char *path, bool enotdir)
+/* Moves the entity to its new parent and name, taking its subtree with it: nothing below it is keyed by path, so the cost is that of
+** one unlink and one link whatever the subtree holds. */
+__device__ int fsystemRename(const char *old, const char *new_)
 {
-	char newPath[MAX_PATH]; expandPath(path, newPath);
-	dirEnt_t *ent = (dirEnt_t *)hashFind(&__iob_dir, newPath);
-	if (!ent) {
+	fsystemWalk walk;
+	char name[MAX_PATH], newName[MAX_PATH];
+	dirEnt_t *ent = resolvePath(old, name);
+	if (!ent) return -1;
+	if (!(ent = findEnt(ent, name))) {
 		_set_errno(ENOENT);
 		return -1;
 	}
-	const char *name;
-	dirEnt_t *parentEnt = findDirInPath(newPath, &name);
-	if (!parentEnt) {
+	dirEnt_t *parentEnt = resolvePath(new_, newName);
+	if (!parentEnt) return -1;
+	if (ent == &__iob_root || !newName[0]) {
+		_set_errno(ent == &__iob_root ? EBUSY : EINVAL);
+		return -1;
+	}
+	dirEnt_t *oldParentEnt = ent->parent;
+	int rc = 0;
+	for (bool done = false; !done; ) {
+		// a directory replaced is locked too, so it stays empty
+		dirEnt_t *oldEnt = findEnt(parentEnt, newName);
+		volatile int *locks[] = { &__iob_renameLock, &oldParentEnt->lock, &parentEnt->lock, oldEnt && oldEnt != ent && oldEnt->dir.d_type == 1 ? &oldEnt->lock : nullptr };
+		if (!lockAll(locks, _LENGTHOF(locks))) continue;
+		// else the new name changed hands before the locks were taken, look again
+		if (findEnt(parentEnt, newName) == oldEnt) {
+			rc = renameLocked(ent, oldParentEnt, parentEnt, newName, oldEnt);
+			done = true;
+		}
+		unlockAll(locks, _LENGTHOF(locks));
+	}
+	return rc;
+}
+
+__device__ int fsystemUnlink(const char *path, bool enotdir)
+{
+	fsystemWalk walk;
+	char name[MAX_PATH];
+	dirEnt_t *ent = resolvePath(path, name);
+	if (!ent) return -1;
+	if (!(ent = findEnt(ent, name))) {
 		_set_errno(ENOENT);
 		return -1;
 	}
 
+	// the root stays
+	if (ent == &__iob_root) {
+		_set_errno(EBUSY);
+		return -1;
+	}
+
 	// error if not directory
 	if (enotdir && ent->dir.d_type != 1) {
 		_set_errno(ENOTDIR);
 		return -1;
 	}
 
-	// directory not empty
-	if (ent->dir.d_type == 1 && ent->u.list) {
-		_set_errno(ENOENT);
-		return -1;
+	// remove from directory, holding a directory's own lock so nothing is added to it meanwhile
+	dirEnt_t *parentEnt = ent->parent;
+	int rc = 0;
+	for (bool done = false; !done; ) {
+		volatile int *locks[] = { &parentEnt->lock, ent->dir.d_type == 1 ? &ent->lock : nullptr };
+		if (!lockAll(locks, _LENGTHOF(locks))) continue;
+		if (ent->removed || ent->parent != parentEnt) { _set_errno(ENOENT); rc = -1; } // removed or moved meanwhile
+		else if (ent->dir.d_type == 1 && ent->u.list) { _set_errno(ENOENT); rc = -1; } // directory not empty
+		else removeEnt(ent);
+		unlockAll(locks, _LENGTHOF(locks));
+		done = true;
 	}
+	return rc;
+}
 
-	// remove from directory
-	dirEnt_t *list = parentEnt->u.list;
-	if (list == ent)
-		parentEnt->u.list = ent->next;
-	else if (list) {
-		dirEnt_t *p = list;
-		while (p->next && p->next != ent)
-			p = p->next;
-		if (p->next == ent)
-			p->next = ent->next;
+/* Link newEnt as name in parentEnt unless another writer got there first, returning the entity name holds and freeing newEnt if it was
+** not used; with replace a file takes the place of a file. Returns nullptr with ENOENT when parentEnt has been removed. */
+static __device__ dirEnt_t *publishEnt(dirEnt_t *parentEnt, const char *name, dirEnt_t *newEnt, bool replace = false)
+{
+	dirEnt_t *ent = nullptr;
+	for (bool done = false; !done; ) {
+		volatile int *locks[] = { &parentEnt->lock };
+		if (!lockAll(locks, 1)) continue;
+		if (parentEnt->removed) _set_errno(ENOENT);
+		else if (!(ent = findEnt(parentEnt, name))) linkEnt(parentEnt, ent = newEnt);
+		else if (replace && ent->dir.d_type == 2 && newEnt->dir.d_type == 2) { removeEnt(ent); linkEnt(parentEnt, ent = newEnt); }
+		unlockAll(locks, 1);
+		done = true;
 	}
-
-	// free entity
-	freeEnt(ent);
-	return 0;
+	if (ent != newEnt)
+		freeEnt(newEnt);
+	return ent;
 }
 
 __device__ dirEnt_t *fsystemMkdir(const char *__restrict path, int mode, int *r)
 {
-	char newPath[MAX_PATH]; expandPath(path, newPath);
-	dirEnt_t *dirEnt = (dirEnt_t *)hashFind(&__iob_dir, newPath);
-	if (dirEnt) {
-		*r = 1;
-		return dirEnt;
-	}
-	const char *name;
-	dirEnt_t *parentEnt = findDirInPath(newPath, &name);
+	fsystemWalk walk;
+	char name[MAX_PATH];
+	dirEnt_t *parentEnt = resolvePath(path, name);
 	if (!parentEnt) {
-		_set_errno(ENOENT);
 		*r = -1;
 		return nullptr;
 	}
+	dirEnt_t *dirEnt = findEnt(parentEnt, name);
+	if (dirEnt) {
+		*r = 1;
+		return dirEnt;
+	}
 	// create directory
-	dirEnt = createEnt(parentEnt, newPath, name, 1, 0);
-	*r = 0;
+	dirEnt_t *newEnt = createEnt(name, 1, 0);
+	dirEnt = publishEnt(parentEnt, name, newEnt);
+	*r = !dirEnt ? -1 : dirEnt != newEnt ? 1 : 0;
 	return dirEnt;
 }
 
 __device__ dirEnt_t *fsystemOpen(const char *__restrict path, int mode, int *fd)
 {
-	char newPath[MAX_PATH]; expandPath(path, newPath);
-	dirEnt_t *fileEnt = (dirEnt_t *)hashFind(&__iob_dir, newPath);
-	if (fileEnt) {
-		file_t *f; *fd = fileGet(&f);
-		f->base = (char *)fileEnt;
-		return fileEnt;
+	fsystemWalk walk;
+	char name[MAX_PATH];
+	dirEnt_t *parentEnt = resolvePath(path, name);
+	if (!parentEnt) {
+		*fd = -1;
+		return nullptr;
 	}
-	if ((mode & 0xF) == O_RDONLY) {
+	dirEnt_t *fileEnt = findEnt(parentEnt, name);
+	if (!fileEnt && (mode & 0xF) == O_RDONLY) {
 		_set_errno(EINVAL); // So illegal mode.
 		*fd = -1;
 		return nullptr;
 	}
-	const char *name;
-	dirEnt_t *parentEnt = findDirInPath(newPath, &name);
-	if (!parentEnt) {
-		_set_errno(ENOENT);
+	// a directory has no memory file to open
+	if (fileEnt && fileEnt->dir.d_type == 1) {
+		_set_errno(EISDIR);
 		*fd = -1;
 		return nullptr;
 	}
-	// create file
-	fileEnt = createEnt(parentEnt, newPath, name, 2, __sizeofMemfile_t);
-	fileEnt->u.file = (memfile_t *)((char *)fileEnt + _ROUND64(sizeof(dirEnt_t)));
-	memfileOpen(fileEnt->u.file);
-	// set to file
-	file_t *f; *fd = fileGet(&f);
-	f->base = (char *)fileEnt;
+	// take the descriptor first, so running out of them leaves no file behind
+	file_t *f;
+	if ((*fd = fileGet(&f)) == -1)
+		return nullptr;
+	// create file, or take the one another writer created meanwhile
+	if (!fileEnt && (!(fileEnt = publishEnt(parentEnt, name, createEnt(name, 2, __sizeofMemfile_t))) || fileEnt->dir.d_type == 1)) {
+		if (fileEnt) _set_errno(EISDIR);
+		fileFree(*fd);
+		*fd = -1;
+		return nullptr;
+	}
+	f->base = (char *)pinEnt(fileEnt);
 	return fileEnt;
 }
 
 __device__ void fsystemClose(int fd)
 {
+	unpinEnt((dirEnt_t *)GETFILE(fd)->base);
 	fileFree(fd);
 }
 
+// IMAGES
+#pragma region IMAGES
+
+/* Adds the image's entities to the tree, its directories merging with those already there and its files replacing theirs. The files are
+** served from the image in place until written, so it must outlive them. Returns -1 with EINVAL, having added nothing, for an image out
+** of shape, a file holding entities among them; stops at the first entity in conflict with the tree, returning -1 with EEXIST for a file
+** where a directory is, or the other way around. */
+__device__ int fsystemLoad(const void *image, size_t size)
+{
+	fsystemWalk walk;
+	const fsimage_t *h = (const fsimage_t *)image;
+	if (!h || size < sizeof(fsimage_t) || h->magic != FSIMAGE_MAGIC || h->version != FSIMAGE_VERSION || h->entCount < 0 || h->nameSize < 0 || h->dataSize < 0 || size < fsimageSize(h)) {
+		_set_errno(EINVAL);
+		return -1;
+	}
+	const fsimageEnt_t *ents = fsimageEnts(h);
+	const char *names = fsimageNames(h), *data = fsimageData(h);
+	// the whole table is checked before anything is added, so an image out of shape leaves the tree as it was
+	for (int i = 0; i < h->entCount; i++) {
+		const fsimageEnt_t *e = &ents[i];
+		if (e->parent < -1 || e->parent >= i || (e->parent >= 0 && ents[e->parent].type != 1) || (e->type != 1 && e->type != 2) || e->namlen <= 0 || e->namlen >= MAX_PATH || e->name < 0 || e->name + e->namlen >= h->nameSize || names[e->name + e->namlen]
+			|| (e->type == 2 && (e->offset < 0 || e->size < 0 || e->offset + e->size > h->dataSize))) {
+			_set_errno(EINVAL);
+			return -1;
+		}
+	}
+	dirEnt_t **loaded = (dirEnt_t **)malloc(h->entCount * sizeof(dirEnt_t *) + 1);
+	if (!loaded) {
+		_set_errno(ENOMEM);
+		return -1;
+	}
+	int rc = 0;
+	for (int i = 0; i < h->entCount; i++) {
+		const fsimageEnt_t *e = &ents[i];
+		const char *name = names + e->name;
+		dirEnt_t *parentEnt = e->parent == -1 ? &__iob_root : loaded[e->parent];
+		dirEnt_t *newEnt = createEnt(name, e->type, e->type == 2 ? __sizeofMemfile_t : 0);
+		if (e->type == 2)
+			memfileMap(newEnt->u.file, data + e->offset, e->size);
+		if (!(loaded[i] = publishEnt(parentEnt, name, newEnt, true))) { rc = -1; break; }
+		if (loaded[i]->dir.d_type != e->type) {
+			_set_errno(EEXIST);
+			rc = -1;
+			break;
+		}
+	}
+	free(loaded);
+	return rc;
+}
+
+struct saveState_t {
+	fsimageEnt_t *ents;			// Where to write, nullptr when only sizing
+	char *names, *data;
+	int entCount, nameSize;
+	long long dataSize;
+};
+
+/* Oldest first, the order fsystemLoad links entities back in, so a loaded image saves the same byte for byte. */
+static __device__ void saveEnts(dirEnt_t *dir, int parent, saveState_t *s)
+{
+	dirEnt_t *p = dir->u.list;
+	while (p && p->next) p = p->next;
+	for (; p; p = p->prev) {
+		int index = s->entCount++;
+		long long fileSize = p->dir.d_type == 2 ? memfileGetFileSize(p->u.file) : 0;
+		if (s->ents) {
+			fsimageEnt_t *e = &s->ents[index];
+			e->parent = parent; e->type = p->dir.d_type; e->name = s->nameSize; e->namlen = (int)p->dir.d_namlen;
+			memcpy(s->names + s->nameSize, p->dir.d_name, p->dir.d_namlen);
+			if (p->dir.d_type == 2) {
+				e->offset = s->dataSize; e->size = fileSize;
+				if (fileSize) memfileRead(p->u.file, s->data + s->dataSize, (int)fileSize, 0);
+			}
+		}
+		s->nameSize += (int)p->dir.d_namlen + 1;
+		s->dataSize += FSIMAGE_ROUND(fileSize);
+		if (p->dir.d_type == 1)
+			saveEnts(p, index, s);
+	}
+}
+
+/* Packs the tree into image in the form fsystemLoad reads, a checkpoint of it, and returns the bytes the image takes; nothing is written
+** unless size covers them. Writers must not run meanwhile. */
+__device__ size_t fsystemSave(void *image, size_t size)
+{
+	fsystemWalk walk;
+	saveState_t s = { nullptr };
+	saveEnts(&__iob_root, -1, &s);
+	fsimage_t h = { FSIMAGE_MAGIC, FSIMAGE_VERSION, s.entCount, FSIMAGE_ROUND(s.nameSize), s.dataSize };
+	size_t total = fsimageSize(&h);
+	if (!image || size < total)
+		return total;
+	memset(image, 0, total);
+	memcpy(image, &h, sizeof(fsimage_t));
+	fsimage_t *image_ = (fsimage_t *)image;
+	saveState_t w = { fsimageEnts(image_), fsimageNames(image_), fsimageData(image_) };
+	saveEnts(&__iob_root, -1, &w);
+	return total;
+}
+
+#pragma endregion
+
+/* Frees the whole tree, with nothing else running. */
 __device__ void fsystemReset()
 {
 	freeEnt(&__iob_root);
+	__cwdEnt = &__iob_root; strcpy(__cwd, ":\\");
+	// and what was retired, as the walk ends alone
+	walkBegin(); walkEnd();
 }
 
-__END_DECLS;
\ No newline at end of file
+__END_DECLS;
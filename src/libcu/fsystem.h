@@ -3,38 +3,103 @@
 #include <crtdefscu.h>
 #include <fcntl.h>
 #include <ext/memfile.h>
+#include <ext/fsimage.h>
 #include <_dirent.h>
 
 __BEGIN_DECLS;
 
+struct dirEnt_t;
+
+/* A directory's entities by name, open addressed so a lookup reads only slots a writer publishes with one store. Replaced whole when it
+** fills, the old one left to lookups still probing it. */
+struct dirIndex_t {
+	dirIndex_t *retired;	// Next index freed once no walker is left
+	int size;				// Slots, a power of two
+	int used;				// Slots holding an entity or DIRINDEX_REMOVED
+	int count;				// Slots holding an entity
+	dirEnt_t *volatile slots[1];
+};
+#define DIRINDEX_REMOVED ((dirEnt_t *)1)
+
 struct dirEnt_t {
-	dirent dir;		// Entry information
-	dirEnt_t *next;	// Next entity in the directory.
-	char *path;		// Path/Key
+	dirent dir;		// Entry information, d_name is the entity's key in its parent
+	dirEnt_t *parent; // Directory holding the entity, nullptr for the root
+	dirEnt_t *volatile next; // Next entity in the directory, newest first
+	dirEnt_t *prev;	// Previous entity in the directory, or the next retired entity once removed
+	dirIndex_t *volatile index; // Entities in the directory by name
+	volatile int lock; // Held by a writer adding to or taking from the directory, lookups never take it
+	bool removed;	// Set under the lock once the directory is gone, so nothing more is added to it
+	volatile int pins; // DIR streams and descriptors standing on the entity, ENT_FREEING added once it is due to be freed
+	volatile unsigned int nameSeq; // Odd while a rename rewrites d_name, readers copy the name again when it moved meanwhile
 	union {
-		dirEnt_t *list;	// List of entities in the directory
+		dirEnt_t *volatile list; // List of entities in the directory, newest first
 		memfile_t *file; // Memory file associated with this element
 	} u;
 };
 
+#define ENT_FREEING 0x40000000
+
+/* Where a directory stream stands: the directory, and its entities as they were when the stream opened or rewound, sorted by name. All
+** are pinned while the stream is open. */
+struct dirCursor_t {
+	dirEnt_t *dir;
+	dirEnt_t **ents;	// nullptr for none
+	int count;
+	int at;			// Entity returned next, count at the end
+};
+
 struct file_t {
-	char *base;
+	char *base;		// The file's entity, pinned while the descriptor is open
 };
 
+#ifndef CORE_SLOTSEGMENT
+#define CORE_SLOTSEGMENT 64 // slots a table grows by
+#endif
+#define SLOT_MAXSEGMENTS ((CORE_MAXFILESTREAM + CORE_SLOTSEGMENT - 1) / CORE_SLOTSEGMENT)
+
+/* A table of fixed size slots, at most CORE_MAXFILESTREAM, grown a segment at a time and never shrunk so a slot's address holds for
+** good. Freed slots go on a lock-free stack whose head carries a tag, bumped on every push, against ABA. */
+struct slotTable_t {
+	int size;						// Bytes a slot
+	char *volatile segments[SLOT_MAXSEGMENTS];
+	volatile int segmentCount;		// Segments below which all installed ones lie
+	volatile unsigned long long low, high; // Bounds of every segment installed, widened before one is, 0 while there are none
+	volatile unsigned long long freeHead; // tag << 32 | index+1 of the first free slot, 0 for none
+	volatile int next;				// Slots handed out from the segments so far
+	volatile int used;				// Slots in use
+	volatile int highWater;			// Most slots ever in use at once
+};
+#define SLOTTABLEINIT(size) { size }
+
+__device__ int slotGet(slotTable_t *t, void **slot);
+__device__ void slotFree(slotTable_t *t, int index);
+__device__ int slotIndexOf(slotTable_t *t, const void *slot);
+__device__ void slotGetStats(slotTable_t *t, int *used, int *highWater);
+#define slotAt(t, index) ((void *)((t)->segments[(index) / CORE_SLOTSEGMENT] + (index) % CORE_SLOTSEGMENT * (t)->size))
+#define slotWithin(t, ptr) ((unsigned long long)(ptr) >= (t)->low && (unsigned long long)(ptr) < (t)->high) // O(1), but not every pointer within is a slot
+
 __device__ void expandPath(const char *path, char *newPath);
 __device__ int fsystemChdir(const char *path);
 __device__ dirEnt_t *fsystemOpendir(const char *path);
+__device__ bool fsystemCursorOpen(const char *path, dirCursor_t *c);
+__device__ bool fsystemCursorRead(dirCursor_t *c, dirent *ent);
+__device__ void fsystemCursorRewind(dirCursor_t *c);
+__device__ void fsystemCursorClose(dirCursor_t *c);
+__device__ char *fsystemPath(dirEnt_t *ent, char *path, int size);
 __device__ int fsystemRename(const char *old, const char *new_);
 __device__ int fsystemUnlink(const char *path, bool enotdir);
 __device__ dirEnt_t *fsystemMkdir(const char *__restrict path, int mode, int *r);
 __device__ dirEnt_t *fsystemOpen(const char *__restrict path, int mode, int *fd);
 __device__ void fsystemClose(int fd);
 __device__ void fsystemReset();
+__device__ int fsystemLoad(const void *image, size_t size);
+__device__ size_t fsystemSave(void *image, size_t size);
 
 extern __device__ dirEnt_t __iob_root;
-extern __constant__ file_t __iob_files[CORE_MAXFILESTREAM];
+extern __device__ slotTable_t __iob_files;
+extern __device__ slotTable_t __iob_streamTable;
 #define GETFD(fd) (INT_MAX-(fd))
-#define GETFILE(fd) (&__iob_files[GETFD(fd)])
+#define GETFILE(fd) ((file_t *)slotAt(&__iob_files, GETFD(fd)))
 
 __END_DECLS;
 #endif  /* _FSYSTEM_H */
\ No newline at end of file
@@ -2,6 +2,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <host_functions.h>
+#include <ctype.h>
+#include <ext/fsimage.h>
+#include <map>
+#include <string>
 
 bool gpuAssert(cudaError_t code, const char *action, const char *file, int line, bool abort)
 {
@@ -113,4 +117,75 @@ char **cudaDeviceTransferStringArray(size_t length, char *const value[], cudaErr
 	cudaErrorCheck(cudaMemcpy(d, h, size, cudaMemcpyHostToDevice));
 	free(h);
 	return (char **)d;
-}
\ No newline at end of file
+}
+
+/* Names compare as the filesystem's do, without case; a path given twice keeps its first file. Returns 0 when a path runs through a file,
+** or names a file where another path made a directory, and when out of memory. */
+size_t fsimageBuild(void *image, size_t size, const fsimageFile_t *files, int count)
+{
+	// the directory table, names still in the paths, and its entities by parent and lowercased name
+	typedef struct { int parent, type, namlen; const char *name; const fsimageFile_t *file; } buildEnt;
+	buildEnt *ents = nullptr;
+	std::map<std::pair<int, std::string>, int> index;
+	int entCount = 0, entCapacity = 0, nameSize = 0;
+	long long dataSize = 0;
+	for (int i = 0; i < count; i++) {
+		const char *s = files[i].path;
+		int parent = -1;
+		while (true) {
+			while (*s == '\\' || *s == '/') s++;
+			if (!*s) break;
+			const char *end = s;
+			while (*end && *end != '\\' && *end != '/') end++;
+			int length = (int)(end - s), e;
+			const char *next = end;
+			while (*next == '\\' || *next == '/') next++;
+			bool file = !*next && !files[i].isDir;
+			std::string key(s, length);
+			for (size_t k = 0; k < key.size(); k++) key[k] = (char)tolower((unsigned char)key[k]);
+			std::map<std::pair<int, std::string>, int>::iterator it = index.find(std::make_pair(parent, key));
+			if (it != index.end()) {
+				e = it->second;
+				if (ents[e].type != (file ? 2 : 1)) { free(ents); return 0; }
+			}
+			else {
+				e = entCount;
+				index[std::make_pair(parent, key)] = e;
+				if (entCount == entCapacity) {
+					int capacity = entCapacity ? entCapacity * 2 : 16;
+					buildEnt *grown = (buildEnt *)realloc(ents, capacity * sizeof(buildEnt));
+					if (!grown) { free(ents); return 0; }
+					ents = grown; entCapacity = capacity;
+				}
+				buildEnt ent = { parent, file ? 2 : 1, length, s, file ? &files[i] : nullptr };
+				ents[entCount++] = ent;
+				nameSize += length + 1;
+				if (file) dataSize += FSIMAGE_ROUND(files[i].size);
+			}
+			parent = e;
+			s = end;
+		}
+	}
+	nameSize = FSIMAGE_ROUND(nameSize);
+	size_t total = sizeof(fsimage_t) + entCount * sizeof(fsimageEnt_t) + nameSize + dataSize;
+	if (image && size >= total) {
+		memset(image, 0, total);
+		fsimage_t *h = (fsimage_t *)image;
+		h->magic = FSIMAGE_MAGIC; h->version = FSIMAGE_VERSION; h->entCount = entCount; h->nameSize = nameSize; h->dataSize = dataSize;
+		fsimageEnt_t *e = fsimageEnts(h);
+		char *names = fsimageNames(h), *data = fsimageData(h);
+		int name = 0; long long offset = 0;
+		for (int i = 0; i < entCount; i++, e++) {
+			e->parent = ents[i].parent; e->type = ents[i].type; e->name = name; e->namlen = ents[i].namlen;
+			memcpy(names + name, ents[i].name, ents[i].namlen);
+			name += ents[i].namlen + 1;
+			if (ents[i].file) {
+				e->offset = offset; e->size = ents[i].file->size;
+				if (e->size) memcpy(data + offset, ents[i].file->data, (size_t)e->size);
+				offset += FSIMAGE_ROUND(e->size);
+			}
+		}
+	}
+	free(ents);
+	return total;
+}
@@ -3,7 +3,11 @@
 #include <assert.h>
 
 #define _ROUND8(x) (((x)+7)&~7)
+#ifdef LIBCU_HOST
+#define panic(fmt, ...) { printf(fmt, __VA_ARGS__); abort(); }
+#else
 #define panic(fmt, ...) { printf(fmt, __VA_ARGS__); asm("trap;"); }
+#endif
 
 #ifdef	__cplusplus
 #define __BEGIN_DECLS extern "C" {
@@ -0,0 +1,144 @@
+#include "sentinel-os.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Host threads standing in for device threads. This follows sentinel-gpu.cu step for step against the producer view of the maps
+// sentinelEmulatorInitialize sets up: tickets come off SetId, nothing rings a doorbell, and every wait is a poll of the slot.
+
+sentinelMap *_sentinelEmulatedMap[SENTINEL_DEVICEMAPS];
+int _sentinelEmulatedMapCount = 1;
+static volatile int _sentinelEmulatedBlocks = 0;
+static thread_local int _emulatedBlock = -1; // block this thread poses as, given out on its first send unless set
+
+static void sentinelEmulatedCollectReady(int thread);
+
+/* Poll the way a device thread would, but yield once the spin runs long so producers sharing a core with the server still progress. */
+static __forceinline void sentinelEmulatedPause(int *polls)
+{
+	if (++*polls < 64) sentinelPause();
+	else sentinelYield();
+}
+
+/* Claim a slot, marshal msg into it and publish it to the host. A ticket forces a reply so the result can be collected later. */
+static void sentinelEmulatedPublish(sentinelMessage *msg, int msgLength, sentinelTicket *ticket)
+{
+	if (_emulatedBlock < 0) _emulatedBlock = sentinelAtomicAddInt(&_sentinelEmulatedBlocks, 1) - 1;
+	int thread = sentinelThreadId();
+	sentinelMap *map = _sentinelEmulatedMap[SENTINEL_ROUTE(_emulatedBlock, thread, _sentinelEmulatedMapCount)];
+	if (!map) {
+		printf("sentinel: emulated device map not defined. did you start the emulator?\n");
+		exit(0);
+	}
+	map = SENTINEL_LANEMAP(map, msg);
+	unsigned int id = (unsigned int)sentinelAtomicAddInt((volatile int *)&map->SetId, 1) - 1;
+	sentinelCommand *cmd = SENTINEL_SLOT(map, id);
+	volatile int *status = (volatile int *)&cmd->Status;
+	// back-pressure: a full ring holds us here until the slot's previous lap is released, which may be one of our own uncollected replies
+	int polls = 0;
+	while (cmd->Seq != (int)id) { sentinelEmulatedCollectReady(thread); sentinelEmulatedPause(&polls); }
+	cmd->Magic = SENTINEL_MAGIC;
+	cmd->Length = msgLength;
+	cmd->Block = _emulatedBlock; cmd->Thread = thread;
+	cmd->Ticket = ticket;
+	char *dataEnd = _MIN(cmd->Data + msgLength + msg->Size, (char *)cmd + SENTINEL_MSGSIZE);
+	char *end = msg->Prepare ? msg->Prepare(msg, cmd->Data, dataEnd, map->Offset) : nullptr;
+	if (msg->Prepare && !end) {
+		printf("msg too long");
+		exit(0);
+	}
+	memcpy(cmd->Data, msg, msgLength);
+	// the server sees what was packed, not the reserve
+	if (end) ((sentinelMessage *)cmd->Data)->Size = (int)(end - (cmd->Data + msgLength));
+	if (ticket) {
+		((sentinelMessage *)cmd->Data)->Wait = true;
+		ticket->Map = map; ticket->Cmd = cmd; ticket->Id = id;
+		ticket->Msg = msg; ticket->Length = msgLength;
+	}
+
+	sentinelMemoryBarrier();
+	*status = 2;
+}
+
+/* Copy the reply back over the sender's message and free the slot. */
+static void sentinelEmulatedCollect(sentinelTicket *ticket)
+{
+	sentinelCommand *cmd = ticket->Cmd;
+	bool wait = ticket->Msg->Wait;
+	memcpy(ticket->Msg, cmd->Data, ticket->Length);
+	ticket->Msg->Wait = wait;
+	if (ticket->Complete)
+		ticket->Complete(ticket->Msg, cmd->Data);
+	cmd->Status = 0;
+	sentinelMemoryBarrier();
+	cmd->Seq = (int)(ticket->Id + SENTINEL_MSGCOUNT);
+	ticket->Cmd = nullptr;
+}
+
+/* Collect every reply already waiting on this thread's outstanding tickets, for a sender held back by a full ring. As a device thread
+** would, it looks for its own stamp on every slot of every map rather than keeping a list. */
+static void sentinelEmulatedCollectReady(int thread)
+{
+	for (int i = 0; i < _sentinelEmulatedMapCount; i++)
+		for (int lane = 0; _sentinelEmulatedMap[i] && lane < SENTINEL_LANES; lane++)
+			for (int slot = 0; slot < SENTINEL_MSGCOUNT; slot++) {
+				sentinelCommand *cmd = SENTINEL_SLOT(_sentinelEmulatedMap[i] + lane, slot);
+				if (cmd->Status != 4) continue;
+				sentinelMemoryBarrier();
+				sentinelTicket *t = cmd->Ticket;
+				if (cmd->Block != _emulatedBlock || cmd->Thread != thread || !t || t->Cmd != cmd) continue;
+				sentinelEmulatedCollect(t); t->Collected = true;
+			}
+}
+
+void sentinelEmulatedSend(sentinelMessage *msg, int msgLength)
+{
+	if (!msg->Wait) { sentinelEmulatedPublish(msg, msgLength, nullptr); return; }
+	sentinelTicket ticket; ticket.Complete = nullptr;
+	sentinelEmulatedPublish(msg, msgLength, &ticket);
+	sentinelEmulatedWait(&ticket);
+}
+
+void sentinelEmulatedSendAsync(sentinelMessage *msg, int msgLength, sentinelTicket *ticket, void (*complete)(void*,char*))
+{
+	ticket->Complete = complete;
+	ticket->Collected = false;
+	sentinelEmulatedPublish(msg, msgLength, ticket);
+}
+
+bool sentinelEmulatedPoll(sentinelTicket *ticket)
+{
+	if (!ticket->Cmd) { ticket->Collected = false; return true; }
+	if (ticket->Cmd->Status != 4) return false;
+	sentinelMemoryBarrier();
+	sentinelEmulatedCollect(ticket);
+	return true;
+}
+
+void sentinelEmulatedWait(sentinelTicket *ticket)
+{
+	int polls = 0;
+	while (!sentinelEmulatedPoll(ticket)) sentinelEmulatedPause(&polls);
+}
+
+/* Send from this thread as block does, routed and stamped with it. -1 gives the thread a block of its own again. */
+void sentinelEmulatedSetBlock(int block)
+{
+	_emulatedBlock = block >= 0 ? block : sentinelAtomicAddInt(&_sentinelEmulatedBlocks, 1) - 1;
+}
+
+/* Collect whichever outstanding ticket replies first. Returns its index, or -1 if none is outstanding. */
+int sentinelEmulatedWaitAny(sentinelTicket *tickets, int count)
+{
+	int polls = 0;
+	while (true) {
+		bool outstanding = false;
+		for (int i = 0; i < count; i++) {
+			if (!tickets[i].Cmd && !tickets[i].Collected) continue;
+			if (sentinelEmulatedPoll(&tickets[i])) return i;
+			outstanding = true;
+		}
+		if (!outstanding) return -1;
+		sentinelEmulatedPause(&polls);
+	}
+}
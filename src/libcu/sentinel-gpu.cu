@@ -5,34 +5,184 @@
 
 __BEGIN_DECLS;
 
-#if HAS_DEVICESENTINEL
+#if HAS_DEVICESENTINEL && defined(LIBCU_HOST)
 
-__device__ volatile unsigned int _sentinelMapId;
+// Compiled as host code there is no device to publish from: each send goes through the emulator as the block of the thread making it.
+// The emulated maps carry no pool, so nothing is ever pooled and every payload is copied through the slot.
 __constant__ sentinelMap *_sentinelDeviceMap[SENTINEL_DEVICEMAPS];
-__device__ void sentinelDeviceSend(sentinelMessage *msg, int msgLength)
+__constant__ int _sentinelDeviceMapCount = 1;
+
+static __forceinline void sentinelDeviceSetBlock() { sentinelEmulatedSetBlock(blockIdx.x + gridDim.x * (blockIdx.y + gridDim.y * blockIdx.z)); }
+__device__ void sentinelDeviceSend(sentinelMessage *msg, int msgLength) { sentinelDeviceSetBlock(); sentinelEmulatedSend(msg, msgLength); }
+__device__ void sentinelDeviceSendAsync(sentinelMessage *msg, int msgLength, sentinelTicket *ticket, void (*complete)(void*,char*)) { sentinelDeviceSetBlock(); sentinelEmulatedSendAsync(msg, msgLength, ticket, complete); }
+__device__ bool sentinelDevicePoll(sentinelTicket *ticket) { return sentinelEmulatedPoll(ticket); }
+__device__ void sentinelDeviceWait(sentinelTicket *ticket) { sentinelEmulatedWait(ticket); }
+__device__ int sentinelDeviceWaitAny(sentinelTicket *tickets, int count) { return sentinelEmulatedWaitAny(tickets, count); }
+__device__ void *sentinelDeviceAlloc(size_t size) { return nullptr; }
+__device__ void sentinelDeviceFree(void *ptr) { }
+__device__ bool sentinelDevicePooled(const void *ptr, size_t size) { return false; }
+
+#elif HAS_DEVICESENTINEL
+
+__constant__ sentinelMap *_sentinelDeviceMap[SENTINEL_DEVICEMAPS];
+__constant__ int _sentinelDeviceMapCount = 1;
+static __device__ void sentinelDeviceCollectReady(int block, int thread);
+
+/* Claim a slot, marshal msg into it and publish it to the host. A ticket forces a reply so the result can be collected later. */
+static __device__ void sentinelDevicePublish(sentinelMessage *msg, int msgLength, sentinelTicket *ticket)
 {
-	sentinelMap *map = _sentinelDeviceMap[_sentinelMapId++ % SENTINEL_DEVICEMAPS];
+	int block = blockIdx.x + gridDim.x * (blockIdx.y + gridDim.y * blockIdx.z);
+	int thread = threadIdx.x + blockDim.x * (threadIdx.y + blockDim.y * threadIdx.z);
+	// routed rather than dealt round robin, so no counter is shared between senders and a block's commands keep their order
+	sentinelMap *map = _sentinelDeviceMap[SENTINEL_ROUTE(block, thread, _sentinelDeviceMapCount)];
 	if (!map)
 		panic("sentinel: device map not defined. did you start sentinel?\n");
-	long id = atomicAdd((int *)&map->SetId, SENTINEL_MSGSIZE);
-	sentinelCommand *cmd = (sentinelCommand *)&map->Data[id%sizeof(map->Data)];
-	volatile long *status = (volatile long *)&cmd->Status;
+	map = SENTINEL_LANEMAP(map, msg);
+	unsigned int id = atomicAdd((unsigned int *)&map->SetId, 1);
+	sentinelCommand *cmd = SENTINEL_SLOT(map, id);
+	volatile int *status = (volatile int *)&cmd->Status;
+	// back-pressure: a full ring holds us here until the slot's previous lap is released, which may be one of our own uncollected replies
+	volatile int *seq = (volatile int *)&cmd->Seq;
+	while (*seq != (int)id) sentinelDeviceCollectReady(block, thread);
 	//cmd->Data = (char *)cmd + _ROUND8(sizeof(sentinelCommand));
 	cmd->Magic = SENTINEL_MAGIC;
 	cmd->Length = msgLength;
-	if (msg->Prepare && !msg->Prepare(msg, cmd->Data, cmd->Data + msgLength + msg->Size, map->Offset))
+	cmd->Block = block;
+	cmd->Thread = thread;
+	cmd->Ticket = ticket;
+	char *dataEnd = _MIN(cmd->Data + msgLength + msg->Size, (char *)cmd + SENTINEL_MSGSIZE);
+	char *end = msg->Prepare ? msg->Prepare(msg, cmd->Data, dataEnd, map->Offset) : nullptr;
+	if (msg->Prepare && !end)
 		panic("msg too long");
 	memcpy(cmd->Data, msg, msgLength);
+	// the host sees what was packed, not the reserve
+	if (end) ((sentinelMessage *)cmd->Data)->Size = (int)(end - (cmd->Data + msgLength));
 	//printf("Msg: %d[%d]'", msg->OP, msgLength); for (int i = 0; i < msgLength; i++) printf("%02x", ((char *)msg)[i] & 0xff); printf("'\n");
+	if (ticket) {
+		((sentinelMessage *)cmd->Data)->Wait = true;
+		ticket->Map = map; ticket->Cmd = cmd; ticket->Id = id;
+		ticket->Msg = msg; ticket->Length = msgLength;
+	}
 
+	__threadfence_system();
 	*status = 2;
-	if (msg->Wait) {
-		unsigned int s_; do { s_ = *status; /*printf("%d ", s_);*/ __syncthreads(); } while (s_ != 4); __syncthreads();
-		memcpy(msg, cmd->Data, msgLength);
-		*status = 0;
+}
+
+/* Copy the reply back over the sender's message and free the slot. */
+static __device__ void sentinelDeviceCollect(sentinelTicket *ticket)
+{
+	sentinelCommand *cmd = ticket->Cmd;
+	bool wait = ticket->Msg->Wait;
+	memcpy(ticket->Msg, cmd->Data, ticket->Length);
+	ticket->Msg->Wait = wait;
+	if (ticket->Complete)
+		ticket->Complete(ticket->Msg, cmd->Data);
+	*(volatile int *)&cmd->Status = 0;
+	__threadfence_system();
+	*(volatile int *)&cmd->Seq = (int)(ticket->Id + SENTINEL_MSGCOUNT);
+	ticket->Cmd = nullptr;
+}
+
+/* Collect every reply already waiting on this thread's outstanding tickets, for a sender held back by a full ring. A device thread keeps
+** no list of them, so it looks for its own stamp on every slot of every map. */
+static __device__ void sentinelDeviceCollectReady(int block, int thread)
+{
+	for (int i = 0; i < _sentinelDeviceMapCount; i++)
+		for (int lane = 0; _sentinelDeviceMap[i] && lane < SENTINEL_LANES; lane++)
+			for (int slot = 0; slot < SENTINEL_MSGCOUNT; slot++) {
+				sentinelCommand *cmd = SENTINEL_SLOT(_sentinelDeviceMap[i] + lane, slot);
+				if (*(volatile int *)&cmd->Status != 4) continue;
+				__threadfence_system();
+				sentinelTicket *t = cmd->Ticket;
+				if (cmd->Block != block || cmd->Thread != thread || !t || t->Cmd != cmd) continue;
+				sentinelDeviceCollect(t); t->Collected = true;
+			}
+}
+
+__device__ void sentinelDeviceSend(sentinelMessage *msg, int msgLength)
+{
+	if (!msg->Wait) { sentinelDevicePublish(msg, msgLength, nullptr); return; }
+	sentinelTicket ticket; ticket.Complete = nullptr;
+	sentinelDevicePublish(msg, msgLength, &ticket);
+	sentinelDeviceWait(&ticket);
+}
+
+__device__ void sentinelDeviceSendAsync(sentinelMessage *msg, int msgLength, sentinelTicket *ticket, void (*complete)(void*,char*))
+{
+	ticket->Complete = complete;
+	ticket->Collected = false;
+	sentinelDevicePublish(msg, msgLength, ticket);
+}
+
+__device__ bool sentinelDevicePoll(sentinelTicket *ticket)
+{
+	if (!ticket->Cmd) { ticket->Collected = false; return true; }
+	if (*(volatile int *)&ticket->Cmd->Status != 4) return false;
+	sentinelDeviceCollect(ticket);
+	return true;
+}
+
+__device__ void sentinelDeviceWait(sentinelTicket *ticket)
+{
+	if (!ticket->Cmd) { ticket->Collected = false; return; }
+	volatile int *status = (volatile int *)&ticket->Cmd->Status;
+	unsigned int s_; do { s_ = *status; /*printf("%d ", s_);*/ __syncthreads(); } while (s_ != 4); __syncthreads();
+	sentinelDeviceCollect(ticket);
+}
+
+/* Collect whichever outstanding ticket replies first. Returns its index, or -1 if none is outstanding. */
+__device__ int sentinelDeviceWaitAny(sentinelTicket *tickets, int count)
+{
+	while (true) {
+		bool outstanding = false;
+		for (int i = 0; i < count; i++) {
+			if (!tickets[i].Cmd && !tickets[i].Collected) continue;
+			if (sentinelDevicePoll(&tickets[i])) return i;
+			outstanding = true;
+		}
+		if (!outstanding) return -1;
+	}
+}
+
+// POOL
+
+__device__ void *sentinelDeviceAlloc(size_t size)
+{
+	int blocks = (int)((size + SENTINEL_POOLBLOCK - 1) / SENTINEL_POOLBLOCK);
+	if (!blocks || blocks > SENTINEL_POOLBLOCKS) return nullptr;
+	char *p = nullptr;
+	for (int i = 0; i < SENTINEL_DEVICEMAPS && !p; i++) {
+		if (!_sentinelDeviceMap[i]) continue;
+		sentinelPool *pool = SENTINEL_POOL(_sentinelDeviceMap[i]);
+		// warp-safe lock: a lane that loses the exchange loops back around instead of spinning ahead of the lane that won
+		for (bool done = false; !done; )
+			if (!atomicCAS((int *)&pool->Lock, 0, 1)) { p = sentinelPoolTake(pool, blocks); __threadfence_system(); atomicExch((int *)&pool->Lock, 0); done = true; }
+	}
+	return p;
+}
+
+__device__ void sentinelDeviceFree(void *ptr)
+{
+	for (int i = 0; ptr && i < SENTINEL_DEVICEMAPS; i++) {
+		if (!_sentinelDeviceMap[i]) continue;
+		sentinelPool *pool = SENTINEL_POOL(_sentinelDeviceMap[i]);
+		if (!SENTINEL_POOLED(pool, ptr, 0)) continue;
+		bool given;
+		for (bool done = false; !done; )
+			if (!atomicCAS((int *)&pool->Lock, 0, 1)) { given = sentinelPoolGive(pool, ptr); __threadfence_system(); atomicExch((int *)&pool->Lock, 0); done = true; }
+		if (!given)
+			panic("sentinel: free of %p, which no sentinelDeviceAlloc returned", ptr);
+		return;
 	}
 }
 
+__device__ bool sentinelDevicePooled(const void *ptr, size_t size)
+{
+	for (int i = 0; i < SENTINEL_DEVICEMAPS; i++)
+		if (_sentinelDeviceMap[i] && SENTINEL_POOLED(SENTINEL_POOL(_sentinelDeviceMap[i]), ptr, size)) return true;
+	return false;
+}
+
 #endif
 
 __END_DECLS;
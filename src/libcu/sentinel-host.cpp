@@ -1,14 +1,21 @@
-#include <windows.h>
+#include "sentinel-os.h"
 #include <stdio.h>
-#include <sentinel.h>
+#include <stdlib.h>
+#include <string.h>
 
 #if HAS_HOSTSENTINEL
 
 sentinelMap *_sentinelHostMap = nullptr;
 intptr_t _sentinelHostMapOffset = 0;
-void sentinelClientSend(sentinelMessage *msg, int msgLength)
+sentinelClientTable *_sentinelHostClients = nullptr;
+static thread_local sentinelTicket *_clientTickets = nullptr; // outstanding tickets sent from this thread
+
+static void sentinelClientCollectReady();
+
+/* Claim a slot, marshal msg into it and publish it to the server. A ticket forces a reply so the result can be collected later. */
+static void sentinelClientPublish(sentinelMessage *msg, int msgLength, sentinelTicket *ticket)
 {
-#ifndef _WIN64
+#if defined(_WIN32) && !defined(_WIN64)
 	printf("Sentinel currently only works in x64.\n");
 	abort();
 #else
@@ -17,27 +24,156 @@ void sentinelClientSend(sentinelMessage *msg, int msgLength)
 		printf("sentinel: device map not defined. did you start sentinel?\n");
 		exit(0);
 	}
-	long id = (InterlockedAdd((long *)&map->SetId, SENTINEL_MSGSIZE) - SENTINEL_MSGSIZE);
-	sentinelCommand *cmd = (sentinelCommand *)&map->Data[id%sizeof(map->Data)];
-	volatile long *status = (volatile long *)&cmd->Status;
-	//while (InterlockedCompareExchange((long *)status, 1, 0) != 0) { }
+	map = SENTINEL_LANEMAP(map, msg);
+	unsigned int id = (unsigned int)sentinelAtomicAddInt((volatile int *)&map->SetId, 1) - 1;
+	sentinelCommand *cmd = SENTINEL_SLOT(map, id);
+	volatile int *status = (volatile int *)&cmd->Status;
+	// back-pressure: a full ring holds us here until the slot's previous lap is released. that lap may be one of our own uncollected
+	// replies, so keep collecting them until none are left, then block
+	while (_clientTickets && cmd->Seq != (int)id) { sentinelClientCollectReady(); sentinelYield(); }
+	sentinelWait(SENTINEL_WAITCLIENT, &cmd->Seq, (int)id, (int)id, &map->Sleepers);
 	//cmd->Data = (char *)cmd + _ROUND8(sizeof(sentinelCommand));
 	cmd->Magic = SENTINEL_MAGIC;
 	cmd->Length = msgLength;
-	if (msg->Prepare && !msg->Prepare(msg, cmd->Data, cmd->Data + msgLength + msg->Size, _sentinelHostMapOffset)) {
+	cmd->Block = sentinelProcessId(); cmd->Thread = sentinelThreadId();
+	char *dataEnd = _MIN(cmd->Data + msgLength + msg->Size, (char *)cmd + SENTINEL_MSGSIZE);
+	char *end = msg->Prepare ? msg->Prepare(msg, cmd->Data, dataEnd, _sentinelHostMapOffset) : nullptr;
+	if (msg->Prepare && !end) {
 		printf("msg too long");
 		exit(0);
 	}
 	memcpy(cmd->Data, msg, msgLength);
+	// the server sees what was packed, not the reserve
+	if (end) ((sentinelMessage *)cmd->Data)->Size = (int)(end - (cmd->Data + msgLength));
 	//printf("Msg: %d[%d]'", msg->OP, msgLength); for (int i = 0; i < msgLength; i++) printf("%02x", ((char *)msg)[i] & 0xff); printf("'\n");
+	if (ticket) {
+		((sentinelMessage *)cmd->Data)->Wait = true;
+		ticket->Map = map; ticket->Cmd = cmd; ticket->Id = id;
+		ticket->Msg = msg; ticket->Length = msgLength;
+	}
 
+	sentinelMemoryBarrier();
 	*status = 2;
-	if (msg->Wait) {
-		while (InterlockedCompareExchange((long *)status, 5, 4) != 4) { }
-		memcpy(msg, cmd->Data, msgLength);
-		*status = 0;
-	}
+	sentinelRing(&_sentinelHostClients->Doorbell[map->Lane], &_sentinelHostClients->Sleepers[map->Lane]);
 #endif
 }
 
-#endif
\ No newline at end of file
+/* Copy the reply back over the sender's message and free the slot. The caller owns the slot, status 5. */
+static void sentinelClientCollect(sentinelTicket *ticket)
+{
+	sentinelCommand *cmd = ticket->Cmd;
+	bool wait = ticket->Msg->Wait;
+	memcpy(ticket->Msg, cmd->Data, ticket->Length);
+	ticket->Msg->Wait = wait;
+	if (ticket->Complete)
+		ticket->Complete(ticket->Msg, cmd->Data);
+	sentinelRelease(ticket->Map, cmd, ticket->Id);
+	ticket->Cmd = nullptr;
+	for (sentinelTicket **p = &_clientTickets; *p; p = &(*p)->Next)
+		if (*p == ticket) { *p = ticket->Next; break; }
+}
+
+/* Collect every reply already waiting on this thread's outstanding tickets, for a sender held back by a full ring. */
+static void sentinelClientCollectReady()
+{
+	for (sentinelTicket *t = _clientTickets, *next; t; t = next) {
+		next = t->Next;
+		if (sentinelCompareExchange(&t->Cmd->Status, 5, 4) == 4) { sentinelClientCollect(t); t->Collected = true; }
+	}
+}
+
+void sentinelClientSend(sentinelMessage *msg, int msgLength)
+{
+	if (!msg->Wait) { sentinelClientPublish(msg, msgLength, nullptr); return; }
+	sentinelTicket ticket; ticket.Complete = nullptr;
+	sentinelClientPublish(msg, msgLength, &ticket);
+	sentinelClientWait(&ticket);
+}
+
+void sentinelClientSendAsync(sentinelMessage *msg, int msgLength, sentinelTicket *ticket, void (*complete)(void*,char*))
+{
+	ticket->Complete = complete;
+	ticket->Collected = false;
+	sentinelClientPublish(msg, msgLength, ticket);
+	ticket->Next = _clientTickets; _clientTickets = ticket;
+}
+
+bool sentinelClientPoll(sentinelTicket *ticket)
+{
+	if (!ticket->Cmd) { ticket->Collected = false; return true; }
+	if (sentinelCompareExchange(&ticket->Cmd->Status, 5, 4) != 4) return false;
+	sentinelClientCollect(ticket);
+	return true;
+}
+
+void sentinelClientWait(sentinelTicket *ticket)
+{
+	if (!ticket->Cmd) { ticket->Collected = false; return; }
+	sentinelWait(SENTINEL_WAITCLIENT, &ticket->Cmd->Status, 5, 4, &ticket->Map->Sleepers);
+	sentinelClientCollect(ticket);
+}
+
+/* Collect whichever outstanding ticket replies first, blocking on the map's any-reply doorbell once spinning and yielding run out. Every lane
+** rings the doorbell of the map's first. Returns its index, or -1 if none is outstanding. */
+int sentinelClientWaitAny(sentinelTicket *tickets, int count)
+{
+	sentinelWaitPolicy *policy = &_sentinelWaitPolicy[SENTINEL_WAITCLIENT];
+	sentinelWaitStats *stats = &_sentinelWaitStats[SENTINEL_WAITCLIENT];
+	sentinelMap *map = nullptr;
+	bool asleep = false;
+	for (int polls = 0; ; polls++) {
+		int replies = map ? map->Replies : 0;
+		for (int i = 0; i < count; i++) {
+			if (!tickets[i].Cmd && !tickets[i].Collected) continue;
+			if (sentinelClientPoll(&tickets[i])) {
+				if (asleep) sentinelAtomicAddInt(&map->ReplySleepers, -1);
+				return i;
+			}
+			if (!map) { map = tickets[i].Map - tickets[i].Map->Lane; polls = 0; }
+		}
+		if (!map) return -1;
+		if (polls < policy->SpinCount) { sentinelAtomicAdd64(&stats->Spins, 1); sentinelPause(); }
+		else if (polls < policy->SpinCount + policy->YieldCount) { sentinelAtomicAdd64(&stats->Yields, 1); sentinelYield(); }
+		else if (!asleep) { asleep = true; sentinelAtomicAddInt(&map->ReplySleepers, 1); } // poll once more before the first block
+		else { sentinelAtomicAdd64(&stats->Blocks, 1); sentinelFutexWait(&map->Replies, replies, policy->BlockMs); }
+	}
+}
+
+// POOL
+#pragma region POOL
+
+void *sentinelClientAlloc(size_t size)
+{
+	int blocks = (int)((size + SENTINEL_POOLBLOCK - 1) / SENTINEL_POOLBLOCK);
+	if (!_sentinelHostMap || !blocks || blocks > SENTINEL_POOLBLOCKS) return nullptr;
+	sentinelPool *pool = SENTINEL_POOL(_sentinelHostMap);
+	while (sentinelCompareExchange(&pool->Lock, 1, 0)) sentinelYield();
+	char *p = sentinelPoolTake(pool, blocks);
+	sentinelMemoryBarrier();
+	pool->Lock = 0;
+	return p;
+}
+
+void sentinelClientFree(void *ptr)
+{
+	if (!ptr || !_sentinelHostMap) return;
+	sentinelPool *pool = SENTINEL_POOL(_sentinelHostMap);
+	if (!SENTINEL_POOLED(pool, ptr, 0)) return;
+	while (sentinelCompareExchange(&pool->Lock, 1, 0)) sentinelYield();
+	bool given = sentinelPoolGive(pool, ptr);
+	sentinelMemoryBarrier();
+	pool->Lock = 0;
+	if (!given) {
+		printf("sentinel: free of %p, which no sentinelClientAlloc returned\n", ptr);
+		abort();
+	}
+}
+
+bool sentinelClientPooled(const void *ptr, size_t size)
+{
+	return _sentinelHostMap && SENTINEL_POOLED(SENTINEL_POOL(_sentinelHostMap), ptr, size);
+}
+
+#pragma endregion
+
+#endif
@@ -15,7 +15,37 @@
 
 //#define panic(fmt, ...) { printf(fmt, __VA_ARGS__); exit(1); }
 
+#ifdef LIBCU_HOST
+// the executor makes the host's own calls, not the device ones direntcu.h and sys/statcu.h map them to in a host build
+#undef opendir
+#undef closedir
+#undef readdir
+#undef rewinddir
+#undef stat
+#undef fstat
+#undef chmod
+#undef mkdir
+#endif
+#if defined(LIBCU_HOST) && !defined(_MSC_VER)
+#include <fcntl.h>
+#define _access access
+#define _chdir chdir
+#define _chmod chmod
+#define _close close
+#define _dup dup
+#define _dup2 dup2
+#define _fileno fileno
+#define _getcwd getcwd
+#define _lseek lseek
+#define _open open
+#define _read read
+#define _rmdir rmdir
+#define _unlink unlink
+#define _write write
+#endif
+
 #define fcntl(fd, cmd, ...) 0
+#undef mkfifo
 #define mkfifo(path, mode) 0
 
 bool sentinelDefaultExecutor(void *tag, sentinelMessage *data, int length, char *(**hostPrepare)(void*,char*,char*,intptr_t))
@@ -76,4 +106,56 @@ bool sentinelDefaultExecutor(void *tag, sentinelMessage *data, int length, char
 	case TIME_STRFTIME: { time_strftime *msg = (time_strftime *)data; msg->RC = strftime((char *)msg->Str, msg->Maxsize, msg->Str2, msg->Tp); return true; }
 	}
 	return false;
+}
+
+// streams and descriptors keep their order, anything naming a path or the whole process keeps it against everything
+#define STREAMKEY(f) ((f) ? (intptr_t)(f) : SENTINEL_SERIAL)
+#define HANDLEKEY(fd) ((intptr_t)(fd) + 1)
+
+bool sentinelDefaultAffinity(void *tag, sentinelMessage *data, int length, intptr_t *key)
+{
+	switch (data->OP) {
+	case STDIO_FCLOSE: *key = STREAMKEY(((stdio_fclose *)data)->File); return true;
+	case STDIO_FFLUSH: *key = STREAMKEY(((stdio_fflush *)data)->File); return true;
+	case STDIO_FREOPEN: *key = (intptr_t)((stdio_freopen *)data)->Stream; return true;
+	case STDIO_SETVBUF: *key = STREAMKEY(((stdio_setvbuf *)data)->File); return true;
+	case STDIO_FGETC: *key = STREAMKEY(((stdio_fgetc *)data)->File); return true;
+	case STDIO_FGETS: *key = STREAMKEY(((stdio_fgets *)data)->File); return true;
+	case STDIO_FPUTC: *key = STREAMKEY(((stdio_fputc *)data)->File); return true;
+	case STDIO_FPUTS: *key = STREAMKEY(((stdio_fputs *)data)->File); return true;
+	case STDIO_UNGETC: *key = STREAMKEY(((stdio_ungetc *)data)->File); return true;
+	case STDIO_FREAD: *key = STREAMKEY(((stdio_fread *)data)->File); return true;
+	case STDIO_FWRITE: *key = STREAMKEY(((stdio_fwrite *)data)->File); return true;
+	case STDIO_FSEEK: *key = STREAMKEY(((stdio_fseek *)data)->File); return true;
+	case STDIO_FTELL: *key = STREAMKEY(((stdio_ftell *)data)->File); return true;
+	case STDIO_REWIND: *key = STREAMKEY(((stdio_rewind *)data)->File); return true;
+	case STDIO_FGETPOS: *key = STREAMKEY(((stdio_fgetpos *)data)->File); return true;
+	case STDIO_FSETPOS: *key = STREAMKEY(((stdio_fsetpos *)data)->File); return true;
+	case STDIO_CLEARERR: *key = STREAMKEY(((stdio_clearerr *)data)->File); return true;
+	case STDIO_FEOF: *key = STREAMKEY(((stdio_feof *)data)->File); return true;
+	case STDIO_FERROR: *key = STREAMKEY(((stdio_ferror *)data)->File); return true;
+	case STDIO_FILENO: *key = STREAMKEY(((stdio_fileno *)data)->File); return true;
+	case UNISTD_LSEEK: *key = HANDLEKEY(((unistd_lseek *)data)->Handle); return true;
+	case UNISTD_CLOSE: *key = HANDLEKEY(((unistd_close *)data)->Handle); return true;
+	case UNISTD_READ: *key = HANDLEKEY(((unistd_read *)data)->Handle); return true;
+	case UNISTD_WRITE: *key = HANDLEKEY(((unistd_write *)data)->Handle); return true;
+	case UNISTD_DUP: *key = ((unistd_dup *)data)->Dup1 ? HANDLEKEY(((unistd_dup *)data)->Handle) : SENTINEL_SERIAL; return true;
+	case FCNTL_FCNTL: *key = HANDLEKEY(((fcntl_fcntl *)data)->Handle); return true;
+	case FCNTL_FSTAT: *key = HANDLEKEY(((fcntl_fstat *)data)->Handle); return true;
+	case FCNTL_FSTAT64: *key = HANDLEKEY(((fcntl_fstat64 *)data)->Handle); return true;
+	case FCNTL_OPEN: *key = 0; return true;
+	case DIRENT_OPENDIR: *key = 0; return true;
+	case DIRENT_CLOSEDIR: *key = (intptr_t)((dirent_closedir *)data)->Ptr; return true;
+	case DIRENT_READDIR: *key = (intptr_t)((dirent_readdir *)data)->Ptr; return true;
+#ifdef __USE_LARGEFILE64
+	case DIRENT_READDIR64: *key = (intptr_t)((dirent_readdir64 *)data)->Ptr; return true;
+#endif
+	case DIRENT_REWINDDIR: *key = (intptr_t)((dirent_rewinddir *)data)->Ptr; return true;
+	case TIME_MKTIME: *key = 0; return true;
+	case TIME_STRFTIME: *key = 0; return true;
+	case STDIO_REMOVE: case STDIO_RENAME: case STDLIB_SYSTEM: case STDLIB_EXIT:
+	case UNISTD_ACCESS: case UNISTD_CHOWN: case UNISTD_CHDIR: case UNISTD_GETCWD: case UNISTD_UNLINK: case UNISTD_RMDIR:
+	case FCNTL_STAT: case FCNTL_STAT64: case FCNTL_CHMOD: case FCNTL_MKDIR: case FCNTL_MKFIFO: *key = SENTINEL_SERIAL; return true;
+	}
+	return false;
 }
\ No newline at end of file
@@ -0,0 +1,368 @@
+#ifndef _SENTINEL_OS_H
+#define _SENTINEL_OS_H
+#include <sentinel.h>
+
+#if defined(_WIN32)
+#define __OS_WIN 1
+#include <windows.h>
+#include <process.h>
+#else
+#define __OS_UNIX 1
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <signal.h>
+#if defined(__linux__)
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#elif defined(__APPLE__) && defined(__has_include)
+#if __has_include(<os/os_sync_wait_on_address.h>)
+#include <os/os_sync_wait_on_address.h>
+#define SENTINEL_OSSYNC 1
+#endif
+#endif
+#endif
+
+#ifndef MAX_PATH
+#define MAX_PATH 260
+#endif
+
+// ATOMICS
+#pragma region ATOMICS
+
+/* Atomically replace *p with exchange if it equals comparand. Returns the prior value of *p. */
+static __forceinline int sentinelCompareExchange(volatile int *p, int exchange, int comparand)
+{
+#if __OS_WIN
+	return InterlockedCompareExchange((volatile long *)p, exchange, comparand);
+#else
+	return __sync_val_compare_and_swap(p, comparand, exchange);
+#endif
+}
+
+/* Atomically add value to *p. Returns the new value of *p. */
+static __forceinline long sentinelAtomicAdd(volatile long *p, long value)
+{
+#if __OS_WIN
+	return InterlockedAdd((volatile long *)p, value);
+#else
+	return __sync_add_and_fetch(p, value);
+#endif
+}
+
+static __forceinline int sentinelAtomicAddInt(volatile int *p, int value)
+{
+#if __OS_WIN
+	return InterlockedAdd((volatile long *)p, value);
+#else
+	return __sync_add_and_fetch(p, value);
+#endif
+}
+
+static __forceinline long long sentinelAtomicAdd64(volatile long long *p, long long value)
+{
+#if __OS_WIN
+	return InterlockedAdd64(p, value);
+#else
+	return __sync_add_and_fetch(p, value);
+#endif
+}
+
+/* Full fence, orders a status store before the sleeper check that follows it. */
+static __forceinline void sentinelMemoryBarrier()
+{
+#if __OS_WIN
+	MemoryBarrier();
+#else
+	__sync_synchronize();
+#endif
+}
+
+/* Hint to the core that we are busy-spinning. */
+static __forceinline void sentinelPause()
+{
+#if __OS_WIN
+	YieldProcessor();
+#elif defined(__i386__) || defined(__x86_64__)
+	__builtin_ia32_pause();
+#endif
+}
+
+static __forceinline void sentinelYield()
+{
+#if __OS_WIN
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+}
+
+/* Monotonic clock in nanoseconds. */
+static __forceinline long long sentinelClock()
+{
+#if __OS_WIN
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER now;
+	if (!frequency.QuadPart) QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return (long long)((double)now.QuadPart * 1e9 / frequency.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+#pragma endregion
+
+// DOORBELLS
+#pragma region DOORBELLS
+
+#if __OS_WIN
+#pragma comment(lib, "Synchronization.lib")
+#define SENTINEL_WAKEBUCKETS 64
+#define SENTINEL_WAKEREGIONS (SENTINEL_CLIENTS + 2)
+
+/* WaitOnAddress only wakes threads of the calling process, so a word of a named region other processes map is woken through one of
+** a bucket of named events instead, picked by the word's offset into the region. */
+typedef struct sentinelWakeRegion {
+	char *volatile Base;
+	size_t Size;
+	HANDLE Event[SENTINEL_WAKEBUCKETS];
+} sentinelWakeRegion;
+extern sentinelWakeRegion _sentinelWakeRegions[SENTINEL_WAKEREGIONS];
+
+/* The event p is woken through, NULL for a word of this process alone. */
+static __forceinline HANDLE sentinelWakeEvent(volatile int *p)
+{
+	for (int i = 0; i < SENTINEL_WAKEREGIONS; i++) {
+		sentinelWakeRegion *r = &_sentinelWakeRegions[i];
+		char *base = r->Base;
+		if (base && (char *)p >= base && (char *)p < base + r->Size) return r->Event[((char *)p - base) / sizeof(int) % SENTINEL_WAKEBUCKETS];
+	}
+	return NULL;
+}
+#endif
+
+/* Block the calling thread while *p still equals value, or until ms elapses (ms < 0 waits until woken). Spurious returns are allowed, callers re-check.
+** Linux blocks on a futex, macOS on os_sync_wait_on_address where the system has it (14.4), Windows on WaitOnAddress or a region's
+** wake event. On Windows two waiters on one event bucket can cost each other a wake, which then waits out ms, so give those a bound. */
+static __forceinline void sentinelFutexWait(volatile int *p, int value, int ms)
+{
+#if __OS_WIN
+	HANDLE event = sentinelWakeEvent(p);
+	if (!event) { WaitOnAddress(p, &value, sizeof(int), ms < 0 ? INFINITE : (DWORD)ms); return; }
+	// reset before the check, a wake landing after it leaves the event set
+	ResetEvent(event);
+	if (*p == value) WaitForSingleObject(event, ms < 0 ? INFINITE : (DWORD)ms);
+#elif defined(__linux__)
+	struct timespec ts, *tsp = nullptr;
+	if (ms >= 0) { ts.tv_sec = ms / 1000; ts.tv_nsec = (ms % 1000) * 1000000L; tsp = &ts; }
+	syscall(SYS_futex, (int *)p, FUTEX_WAIT, value, tsp, nullptr, 0);
+#else
+#if SENTINEL_OSSYNC
+	if (__builtin_available(macOS 14.4, *)) {
+		if (ms < 0) os_sync_wait_on_address((void *)p, (uint32_t)value, sizeof(int), OS_SYNC_WAIT_ON_ADDRESS_SHARED);
+		else os_sync_wait_on_address_with_timeout((void *)p, (uint32_t)value, sizeof(int), OS_SYNC_WAIT_ON_ADDRESS_SHARED, OS_CLOCK_MACH_ABSOLUTE_TIME, ms * 1000000ULL);
+		return;
+	}
+#endif
+	if (*p == value) usleep(ms < 0 ? 0 : ms * 1000);
+#endif
+}
+
+/* Wake every thread, in any process, blocked in sentinelFutexWait on p. */
+static __forceinline void sentinelFutexWake(volatile int *p)
+{
+#if __OS_WIN
+	HANDLE event = sentinelWakeEvent(p);
+	if (event) SetEvent(event);
+	else WakeByAddressAll((PVOID)p);
+#elif defined(__linux__)
+	syscall(SYS_futex, (int *)p, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#elif SENTINEL_OSSYNC
+	if (__builtin_available(macOS 14.4, *)) os_sync_wake_by_address_all((void *)p, sizeof(int), OS_SYNC_WAKE_BY_ADDRESS_SHARED);
+#endif
+}
+
+#pragma endregion
+
+// WAIT POLICY
+#pragma region WAIT POLICY
+
+extern sentinelWaitPolicy _sentinelWaitPolicy[SENTINEL_WAITCOUNT];
+extern sentinelWaitStats _sentinelWaitStats[SENTINEL_WAITCOUNT];
+
+/* Wait for *status to move from comparand to exchange by spinning, then yielding, then blocking on the status word as a doorbell.
+** Blocked waiters are counted in *sleepers so sentinelWake only pays for the syscall when someone is asleep. Returns false if
+** *running drops before the exchange happens. */
+static __forceinline bool sentinelWait(int waiter, volatile int *status, int exchange, int comparand, volatile int *sleepers, volatile bool *running = nullptr)
+{
+	sentinelWaitPolicy *policy = &_sentinelWaitPolicy[waiter];
+	sentinelWaitStats *stats = &_sentinelWaitStats[waiter];
+	int i, s_;
+	// spin, the first poll always happens so an uncontended wait counts as a spin hit
+	for (i = 0; ; i++) {
+		if (sentinelCompareExchange(status, exchange, comparand) == comparand) { sentinelAtomicAdd64(&stats->Spins, i); sentinelAtomicAdd64(&stats->SpinHits, 1); return true; }
+		if (i >= policy->SpinCount) break;
+		sentinelPause();
+	}
+	sentinelAtomicAdd64(&stats->Spins, i);
+	// yield
+	for (i = 0; i < policy->YieldCount; i++) {
+		if (sentinelCompareExchange(status, exchange, comparand) == comparand) { sentinelAtomicAdd64(&stats->Yields, i); sentinelAtomicAdd64(&stats->YieldHits, 1); return true; }
+		sentinelYield();
+	}
+	sentinelAtomicAdd64(&stats->Yields, i);
+	// block
+	while (!running || *running) {
+		sentinelAtomicAddInt(sleepers, 1);
+		if ((s_ = sentinelCompareExchange(status, exchange, comparand)) == comparand) { sentinelAtomicAddInt(sleepers, -1); sentinelAtomicAdd64(&stats->BlockHits, 1); return true; }
+		sentinelFutexWait(status, s_, policy->BlockMs);
+		sentinelAtomicAddInt(sleepers, -1);
+		sentinelAtomicAdd64(&stats->Blocks, 1);
+	}
+	return false;
+}
+
+/* Publish a status store to a waiter blocked in sentinelWait. */
+static __forceinline void sentinelWake(int waiter, volatile int *status, volatile int *sleepers)
+{
+	sentinelMemoryBarrier();
+	if (*sleepers) {
+		sentinelFutexWake(status);
+		sentinelAtomicAdd64(&_sentinelWaitStats[waiter].Wakes, 1);
+	}
+}
+
+/* Ring a doorbell shared by several status words, paying for the syscall only when someone is asleep on it. */
+static __forceinline void sentinelRing(volatile int *doorbell, volatile int *sleepers)
+{
+	sentinelMemoryBarrier();
+	if (*sleepers) {
+		sentinelAtomicAddInt(doorbell, 1);
+		sentinelFutexWake(doorbell);
+		sentinelAtomicAdd64(&_sentinelWaitStats[SENTINEL_WAITHOST].Wakes, 1);
+	}
+}
+
+/* Hand a reply to a host client, ringing the slot's doorbell and, for sentinelClientWaitAny, the one of the map's first lane. */
+static __forceinline void sentinelReply(sentinelMap *map, sentinelCommand *cmd)
+{
+	cmd->Status = 4;
+	sentinelWake(SENTINEL_WAITCLIENT, &cmd->Status, &map->Sleepers);
+	map -= map->Lane;
+	if (map->ReplySleepers) {
+		sentinelAtomicAddInt(&map->Replies, 1);
+		sentinelFutexWake(&map->Replies);
+	}
+}
+
+/* Hand a slot back to the ring once its command is finished with, waking any sender held back by a full ring. */
+static __forceinline void sentinelRelease(sentinelMap *map, sentinelCommand *cmd, unsigned int id)
+{
+	cmd->Status = 0;
+	sentinelMemoryBarrier();
+	cmd->Seq = (int)(id + SENTINEL_MSGCOUNT);
+	sentinelWake(SENTINEL_WAITCLIENT, &cmd->Seq, &map->Sleepers);
+}
+
+#pragma endregion
+
+// THREADS
+#pragma region THREADS
+
+#if __OS_WIN
+typedef HANDLE sentinelThread;
+#define SENTINEL_THREADPROC(name, data) unsigned int __stdcall name(void *data)
+#define SENTINEL_THREADEXIT 0
+#else
+typedef pthread_t sentinelThread;
+#define SENTINEL_THREADPROC(name, data) void *name(void *data)
+#define SENTINEL_THREADEXIT nullptr
+#endif
+
+/* Start proc on a new thread. Returns false if the thread could not be created. */
+#if __OS_WIN
+static __forceinline bool sentinelThreadStart(sentinelThread *thread, unsigned int (__stdcall *proc)(void *), void *data)
+{
+	return (*thread = (HANDLE)_beginthreadex(0, 0, proc, data, 0, 0)) != NULL;
+}
+#else
+static __forceinline bool sentinelThreadStart(sentinelThread *thread, void *(*proc)(void *), void *data)
+{
+	return !pthread_create(thread, nullptr, proc, data);
+}
+#endif
+
+/* Wait for a thread started by sentinelThreadStart to exit and release it. */
+static __forceinline void sentinelThreadJoin(sentinelThread thread)
+{
+#if __OS_WIN
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else
+	pthread_join(thread, nullptr);
+#endif
+}
+
+/* Ids of the calling process and thread as the OS reports them, stamped on each command so a trace can name its sender. */
+static __forceinline int sentinelProcessId()
+{
+#if __OS_WIN
+	return (int)GetCurrentProcessId();
+#else
+	return (int)getpid();
+#endif
+}
+
+static __forceinline int sentinelThreadId()
+{
+#if __OS_WIN
+	return (int)GetCurrentThreadId();
+#elif defined(__linux__)
+	static thread_local int id = 0;
+	return id ? id : (id = (int)syscall(SYS_gettid));
+#else
+	return (int)(intptr_t)pthread_self();
+#endif
+}
+
+/* Whether process pid still runs, so what it left in shared memory can be taken back. */
+static __forceinline bool sentinelProcessAlive(int pid)
+{
+#if __OS_WIN
+	HANDLE handle = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+	if (!handle) return false;
+	bool alive = WaitForSingleObject(handle, 0) == WAIT_TIMEOUT;
+	CloseHandle(handle);
+	return alive;
+#else
+	return pid > 0 && (!kill(pid, 0) || errno != ESRCH);
+#endif
+}
+
+#if __OS_WIN
+typedef CRITICAL_SECTION sentinelMutex;
+static __forceinline void sentinelMutexInitialize(sentinelMutex *mutex) { InitializeCriticalSection(mutex); }
+static __forceinline void sentinelMutexDestroy(sentinelMutex *mutex) { DeleteCriticalSection(mutex); }
+static __forceinline void sentinelMutexEnter(sentinelMutex *mutex) { EnterCriticalSection(mutex); }
+static __forceinline void sentinelMutexLeave(sentinelMutex *mutex) { LeaveCriticalSection(mutex); }
+#else
+typedef pthread_mutex_t sentinelMutex;
+static __forceinline void sentinelMutexInitialize(sentinelMutex *mutex) { pthread_mutex_init(mutex, nullptr); }
+static __forceinline void sentinelMutexDestroy(sentinelMutex *mutex) { pthread_mutex_destroy(mutex); }
+static __forceinline void sentinelMutexEnter(sentinelMutex *mutex) { pthread_mutex_lock(mutex); }
+static __forceinline void sentinelMutexLeave(sentinelMutex *mutex) { pthread_mutex_unlock(mutex); }
+#endif
+
+#pragma endregion
+
+#endif  /* _SENTINEL_OS_H */
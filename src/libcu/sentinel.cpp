@@ -1,7 +1,7 @@
-#include <windows.h>
-#include <process.h>
+#include "sentinel-os.h"
 #include <stdio.h>
-#include <sentinel.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <cuda_runtimecu.h>
 
@@ -20,144 +20,983 @@ void sentinelMap::Dump()
 }
 
 static sentinelContext _ctx;
-static sentinelExecutor _baseExecutor = { nullptr, "base", sentinelDefaultExecutor, nullptr };
+static sentinelExecutor _baseExecutor = { nullptr, "base", sentinelDefaultExecutor, nullptr, sentinelDefaultAffinity };
+
+// WAIT POLICY
+#pragma region WAIT POLICY
+
+sentinelWaitPolicy _sentinelWaitPolicy[SENTINEL_WAITCOUNT] = {
+	{ 2000, 100, 50 },	// SENTINEL_WAITHOST: woken by clients
+	{ 2000, 100, 1 },	// SENTINEL_WAITDEVICE: nobody can wake us, keep blocks short
+	{ 4000, 100, 50 },	// SENTINEL_WAITCLIENT: woken by the server
+};
+sentinelWaitStats _sentinelWaitStats[SENTINEL_WAITCOUNT];
+static bool _sentinelWaitPolicySet = false;
+#if __OS_WIN
+sentinelWakeRegion _sentinelWakeRegions[SENTINEL_WAKEREGIONS];
+#endif
+
+/* Spinning only burns the time slice the other side needs on a single processor, so drop to yield-then-block there unless told otherwise. */
+static void sentinelWaitPolicyDefaults()
+{
+	if (_sentinelWaitPolicySet) return;
+	_sentinelWaitPolicySet = true;
+#if __OS_WIN
+	SYSTEM_INFO info; GetSystemInfo(&info);
+	bool uniprocessor = info.dwNumberOfProcessors <= 1;
+#else
+	bool uniprocessor = sysconf(_SC_NPROCESSORS_ONLN) <= 1;
+#endif
+	if (uniprocessor)
+		for (int i = 0; i < SENTINEL_WAITCOUNT; i++)
+			_sentinelWaitPolicy[i].SpinCount = 0;
+}
+
+void sentinelSetWaitPolicy(int waiter, const sentinelWaitPolicy *policy)
+{
+	assert(waiter >= 0 && waiter < SENTINEL_WAITCOUNT);
+	_sentinelWaitPolicySet = true;
+	_sentinelWaitPolicy[waiter] = *policy;
+}
+
+void sentinelGetWaitPolicy(int waiter, sentinelWaitPolicy *policy)
+{
+	assert(waiter >= 0 && waiter < SENTINEL_WAITCOUNT);
+	*policy = _sentinelWaitPolicy[waiter];
+}
+
+void sentinelGetWaitStats(int waiter, sentinelWaitStats *stats, bool reset)
+{
+	assert(waiter >= 0 && waiter < SENTINEL_WAITCOUNT);
+	*stats = _sentinelWaitStats[waiter];
+	if (reset)
+		memset(&_sentinelWaitStats[waiter], 0, sizeof(sentinelWaitStats));
+}
+
+#pragma endregion
+
+static volatile unsigned char _opLanes[SENTINEL_OPCOUNT]; // copied to the first lane of every map, see sentinelSetOpLane
+
+/* Reset a map to empty rings, one per lane: every slot is free for the ticket of its first lap. A pooled map, SENTINEL_MAPSIZE long, has
+** its pool emptied too. */
+static void sentinelMapInitialize(sentinelMap *map, intptr_t offset, bool pooled)
+{
+	for (int lane = 0; lane < SENTINEL_LANES; lane++) {
+		sentinelMap *m = map + lane;
+		memset(m, 0, sizeof(sentinelMap));
+		m->Offset = offset;
+		m->SlotSize = SENTINEL_MSGSIZE;
+		m->SlotCount = SENTINEL_MSGCOUNT;
+		m->Lane = lane;
+		for (int i = 0; i < SENTINEL_MSGCOUNT; i++)
+			SENTINEL_SLOT(m, i)->Seq = i;
+	}
+	memcpy((void *)map->Lanes, (void *)_opLanes, sizeof(map->Lanes));
+	// the pool's data needs no clearing, its blocks are tracked in Blocks
+	if (pooled) memset(SENTINEL_POOL(map), 0, offsetof(sentinelPool, Data));
+}
+
+// DISPATCH
+#pragma region DISPATCH
+
+// executors are found through the opcode tables first and the lists second. Server threads look them up inside a read-side section, and
+// unregistering waits out every section that could still hold the executor, so the caller may free it on return.
+static volatile int _dispatchLock = 0; // serializes registration
+static volatile int _dispatchEpoch = 0;
+static volatile int _dispatchReaders[2]; // sections open under each parity of _dispatchEpoch
+
+/* Open a read-side section over the executor tables. Returns the parity to hand to sentinelDispatchLeave. */
+static __forceinline int sentinelDispatchEnter()
+{
+	while (true) {
+		int parity = _dispatchEpoch & 1;
+		sentinelAtomicAddInt(&_dispatchReaders[parity], 1);
+		// a writer that flipped the epoch before seeing us may already have let its executor go, so start over under the new parity
+		if ((_dispatchEpoch & 1) == parity) return parity;
+		sentinelAtomicAddInt(&_dispatchReaders[parity], -1);
+	}
+}
+
+static __forceinline void sentinelDispatchLeave(int parity)
+{
+	sentinelAtomicAddInt(&_dispatchReaders[parity], -1);
+}
+
+/* Wait until every section that opened before this call has closed. The caller holds _dispatchLock and must not be inside a section. */
+static void sentinelDispatchSynchronize()
+{
+	int parity = _dispatchEpoch & 1;
+	sentinelAtomicAddInt(&_dispatchEpoch, 1);
+	while (_dispatchReaders[parity]) sentinelYield();
+}
+
+#pragma endregion
+
+// STATS
+#pragma region STATS
+
+static sentinelOpStats _sentinelOpStats[SENTINEL_OPCOUNT];
+static sentinelRingStats _sentinelRingStats[SENTINEL_LANES][SENTINEL_DEVICEMAPS+1]; // the device maps, then the host map, by lane
+static sentinelThread _statsThread;
+static volatile int _statsDumpMs = 0; // doubles as the dump thread's doorbell
+static volatile bool _statsRunning = false;
+
+static __forceinline int sentinelHistogramBucket(long long ns)
+{
+	int i = 0;
+	for (ns >>= 8; ns > 0 && i < SENTINEL_HISTOGRAM-1; ns >>= 1) i++;
+	return i;
+}
+
+/* Upper bound in microseconds of the bucket holding the pct-th percentile, 0 if empty. */
+static double sentinelHistogramPercentile(const long long *histogram, long long count, double pct)
+{
+	long long rank = (long long)(count * pct), seen = 0;
+	for (int i = 0; i < SENTINEL_HISTOGRAM; i++)
+		if ((seen += histogram[i]) > rank) return (256LL << i) / 1000.0;
+	return 0;
+}
+
+/* Count a command against its opcode once it has run. Several workers land here at once. */
+static void sentinelStatsCommand(int op, int bytes, long long queued, long long started, long long finished)
+{
+	sentinelOpStats *s = &_sentinelOpStats[op];
+	sentinelAtomicAdd64(&s->Commands, 1);
+	sentinelAtomicAdd64(&s->Bytes, bytes);
+	sentinelAtomicAdd64(&s->QueueNs, started - queued);
+	sentinelAtomicAdd64(&s->ExecNs, finished - started);
+	sentinelAtomicAdd64(&s->QueueHistogram[sentinelHistogramBucket(started - queued)], 1);
+	sentinelAtomicAdd64(&s->ExecHistogram[sentinelHistogramBucket(finished - started)], 1);
+}
+
+/* Sample how full a ring is as its map thread claims ticket id. Only that thread writes the ring's stats. */
+static __forceinline void sentinelStatsClaim(int ring, sentinelMap *map, unsigned int id)
+{
+	sentinelRingStats *s = &_sentinelRingStats[map->Lane][ring];
+	int occupancy = (int)(map->SetId - id);
+	occupancy = occupancy < 1 ? 1 : occupancy > SENTINEL_MSGCOUNT ? SENTINEL_MSGCOUNT : occupancy;
+	s->Claims++;
+	s->Occupancy[occupancy]++;
+	if (occupancy > s->MaxOccupancy) s->MaxOccupancy = occupancy;
+}
+
+bool sentinelGetOpStats(int op, sentinelOpStats *stats, bool reset)
+{
+	if (op < 0 || op >= SENTINEL_OPCOUNT) return false;
+	*stats = _sentinelOpStats[op];
+	if (reset) memset(&_sentinelOpStats[op], 0, sizeof(sentinelOpStats));
+	return true;
+}
+
+/* map indexes the device maps, -1 is the host map. */
+bool sentinelGetRingStats(int map, sentinelRingStats *stats, bool reset, int lane)
+{
+	if (map < -1 || map >= SENTINEL_DEVICEMAPS || lane < 0 || lane >= SENTINEL_LANES) return false;
+	sentinelRingStats *s = &_sentinelRingStats[lane][map < 0 ? SENTINEL_DEVICEMAPS : map];
+	*stats = *s;
+	if (reset) memset(s, 0, sizeof(sentinelRingStats));
+	return true;
+}
+
+void sentinelDumpStats()
+{
+	for (int lane = 0; lane < SENTINEL_LANES; lane++)
+		for (int i = 0; i <= SENTINEL_DEVICEMAPS; i++) {
+			sentinelRingStats *s = &_sentinelRingStats[lane][i];
+			if (!s->Claims) continue;
+			long long taken = 0;
+			for (int j = 1; j <= SENTINEL_MSGCOUNT; j++) taken += s->Occupancy[j] * j;
+			if (i < SENTINEL_DEVICEMAPS) printf("sentinel ring %d lane %d: claims=%lld occupancy avg=%.2f max=%d\n", i, lane, s->Claims, (double)taken / s->Claims, s->MaxOccupancy);
+			else printf("sentinel ring host lane %d: claims=%lld occupancy avg=%.2f max=%d\n", lane, s->Claims, (double)taken / s->Claims, s->MaxOccupancy);
+		}
+	for (int i = 0; i < SENTINEL_OPCOUNT; i++) {
+		sentinelOpStats *s = &_sentinelOpStats[i];
+		long long n = s->Commands;
+		if (!n) continue;
+		printf("sentinel op %3d: n=%lld bytes=%lld queue avg=%.2fus p50<%.2fus p99<%.2fus exec avg=%.2fus p50<%.2fus p99<%.2fus\n", i, n, s->Bytes,
+			s->QueueNs / 1000.0 / n, sentinelHistogramPercentile(s->QueueHistogram, n, .5), sentinelHistogramPercentile(s->QueueHistogram, n, .99),
+			s->ExecNs / 1000.0 / n, sentinelHistogramPercentile(s->ExecHistogram, n, .5), sentinelHistogramPercentile(s->ExecHistogram, n, .99));
+	}
+	fflush(stdout);
+}
+
+static SENTINEL_THREADPROC(sentinelStatsThread, data)
+{
+	long long next = sentinelClock() + _statsDumpMs * 1000000LL;
+	while (_statsRunning) {
+		int ms = _statsDumpMs;
+		long long now = sentinelClock();
+		if (now >= next) { sentinelDumpStats(); next = now + ms * 1000000LL; continue; }
+		sentinelFutexWait(&_statsDumpMs, ms, (int)((next - now) / 1000000LL) + 1);
+	}
+	return SENTINEL_THREADEXIT;
+}
+
+/* Dump the stats every ms milliseconds from a thread of their own, 0 stops. */
+void sentinelSetStatsDump(int ms)
+{
+	if (ms <= 0) {
+		if (!_statsRunning) return;
+		_statsRunning = false;
+		sentinelFutexWake(&_statsDumpMs);
+		sentinelThreadJoin(_statsThread);
+		return;
+	}
+	_statsDumpMs = ms;
+	sentinelFutexWake(&_statsDumpMs);
+	if (_statsRunning) return;
+	_statsRunning = true;
+	if (!sentinelThreadStart(&_statsThread, sentinelStatsThread, nullptr))
+		_statsRunning = false;
+}
+
+#pragma endregion
+
+// TRACE
+#pragma region TRACE
+
+// a trace is a sentinelTraceHeader followed by one sentinelTraceRecord per command, in the order the commands finished
+static FILE *volatile _traceFile = nullptr;
+static sentinelMutex _traceLock;
+static bool _traceLockInitialized = false;
+static long long _traceEpoch;
+
+/* FNV-1a over a request past its sentinelMessage header, taken before the executors overwrite it with the reply. */
+static unsigned int sentinelTraceDigest(const char *data, int bytes)
+{
+	unsigned int h = 2166136261U;
+	for (int i = (int)sizeof(sentinelMessage); i < bytes; i++) h = (h ^ (unsigned char)data[i]) * 16777619U;
+	return h;
+}
+
+/* Fill in what the command says about itself, before it runs. */
+static void sentinelTraceBegin(sentinelTraceRecord *r, sentinelMap *map, sentinelCommand *cmd, bool forDevice, int bytes)
+{
+	sentinelMessage *msg = (sentinelMessage *)cmd->Data;
+	r->OP = (unsigned char)msg->OP;
+	r->Map = -1;
+	for (int i = 0; forDevice && i < SENTINEL_DEVICEMAPS; i++)
+		if (_ctx.DeviceMap[i] == map - map->Lane) r->Map = (signed char)i;
+	r->Wait = msg->Wait;
+	r->Lane = (unsigned char)map->Lane;
+	r->Length = cmd->Length;
+	r->Size = msg->Size;
+	r->Digest = sentinelTraceDigest(cmd->Data, bytes);
+	r->Block = cmd->Block; r->Thread = cmd->Thread;
+}
+
+/* Stamp the times and append the record. Several workers land here at once. */
+static void sentinelTraceCommand(sentinelTraceRecord *r, long long claimed, long long started, long long finished)
+{
+	sentinelMutexEnter(&_traceLock);
+	if (_traceFile) {
+		r->Claimed = claimed - _traceEpoch; r->Started = started - _traceEpoch; r->Finished = finished - _traceEpoch;
+		fwrite(r, sizeof(*r), 1, _traceFile);
+	}
+	sentinelMutexLeave(&_traceLock);
+}
+
+/* Record every command the server runs to path, replacing any trace already running. sentinelServerInitialize starts one on its own when
+** SENTINEL_TRACE names a file. */
+bool sentinelTraceStart(const char *path)
+{
+	if (!_traceLockInitialized) { sentinelMutexInitialize(&_traceLock); _traceLockInitialized = true; }
+	FILE *f = fopen(path, "wb");
+	if (!f) return false;
+	setvbuf(f, nullptr, _IOFBF, 0x10000);
+	sentinelTraceHeader header = { SENTINEL_TRACEMAGIC, SENTINEL_TRACEVERSION, (int)sizeof(sentinelTraceRecord), SENTINEL_MSGSIZE };
+	if (fwrite(&header, sizeof(header), 1, f) != 1) { fclose(f); return false; }
+	sentinelMutexEnter(&_traceLock);
+	FILE *old = _traceFile;
+	_traceEpoch = sentinelClock();
+	_traceFile = f;
+	sentinelMutexLeave(&_traceLock);
+	if (old) fclose(old);
+	return true;
+}
+
+void sentinelTraceStop()
+{
+	if (!_traceLockInitialized) return;
+	sentinelMutexEnter(&_traceLock);
+	FILE *f = _traceFile;
+	_traceFile = nullptr;
+	sentinelMutexLeave(&_traceLock);
+	if (f) fclose(f);
+}
+
+#pragma endregion
+
+// WORKERS
+#pragma region WORKERS
+
+#define SENTINEL_WORKQUEUE (SENTINEL_MSGCOUNT*(SENTINEL_DEVICEMAPS+1+SENTINEL_CLIENTS)+1) // one entry per slot that can be in flight, plus the empty gap
+
+typedef struct sentinelWork {
+	sentinelMap *Map;
+	sentinelCommand *Cmd;
+	unsigned int Id;
+	bool ForDevice;
+	long long Claimed; // sentinelClock when the map thread took the command
+} sentinelWork;
+
+typedef struct sentinelWorker {
+	sentinelMutex Lock; // serializes the map threads queueing on this worker
+	volatile int Tail; // next entry to fill, doubles as the worker's doorbell
+	volatile int Head; // next entry to run, only moved by the worker
+	volatile int Sleeping;
+	volatile int Depth;
+	sentinelWorkerStats Stats;
+	sentinelThread Thread;
+	sentinelWork Queue[SENTINEL_WORKQUEUE];
+} sentinelWorker;
+
+static sentinelWorker *_workers = nullptr;
+static int _workerCount = 0;
+static int _laneWorkers[SENTINEL_LANES+1]; // first worker of each lane, a lane only ever runs on its own
+static volatile bool _workersRunning = false;
+
+/* The table entry of a message's opcode. An opcode outside the table, which a plain char may sign into, has none and goes to the executor
+** list instead of landing on another opcode's entry. */
+static __forceinline sentinelExecutor *sentinelOpExecutor(sentinelMessage *msg, bool forDevice)
+{
+	int op = msg->OP;
+	return op >= 0 && op < SENTINEL_OPCOUNT ? (forDevice ? _ctx.DeviceOps : _ctx.HostOps)[op] : nullptr;
+}
+
+/* Run a claimed command through the executors and hand its slot back, as a reply or as free. */
+static void sentinelExecute(sentinelMap *map, sentinelCommand *cmd, unsigned int id, bool forDevice, long long claimed)
+{
+	sentinelMessage *msg = (sentinelMessage *)cmd->Data;
+	char *(*hostPrepare)(void*,char*,char*,intptr_t) = nullptr;
+	int op = (unsigned char)msg->OP, bytes = _MIN(cmd->Length + msg->Size, SENTINEL_MSGSIZE - (int)offsetof(sentinelCommand, Data));
+	sentinelTraceRecord trace;
+	bool tracing = _traceFile != nullptr;
+	if (tracing) sentinelTraceBegin(&trace, map, cmd, forDevice, bytes);
+	long long started = sentinelClock();
+	int parity = sentinelDispatchEnter();
+	sentinelExecutor *exec = sentinelOpExecutor(msg, forDevice);
+	if (!exec || !exec->Executor(exec->Tag, msg, cmd->Length, &hostPrepare))
+		for (exec = forDevice ? _ctx.DeviceList : _ctx.HostList; exec && exec->Executor && !exec->Executor(exec->Tag, msg, cmd->Length, &hostPrepare); exec = exec->Next) { }
+	sentinelDispatchLeave(parity);
+	if (forDevice && hostPrepare && !hostPrepare(msg, cmd->Data, cmd->Data + cmd->Length + msg->Size, map->Offset)) {
+		printf("msg too long");
+		exit(0);
+	}
+	long long finished = sentinelClock();
+	sentinelStatsCommand(op, bytes, claimed, started, finished);
+	if (tracing) sentinelTraceCommand(&trace, claimed, started, finished);
+	if (!msg->Wait) sentinelRelease(map, cmd, id);
+	else if (forDevice) cmd->Status = 4;
+	else sentinelReply(map, cmd);
+}
+
+/* Ask the executor owning a command which stream it belongs to. An executor without an Affinity could own anything, so it keeps everything in order. */
+static intptr_t sentinelAffinity(sentinelCommand *cmd, bool forDevice)
+{
+	sentinelMessage *msg = (sentinelMessage *)cmd->Data;
+	intptr_t key = SENTINEL_SERIAL;
+	int parity = sentinelDispatchEnter();
+	sentinelExecutor *exec = sentinelOpExecutor(msg, forDevice);
+	if (!exec || !exec->Affinity || !exec->Affinity(exec->Tag, msg, cmd->Length, &key))
+		for (key = SENTINEL_SERIAL, exec = forDevice ? _ctx.DeviceList : _ctx.HostList; exec && exec->Executor && exec->Affinity && !exec->Affinity(exec->Tag, msg, cmd->Length, &key); exec = exec->Next) { }
+	sentinelDispatchLeave(parity);
+	return key;
+}
+
+/* Hand a claimed command to a worker of its lane. Commands sharing a key land on one worker and keep their order, unkeyed ones take the shortest queue, serial ones wait for every worker of the lane to drain. Order holds within a lane only. */
+static void sentinelDispatch(sentinelMap *map, sentinelCommand *cmd, unsigned int id, bool forDevice)
+{
+	long long claimed = sentinelClock();
+	int first = _laneWorkers[map->Lane], count = _laneWorkers[map->Lane + 1] - first;
+	intptr_t key;
+	if (!count || (key = sentinelAffinity(cmd, forDevice)) == SENTINEL_SERIAL) {
+		for (int i = first; i < first + count; i++)
+			while (_workers[i].Depth) sentinelYield();
+		sentinelExecute(map, cmd, id, forDevice, claimed);
+		return;
+	}
+	sentinelWorker *w = &_workers[first];
+	if (key) { size_t h = (size_t)key; h ^= h >> 16; h *= 0x45d9f3b; h ^= h >> 16; w = &_workers[first + h % count]; }
+	else for (int i = first + 1; i < first + count; i++) if (_workers[i].Depth < w->Depth) w = &_workers[i];
+	sentinelMutexEnter(&w->Lock);
+	sentinelWork *work = &w->Queue[w->Tail];
+	work->Map = map; work->Cmd = cmd; work->Id = id; work->ForDevice = forDevice; work->Claimed = claimed;
+	int depth = sentinelAtomicAddInt(&w->Depth, 1);
+	if (depth > w->Stats.MaxDepth) w->Stats.MaxDepth = depth;
+	sentinelMemoryBarrier();
+	w->Tail = w->Tail + 1 == SENTINEL_WORKQUEUE ? 0 : w->Tail + 1;
+	sentinelMutexLeave(&w->Lock);
+	sentinelMemoryBarrier();
+	if (w->Sleeping) sentinelFutexWake(&w->Tail);
+}
+
+static SENTINEL_THREADPROC(sentinelWorkerThread, data)
+{
+	sentinelWorker *w = (sentinelWorker *)data;
+	sentinelWaitPolicy *policy = &_sentinelWaitPolicy[SENTINEL_WAITHOST];
+	int polls = 0;
+	while (true) {
+		int tail = w->Tail;
+		if (w->Head == tail) {
+			// queue empty, drained completely before honouring a shutdown
+			if (!_workersRunning) break;
+			if (polls++ < policy->SpinCount) { sentinelPause(); continue; }
+			w->Sleeping = 1;
+			sentinelMemoryBarrier();
+			if (w->Tail == tail) sentinelFutexWait(&w->Tail, tail, policy->BlockMs);
+			w->Sleeping = 0;
+			continue;
+		}
+		polls = 0;
+		sentinelMemoryBarrier();
+		sentinelWork *work = &w->Queue[w->Head];
+		sentinelExecute(work->Map, work->Cmd, work->Id, work->ForDevice, work->Claimed);
+		w->Head = w->Head + 1 == SENTINEL_WORKQUEUE ? 0 : w->Head + 1;
+		w->Stats.Commands++;
+		sentinelAtomicAddInt(&w->Depth, -1);
+	}
+	return SENTINEL_THREADEXIT;
+}
+
+/* Start count workers for the bulk lane and SENTINEL_LANEWORKERS for each other lane, or none at all so every lane executes on its map threads. */
+static bool sentinelWorkersStart(int count)
+{
+	if (count <= 0) return true;
+	_laneWorkers[0] = 0;
+	for (int lane = 0; lane < SENTINEL_LANES; lane++)
+		_laneWorkers[lane + 1] = _laneWorkers[lane] + (lane == SENTINEL_LANEBULK ? count : SENTINEL_LANEWORKERS);
+	count = _laneWorkers[SENTINEL_LANES];
+	if (!(_workers = (sentinelWorker *)calloc(count, sizeof(sentinelWorker)))) return false;
+	_workersRunning = true;
+	for (_workerCount = 0; _workerCount < count; _workerCount++) {
+		sentinelWorker *w = &_workers[_workerCount];
+		sentinelMutexInitialize(&w->Lock);
+		if (!sentinelThreadStart(&w->Thread, sentinelWorkerThread, w)) { sentinelMutexDestroy(&w->Lock); return false; }
+	}
+	return true;
+}
+
+/* Stop the workers once the map threads are gone, letting them finish whatever is queued. */
+static void sentinelWorkersStop()
+{
+	_workersRunning = false;
+	for (int i = 0; i < _workerCount; i++) {
+		sentinelFutexWake(&_workers[i].Tail);
+		sentinelThreadJoin(_workers[i].Thread);
+		sentinelMutexDestroy(&_workers[i].Lock);
+	}
+	_workerCount = 0;
+	memset(_laneWorkers, 0, sizeof(_laneWorkers));
+	if (_workers) { free(_workers); _workers = nullptr; }
+}
+
+bool sentinelGetWorkerStats(int worker, sentinelWorkerStats *stats, bool reset)
+{
+	if (worker < 0 || worker >= _workerCount) return false;
+	sentinelWorker *w = &_workers[worker];
+	*stats = w->Stats;
+	stats->Depth = w->Depth;
+	if (reset) { w->Stats.Commands = 0; w->Stats.MaxDepth = w->Depth; }
+	return true;
+}
+
+#pragma endregion
 
 // HOSTSENTINEL
 #if HAS_HOSTSENTINEL
 
-static HANDLE _hostMapHandle = NULL;
-static int *_hostMap = nullptr;
-static HANDLE _threadHostHandle = NULL;
-static unsigned int __stdcall sentinelHostThread(void *data) 
+typedef struct sentinelRegion {
+	void *Base;
+	size_t Size;
+	char Name[MAX_PATH];
+	int Fd; // posix: kept open and flock'd by the creator while it serves the region, -1 otherwise
+} sentinelRegion;
+
+static sentinelRegion _hostRegion;
+static sentinelRegion _clientRings[SENTINEL_CLIENTS]; // server: a ring per client process
+static sentinelMap *_clientMaps[SENTINEL_CLIENTS];
+static sentinelRegion _ownRing; // client: the ring we were given, if any
+static int _ownEntry = -1;
+static volatile int _drainPolicy = SENTINEL_DRAINROUNDROBIN;
+static sentinelThread _threadHostHandle[SENTINEL_LANES];
+static int _threadHostCount = 0;
+static volatile bool _threadHostRunning = false;
+
+/* Take the command at the head of a ring if it has been published, handing it to the workers. */
+static bool sentinelHostClaim(sentinelMap *map)
 {
-	sentinelContext *ctx = &_ctx;
-	sentinelMap *map = ctx->HostMap;
-	while (map) {
-		long id = map->GetId;
-		sentinelCommand *cmd = (sentinelCommand *)&map->Data[id%sizeof(map->Data)];
-		volatile long *status = (volatile long *)&cmd->Status;
-		unsigned int s_;
-		while (_threadHostHandle && (s_ = InterlockedCompareExchange((long *)status, 3, 2)) != 2) { /*printf("(%d)", s_);*/ Sleep(50); } //
-		if (!_threadHostHandle) return 0;
-		if (cmd->Magic != SENTINEL_MAGIC) {
-			printf("Bad Sentinel Magic");
-			exit(1);
+	unsigned int id = map->GetId;
+	sentinelCommand *cmd = SENTINEL_SLOT(map, id);
+	if (sentinelCompareExchange(&cmd->Status, 3, 2) != 2) return false;
+	if (cmd->Magic != SENTINEL_MAGIC) {
+		printf("Bad Sentinel Magic");
+		exit(1);
+	}
+	//map->Dump();
+	sentinelStatsClaim(SENTINEL_DEVICEMAPS, map, id);
+	map->GetId = id + 1;
+	sentinelDispatch(map, cmd, id, false);
+	return true;
+}
+
+static bool sentinelHostPending(int lane)
+{
+	sentinelMap *map = _ctx.HostMap + lane;
+	if (SENTINEL_SLOT(map, map->GetId)->Status == 2) return true;
+	for (int i = 0; i < SENTINEL_CLIENTS; i++)
+		if (_clientMaps[i] && SENTINEL_SLOT(map = _clientMaps[i] + lane, map->GetId)->Status == 2) return true;
+	return false;
+}
+
+/* Drain one lane of the host map and of every client ring in turn, one command each per round or, weighted, up to the client's Weight.
+** With nothing published anywhere spin, yield and then block on the lane's doorbell, which clients ring only while we sleep on it. */
+static SENTINEL_THREADPROC(sentinelHostThread, data)
+{
+	int lane = (int)(intptr_t)data;
+	sentinelClientTable *table = _sentinelHostClients;
+	sentinelWaitPolicy *policy = &_sentinelWaitPolicy[SENTINEL_WAITHOST];
+	sentinelWaitStats *stats = &_sentinelWaitStats[SENTINEL_WAITHOST];
+	int idle = 0;
+	while (_threadHostRunning) {
+		bool drained = false;
+		if (sentinelHostClaim(_ctx.HostMap + lane)) drained = true;
+		for (int i = 0; i < SENTINEL_CLIENTS; i++) {
+			if (!_clientMaps[i]) continue;
+			int quantum = _drainPolicy == SENTINEL_DRAINWEIGHTED && table->Client[i].Weight > 1 ? table->Client[i].Weight : 1;
+			for (int n = 0; n < quantum && sentinelHostClaim(_clientMaps[i] + lane); n++) drained = true;
 		}
-		//map->Dump();
-		//cmd->Dump();
-		sentinelMessage *msg = (sentinelMessage *)cmd->Data;
-		char *(*hostPrepare)(void*,char*,char*,intptr_t) = nullptr;
-		for (sentinelExecutor *exec = _ctx.HostList; exec && exec->Executor && !exec->Executor(exec->Tag, msg, cmd->Length, &hostPrepare); exec = exec->Next) { }
-		//printf(".");
-		*status = msg->Wait ? 4 : 0;
-		map->GetId += SENTINEL_MSGSIZE;
+		if (drained) {
+			if (idle <= policy->SpinCount) sentinelAtomicAdd64(&stats->SpinHits, 1);
+			else if (idle <= policy->SpinCount + policy->YieldCount) sentinelAtomicAdd64(&stats->YieldHits, 1);
+			else sentinelAtomicAdd64(&stats->BlockHits, 1);
+			idle = 0;
+			continue;
+		}
+		if (idle < policy->SpinCount) { idle++; sentinelAtomicAdd64(&stats->Spins, 1); sentinelPause(); continue; }
+		if (idle < policy->SpinCount + policy->YieldCount) { idle++; sentinelAtomicAdd64(&stats->Yields, 1); sentinelYield(); continue; }
+		idle = policy->SpinCount + policy->YieldCount + 1;
+		int doorbell = table->Doorbell[lane];
+		sentinelAtomicAddInt(&table->Sleepers[lane], 1);
+		if (!sentinelHostPending(lane) && _threadHostRunning) { sentinelFutexWait(&table->Doorbell[lane], doorbell, policy->BlockMs); sentinelAtomicAdd64(&stats->Blocks, 1); }
+		sentinelAtomicAddInt(&table->Sleepers[lane], -1);
 	}
-	return 0;
+	return SENTINEL_THREADEXIT;
+}
+
+void sentinelSetDrainPolicy(int policy)
+{
+	_drainPolicy = policy;
 }
 
 #endif
 
 // DEVICESENTINEL
 #if HAS_DEVICESENTINEL
-
 static bool _sentinelDevice = false;
 static int *_deviceMap[SENTINEL_DEVICEMAPS];
-static HANDLE _threadDeviceHandle[SENTINEL_DEVICEMAPS];
-static unsigned int __stdcall sentinelDeviceThread(void *data) 
+#endif
+
+// device map threads, one per lane of each map in use. these also drain the maps of the emulator so they build without a device
+static sentinelThread _threadDeviceHandle[SENTINEL_DEVICEMAPS*SENTINEL_LANES];
+static int _threadDeviceCount = 0;
+static volatile bool _threadDeviceRunning = false;
+static SENTINEL_THREADPROC(sentinelDeviceThread, data)
 {
-	int threadId = (int)data;
+	int threadId = (int)(intptr_t)data / SENTINEL_LANES;
 	sentinelContext *ctx = &_ctx;
-	sentinelMap *map = ctx->DeviceMap[threadId];
+	sentinelMap *map = ctx->DeviceMap[threadId] + (int)(intptr_t)data % SENTINEL_LANES;
 	while (map) {
-		long id = map->GetId;
-		sentinelCommand *cmd = (sentinelCommand *)&map->Data[id%sizeof(map->Data)];
-		volatile long *status = (volatile long *)&cmd->Status;
-		unsigned int s_;
-		while (_threadDeviceHandle[threadId] && (s_ = InterlockedCompareExchange((long *)status, 3, 2)) != 2) { /*printf("(%d)", s_);*/ Sleep(50); }
-		if (!_threadDeviceHandle[threadId]) return 0;
+		unsigned int id = map->GetId;
+		sentinelCommand *cmd = SENTINEL_SLOT(map, id);
+		volatile int *status = (volatile int *)&cmd->Status;
+		// the device cannot ring a host doorbell, so a blocked wait always runs to BlockMs
+		if (!sentinelWait(SENTINEL_WAITDEVICE, status, 3, 2, &map->Sleepers, &_threadDeviceRunning)) return SENTINEL_THREADEXIT;
 		if (cmd->Magic != SENTINEL_MAGIC) {
 			printf("Bad Sentinel Magic");
 			exit(1);
 		}
 		//map->Dump();
-		cmd->Dump();
-		char *(*hostPrepare)(void*,char*,char*,intptr_t) = nullptr;
-		sentinelMessage *msg = (sentinelMessage *)&cmd->Data; //(cmd->Data + map->Offset);
-		for (sentinelExecutor *exec = _ctx.DeviceList; exec && exec->Executor && !exec->Executor(exec->Tag, msg, cmd->Length, &hostPrepare); exec = exec->Next) { }
-		//printf(".");
-		if (hostPrepare && !hostPrepare(msg, cmd->Data, cmd->Data + cmd->Length + msg->Size, map->Offset)) {
-			printf("msg too long");
-			exit(0);
+		sentinelStatsClaim(threadId, map, id);
+		map->GetId = id + 1;
+		sentinelDispatch(map, cmd, id, true);
+	}
+	return SENTINEL_THREADEXIT;
+}
+
+static bool sentinelDeviceThreadsStart()
+{
+	_threadDeviceRunning = true;
+	for (_threadDeviceCount = 0; _threadDeviceCount < _ctx.DeviceMapCount*SENTINEL_LANES; _threadDeviceCount++)
+		if (!sentinelThreadStart(&_threadDeviceHandle[_threadDeviceCount], sentinelDeviceThread, (void *)(intptr_t)_threadDeviceCount))
+			return false;
+	return true;
+}
+
+static void sentinelDeviceThreadsStop()
+{
+	if (!_threadDeviceRunning) return;
+	_threadDeviceRunning = false;
+	for (int i = 0; i < _threadDeviceCount; i++)
+		sentinelThreadJoin(_threadDeviceHandle[i]);
+	_threadDeviceCount = 0;
+}
+
+// EMULATOR
+#pragma region EMULATOR
+
+// the emulator stands in for a device: each device map is mapped twice, producers publish through one view and the server drains the
+// other, so Offset fix-ups are exercised just as under cudaHostGetDevicePointer.
+static bool _sentinelEmulated = false;
+#if __OS_WIN
+static HANDLE _emulatedMapHandle[SENTINEL_DEVICEMAPS];
+#endif
+
+static void sentinelEmulatedMapClose(int i)
+{
+#if __OS_WIN
+	if (_sentinelEmulatedMap[i]) UnmapViewOfFile(_sentinelEmulatedMap[i]);
+	if (_ctx.DeviceMap[i]) UnmapViewOfFile(_ctx.DeviceMap[i]);
+	if (_emulatedMapHandle[i]) { CloseHandle(_emulatedMapHandle[i]); _emulatedMapHandle[i] = NULL; }
+#else
+	if (_sentinelEmulatedMap[i]) munmap(_sentinelEmulatedMap[i], sizeof(sentinelMap)*SENTINEL_LANES);
+	if (_ctx.DeviceMap[i]) munmap(_ctx.DeviceMap[i], sizeof(sentinelMap)*SENTINEL_LANES);
+#endif
+	_sentinelEmulatedMap[i] = _ctx.DeviceMap[i] = nullptr;
+}
+
+static bool sentinelEmulatedMapOpen(int i)
+{
+	void *host = nullptr, *device = nullptr;
+	size_t size = sizeof(sentinelMap)*SENTINEL_LANES;
+#if __OS_WIN
+	if (!(_emulatedMapHandle[i] = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, NULL)))
+		return false;
+	host = MapViewOfFile(_emulatedMapHandle[i], FILE_MAP_ALL_ACCESS, 0, 0, size);
+	device = MapViewOfFile(_emulatedMapHandle[i], FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+	char name[MAX_PATH];
+	snprintf(name, sizeof(name), "/sentinel-emulator-%d-%d", (int)getpid(), i);
+	int fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0600);
+	if (fd < 0)
+		return false;
+	shm_unlink(name);
+	if (!ftruncate(fd, size)) {
+		if ((host = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) host = nullptr;
+		if ((device = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) device = nullptr;
+	}
+	close(fd);
+#endif
+	_ctx.DeviceMap[i] = (sentinelMap *)host;
+	_sentinelEmulatedMap[i] = (sentinelMap *)device;
+	if (!host || !device) { sentinelEmulatedMapClose(i); return false; }
+	sentinelMapInitialize(_ctx.DeviceMap[i], (intptr_t)((char *)host - (char *)device), false);
+	return true;
+}
+
+/* Stand host memory in for the device maps and drain them, for producers using sentinelEmulatedSend. Call after sentinelServerInitialize
+** without a device sentinel; sentinelServerShutdown tears the emulator down. Returns false if device maps already exist. */
+bool sentinelEmulatorInitialize()
+{
+	if (_sentinelEmulated || _threadDeviceRunning) return false;
+	sentinelWaitPolicyDefaults();
+	if (_ctx.DeviceMapCount < 1) _ctx.DeviceMapCount = 1;
+	_sentinelEmulatedMapCount = _ctx.DeviceMapCount;
+	for (int i = 0; i < _ctx.DeviceMapCount; i++)
+		if (!sentinelEmulatedMapOpen(i)) {
+			while (i--) sentinelEmulatedMapClose(i);
+			return false;
 		}
-		*status = msg->Wait ? 4 : 0;
-		map->GetId += SENTINEL_MSGSIZE;
+	_sentinelEmulated = true;
+	if (!sentinelDeviceThreadsStart()) {
+		sentinelDeviceThreadsStop();
+		for (int i = 0; i < SENTINEL_DEVICEMAPS; i++) sentinelEmulatedMapClose(i);
+		_sentinelEmulated = false;
+		return false;
 	}
-	return 0;
+	return true;
 }
 
+#pragma endregion
+
+// HOSTMAP
+#if HAS_HOSTSENTINEL
+
+#if __OS_WIN
+/* Open the wake events of a region every process maps, named after it, so sentinelFutexWake in one process reaches waiters in another. */
+static void sentinelWakeRegister(void *base, size_t size, const char *name)
+{
+	for (int i = 0; i < SENTINEL_WAKEREGIONS; i++) {
+		sentinelWakeRegion *r = &_sentinelWakeRegions[i];
+		if (r->Base) continue;
+		char eventName[MAX_PATH];
+		for (int j = 0; j < SENTINEL_WAKEBUCKETS; j++) {
+			snprintf(eventName, sizeof(eventName), "%s.wake%d", name, j);
+			// manual reset: a wake releases every waiter of the bucket, each resets it before its next check
+			if (!(r->Event[j] = CreateEvent(NULL, TRUE, FALSE, eventName))) {
+				printf("Could not create wake event (%d).\n", GetLastError());
+				while (j--) CloseHandle(r->Event[j]);
+				return;
+			}
+		}
+		r->Size = size;
+		sentinelMemoryBarrier();
+		r->Base = (char *)base;
+		return;
+	}
+}
+
+static void sentinelWakeUnregister(void *base)
+{
+	for (int i = 0; i < SENTINEL_WAKEREGIONS; i++) {
+		sentinelWakeRegion *r = &_sentinelWakeRegions[i];
+		if (r->Base != base) continue;
+		r->Base = nullptr;
+		for (int j = 0; j < SENTINEL_WAKEBUCKETS; j++) CloseHandle(r->Event[j]);
+		return;
+	}
+}
 #endif
 
 // https://msdn.microsoft.com/en-us/library/windows/desktop/aa366551(v=vs.85).aspx
+// http://man7.org/linux/man-pages/man7/shm_overview.7.html
+/* Map a named shared memory region, the server creating it. Creating never reuses a region that exists, that fails with errno
+** EEXIST and nothing printed; otherwise prints why and returns nullptr on failure. */
+static void *sentinelRegionOpen(sentinelRegion *r, const char *name, size_t size, bool create)
+{
+	r->Base = nullptr;
+	r->Size = size;
+	r->Fd = -1;
+#if __OS_WIN
+	snprintf(r->Name, sizeof(r->Name), "%s", name);
+	HANDLE handle = create
+		? CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)size, r->Name)
+		: OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, r->Name);
+	if (!handle) {
+		printf("Could not %s file mapping object (%d).\n", create ? "create" : "open", GetLastError());
+		return nullptr;
+	}
+	if (create && GetLastError() == ERROR_ALREADY_EXISTS) {
+		CloseHandle(handle);
+		errno = EEXIST;
+		return nullptr;
+	}
+	if (!(r->Base = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size)))
+		printf("Could not map view of file (%d).\n", GetLastError());
+	else sentinelWakeRegister(r->Base, size, r->Name);
+	// the view keeps the mapping alive
+	CloseHandle(handle);
+#else
+	// posix shared memory names are rooted, SENTINEL_NAME is not
+	snprintf(r->Name, sizeof(r->Name), "%s%s", name[0] != '/' ? "/" : "", name);
+	// O_EXCL: truncating a region another server has mapped would fault it with SIGBUS
+	int fd = create
+		? shm_open(r->Name, O_RDWR|O_CREAT|O_EXCL, 0666)
+		: shm_open(r->Name, O_RDWR, 0);
+	if (fd == -1) {
+		if (!create || errno != EEXIST)
+			printf("Could not %s shared memory object (%d).\n", create ? "create" : "open", errno);
+		return nullptr;
+	}
+	// the lock goes when the creator does however it ends, which is how a second server tells a crashed one's region
+	if (create && (flock(fd, LOCK_EX|LOCK_NB) || ftruncate(fd, size))) {
+		printf("Could not size shared memory object (%d).\n", errno);
+		close(fd); shm_unlink(r->Name);
+		return nullptr;
+	}
+	if ((r->Base = mmap(nullptr, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		r->Base = nullptr;
+		printf("Could not map shared memory object (%d).\n", errno);
+		if (create) shm_unlink(r->Name);
+	}
+	if (create && r->Base) r->Fd = fd;
+	else close(fd);
+#endif
+	return r->Base;
+}
+
+static void sentinelRegionClose(sentinelRegion *r, bool unlink)
+{
+	if (!r->Base) return;
+#if __OS_WIN
+	sentinelWakeUnregister(r->Base);
+	UnmapViewOfFile(r->Base);
+#else
+	munmap(r->Base, r->Size);
+	if (unlink) shm_unlink(r->Name);
+	if (r->Fd != -1) { close(r->Fd); r->Fd = -1; }
+#endif
+	r->Base = nullptr;
+}
+
+/* A host map name already taken is removed only when the server that made it is gone, and true returned so it can be created
+** again. A live server keeps its map, the caller is told to pick another name. */
+static bool sentinelHostMapStale(const char *mapHostName)
+{
+#if !__OS_WIN
+	// windows drops a mapping with its last handle, only posix leaves one behind a crash
+	char name[MAX_PATH];
+	snprintf(name, sizeof(name), "%s%s", mapHostName[0] != '/' ? "/" : "", mapHostName);
+	int fd = shm_open(name, O_RDONLY, 0);
+	if (fd == -1) return errno == ENOENT;
+	bool stale = !flock(fd, LOCK_EX|LOCK_NB);
+	if (stale) shm_unlink(name);
+	close(fd);
+	if (stale) return true;
+#endif
+	printf("sentinel: map %s is in use by another server, start this one under another name.\n", mapHostName);
+	return false;
+}
+
+/* The host map region holds the map everyone can send through, followed by the table clients take their own rings from. */
+static void sentinelHostMapOpen(const char *mapHostName, bool create)
+{
+	size_t size = MEMORY_ALIGNMENT + SENTINEL_MAPSIZE + 64 + sizeof(sentinelClientTable);
+	if (!sentinelRegionOpen(&_hostRegion, mapHostName, size, create)) {
+		if (!create || errno != EEXIST || !sentinelHostMapStale(mapHostName))
+			exit(1);
+		if (!sentinelRegionOpen(&_hostRegion, mapHostName, size, true)) {
+			if (errno == EEXIST) sentinelHostMapStale(mapHostName);
+			exit(1);
+		}
+	}
+	_sentinelHostMap = _ctx.HostMap = (sentinelMap *)_ROUNDN(_hostRegion.Base, MEMORY_ALIGNMENT);
+	_sentinelHostClients = (sentinelClientTable *)_ROUNDN((char *)_ctx.HostMap + SENTINEL_MAPSIZE, 64);
+}
+
+static void sentinelHostMapClose(bool unlink)
+{
+	sentinelRegionClose(&_hostRegion, unlink);
+	_sentinelHostMap = _ctx.HostMap = nullptr;
+	_sentinelHostClients = nullptr;
+}
+
+/* Map client ring i, named after the host map. */
+static sentinelMap *sentinelClientRingOpen(sentinelRegion *r, const char *mapHostName, int i, bool create)
+{
+	char name[MAX_PATH];
+	snprintf(name, sizeof(name), "%s.%d", mapHostName, i);
+	void *base = sentinelRegionOpen(r, name, MEMORY_ALIGNMENT + SENTINEL_MAPSIZE, create);
+#if !__OS_WIN
+	// holding the host map makes the rings under its name ours, one still there is a dead server's and goes
+	if (!base && create && errno == EEXIST) {
+		shm_unlink(r->Name);
+		base = sentinelRegionOpen(r, name, MEMORY_ALIGNMENT + SENTINEL_MAPSIZE, create);
+	}
+#endif
+	return base ? (sentinelMap *)_ROUNDN(base, MEMORY_ALIGNMENT) : nullptr;
+}
+
+/* Offer SENTINEL_CLIENTS rings, or as many as could be made. */
+static void sentinelClientRingsOpen(const char *mapHostName)
+{
+	sentinelClientTable *table = _sentinelHostClients;
+	memset(table, 0, sizeof(sentinelClientTable));
+	for (table->Count = 0; table->Count < SENTINEL_CLIENTS; table->Count++) {
+		sentinelMap *map = sentinelClientRingOpen(&_clientRings[table->Count], mapHostName, table->Count, true);
+		if (!map) break;
+		sentinelMapInitialize(map, (intptr_t)map, true);
+		_clientMaps[table->Count] = map;
+	}
+}
+
+static void sentinelClientRingsClose()
+{
+	for (int i = 0; i < SENTINEL_CLIENTS; i++) {
+		_clientMaps[i] = nullptr;
+		sentinelRegionClose(&_clientRings[i], true);
+	}
+}
+
+/* A ring left by a client that died can be handed out again once the server holds none of its commands: re-seed every slot for its
+** next lap so replies nobody will collect no longer pin them, and take back whatever it left allocated from the pool. */
+static bool sentinelClientRingReset(sentinelMap *map)
+{
+	for (sentinelMap *m = map; m != map + SENTINEL_LANES; m++) {
+		if (m->GetId != m->SetId) return false;
+		for (int i = 0; i < SENTINEL_MSGCOUNT; i++)
+			if (SENTINEL_SLOT(m, i)->Status == 3) return false;
+	}
+	for (sentinelMap *m = map; m != map + SENTINEL_LANES; m++)
+		for (unsigned int id = m->SetId; id != m->SetId + SENTINEL_MSGCOUNT; id++) {
+			sentinelCommand *cmd = SENTINEL_SLOT(m, id);
+			cmd->Status = 0;
+			cmd->Seq = (int)id;
+		}
+	memset(SENTINEL_POOL(map), 0, offsetof(sentinelPool, Data));
+	sentinelMemoryBarrier();
+	return true;
+}
+
+#endif
+
 // https://github.com/pathscale/nvidia_sdk_samples/blob/master/simpleStreams/0_Simple/simpleStreams/simpleStreams.cu
-void sentinelServerInitialize(sentinelExecutor *executor, char *mapHostName, bool hostSentinel, bool deviceSentinel)
+/* deviceMaps is how many device maps senders are routed across (SENTINEL_ROUTE), clamped to 1..SENTINEL_DEVICEMAPS. The emulator
+** stands in for the same number. */
+void sentinelServerInitialize(sentinelExecutor *executor, const char *mapHostName, bool hostSentinel, bool deviceSentinel, int workers, int deviceMaps)
 {
+	sentinelWaitPolicyDefaults();
+	_ctx.DeviceMapCount = deviceMaps < 1 ? 1 : deviceMaps > SENTINEL_DEVICEMAPS ? SENTINEL_DEVICEMAPS : deviceMaps;
+
 	// create host map
 #if HAS_HOSTSENTINEL
 	if (hostSentinel) {
-		_hostMapHandle = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(sentinelMap) + MEMORY_ALIGNMENT, mapHostName);
-		if (!_hostMapHandle) {
-			printf("Could not create file mapping object (%d).\n", GetLastError());
-			exit(1);
-		}
-		_hostMap = (int *)MapViewOfFile(_hostMapHandle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(sentinelMap) + MEMORY_ALIGNMENT);
-		if (!_hostMap) {
-			printf("Could not map view of file (%d).\n", GetLastError());
-			CloseHandle(_hostMapHandle);
-			exit(1);
-		}
-		_sentinelHostMap = _ctx.HostMap = (sentinelMap *)_ROUNDN(_hostMap, MEMORY_ALIGNMENT);
-		_ctx.HostMap->Offset = (intptr_t)_sentinelHostMap;
+		sentinelHostMapOpen(mapHostName, true);
+		sentinelMapInitialize(_ctx.HostMap, (intptr_t)_sentinelHostMap, true);
+		sentinelClientRingsOpen(mapHostName);
 	}
 #endif
 
-	// create device maps
-#if HAS_DEVICESENTINEL
+	// create device maps, compiled as host code the emulator's stand in for them
+#if HAS_DEVICESENTINEL && !defined(LIBCU_HOST)
 	if (deviceSentinel) {
 		_sentinelDevice = true;
-		sentinelMap *d_deviceMap[SENTINEL_DEVICEMAPS];
-		for (int i = 0; i < SENTINEL_DEVICEMAPS; i++) {
-			cudaErrorCheckF(cudaHostAlloc((void **)&_deviceMap[i], sizeof(sentinelMap), cudaHostAllocPortable|cudaHostAllocMapped), goto initialize_error);
+		sentinelMap *d_deviceMap[SENTINEL_DEVICEMAPS] = { };
+		for (int i = 0; i < _ctx.DeviceMapCount; i++) {
+			cudaErrorCheckF(cudaHostAlloc((void **)&_deviceMap[i], SENTINEL_MAPSIZE, cudaHostAllocPortable|cudaHostAllocMapped), goto initialize_error);
 			d_deviceMap[i] = _ctx.DeviceMap[i] = (sentinelMap *)_deviceMap[i];
 			cudaErrorCheckF(cudaHostGetDevicePointer((void **)&d_deviceMap[i], _ctx.DeviceMap[i], 0), goto initialize_error);
 #ifndef _WIN64
-			_ctx.DeviceMap[i]->Offset = (intptr_t)((char *)_deviceMap[i] - (char *)d_deviceMap[i]);
+			sentinelMapInitialize(_ctx.DeviceMap[i], (intptr_t)((char *)_deviceMap[i] - (char *)d_deviceMap[i]), true);
 			//printf("chk: %x %x [%x]\n", (char *)_deviceMap[i], (char *)d_deviceMap[i], _ctx.DeviceMap[i]->Offset);
 #else
-			_ctx.DeviceMap[i]->Offset = 0;
+			sentinelMapInitialize(_ctx.DeviceMap[i], 0, true);
 #endif
 		}
 		cudaErrorCheckF(cudaMemcpyToSymbol(_sentinelDeviceMap, &d_deviceMap, sizeof(d_deviceMap)), goto initialize_error);
+		cudaErrorCheckF(cudaMemcpyToSymbol(_sentinelDeviceMapCount, &_ctx.DeviceMapCount, sizeof(int)), goto initialize_error);
 	}
 #endif
 
-	// register executor
+	// register executor, the base opcodes all sit in 1..127 (sentinel-*msg.h)
 	sentinelRegisterExecutor(&_baseExecutor, true);
+	sentinelRegisterExecutorOps(&_baseExecutor, 1, 127);
 	if (executor)
 		sentinelRegisterExecutor(executor, true);
 
-	// launch threads
+	// launch threads, workers first so the map threads always have somewhere to dispatch
+	if (!sentinelWorkersStart(workers))
+		goto initialize_error;
 #if HAS_HOSTSENTINEL
 	if (hostSentinel) {
-		_threadHostHandle = (HANDLE)_beginthreadex(0, 0, sentinelHostThread, nullptr, 0, 0);
+		_threadHostRunning = true;
+		for (_threadHostCount = 0; _threadHostCount < SENTINEL_LANES; _threadHostCount++)
+			if (!sentinelThreadStart(&_threadHostHandle[_threadHostCount], sentinelHostThread, (void *)(intptr_t)_threadHostCount))
+				goto initialize_error;
 	}
 #endif
-#if HAS_DEVICESENTINEL
-	if (deviceSentinel) {
-		memset(_threadDeviceHandle, 0, sizeof(_threadDeviceHandle));
-		for (int i = 0; i < SENTINEL_DEVICEMAPS; i++)
-			_threadDeviceHandle[i] = (HANDLE)_beginthreadex(0, 0, sentinelDeviceThread, (void *)i, 0, 0);
-	}
+#if HAS_DEVICESENTINEL && defined(LIBCU_HOST)
+	if (deviceSentinel && !sentinelEmulatorInitialize())
+		goto initialize_error;
+#elif HAS_DEVICESENTINEL
+	if (deviceSentinel && !sentinelDeviceThreadsStart())
+		goto initialize_error;
 #endif
+	{
+		const char *trace = getenv("SENTINEL_TRACE");
+		if (trace && *trace && !sentinelTraceStart(trace))
+			printf("sentinel: could not open trace %s\n", trace);
+	}
 	return;
 initialize_error:
 	printf("sentinelServerInitialize:Error");
@@ -167,47 +1006,90 @@ initialize_error:
 
 void sentinelServerShutdown()
 {
+	sentinelSetStatsDump(0);
+	// what device code buffered for host streams goes out while there is still a server to take it
+#if HAS_DEVICESENTINEL
+	if (_sentinelDevice || _sentinelEmulated)
+		cudaErrorCheckA(cudaDeviceFlushHostStreams());
+#endif
+	// stop map threads, then the workers still holding their commands
+#if HAS_HOSTSENTINEL
+	if (_threadHostRunning) {
+		_threadHostRunning = false;
+		for (int i = 0; i < _threadHostCount; i++) {
+			sentinelRing(&_sentinelHostClients->Doorbell[i], &_sentinelHostClients->Sleepers[i]);
+			sentinelThreadJoin(_threadHostHandle[i]);
+		}
+		_threadHostCount = 0;
+	}
+#endif
+	sentinelDeviceThreadsStop();
+	sentinelWorkersStop();
+	sentinelTraceStop();
 	// close host map
 #if HAS_HOSTSENTINEL
-	if (_hostMapHandle) { 
-		if (_threadHostHandle) { CloseHandle(_threadHostHandle); _threadHostHandle = NULL; }
-		if (_hostMap) { UnmapViewOfFile(_hostMap); _hostMap = nullptr; }
-		CloseHandle(_hostMapHandle); _hostMapHandle = NULL;
+	if (_hostRegion.Base) {
+		sentinelClientRingsClose();
+		sentinelHostMapClose(true);
 	}
 #endif
 	// close device maps
 #if HAS_DEVICESENTINEL
 	if (_sentinelDevice) {
-		for (int i = 0; i < SENTINEL_DEVICEMAPS; i++) {
-			if (_threadDeviceHandle[i]) { CloseHandle(_threadDeviceHandle[i]); _threadDeviceHandle[i] = NULL; }
-			if (_deviceMap[i]) { cudaErrorCheckA(cudaFreeHost(_deviceMap[i])); _deviceMap[i] = nullptr; }
-		}
+		for (int i = 0; i < SENTINEL_DEVICEMAPS; i++)
+			if (_deviceMap[i]) { cudaErrorCheckA(cudaFreeHost(_deviceMap[i])); _deviceMap[i] = nullptr; _ctx.DeviceMap[i] = nullptr; }
+		_sentinelDevice = false;
 	}
 #endif
+	if (_sentinelEmulated) {
+		for (int i = 0; i < SENTINEL_DEVICEMAPS; i++) sentinelEmulatedMapClose(i);
+		_sentinelEmulated = false;
+	}
 }
 
 #if HAS_HOSTSENTINEL
-void sentinelClientInitialize(char *mapHostName)
+void sentinelClientInitialize(const char *mapHostName, int weight)
 {
-	_hostMapHandle = OpenFileMapping(FILE_MAP_ALL_ACCESS, FALSE, mapHostName);
-	if (!_hostMapHandle) {
-		printf("Could not open file mapping object (%d).\n", GetLastError());
-		exit(1);
-	}
-	_hostMap = (int *)MapViewOfFile(_hostMapHandle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(sentinelMap) + MEMORY_ALIGNMENT);
-	if (!_hostMap) {
-		printf("Could not map view of file (%d).\n", GetLastError());
-		CloseHandle(_hostMapHandle);
+	sentinelWaitPolicyDefaults();
+	sentinelHostMapOpen(mapHostName, false);
+	if (_ctx.HostMap->SlotSize != SENTINEL_MSGSIZE || _ctx.HostMap->SlotCount != SENTINEL_MSGCOUNT) {
+		printf("sentinel: server ring is %dx%d, client was built for %dx%d.\n", _ctx.HostMap->SlotCount, _ctx.HostMap->SlotSize, SENTINEL_MSGCOUNT, SENTINEL_MSGSIZE);
 		exit(1);
 	}
-	_sentinelHostMap = _ctx.HostMap = (sentinelMap *)_ROUNDN(_hostMap, MEMORY_ALIGNMENT);
-	_sentinelHostMapOffset = (intptr_t)((char *)_ctx.HostMap->Offset - (char *)_sentinelHostMap);
+	// take a ring of our own: a free entry first, then one a dead client left behind. With none to be had share the host map
+	sentinelClientTable *table = _sentinelHostClients;
+	for (int pass = 0; pass < 2 && _ownEntry < 0; pass++)
+		for (int i = 0; i < table->Count && _ownEntry < 0; i++) {
+			sentinelClientEntry *entry = &table->Client[i];
+			int state = !pass ? 0 : entry->State == 2 && !sentinelProcessAlive(entry->Pid) ? 2 : -1;
+			if (state < 0 || sentinelCompareExchange(&entry->State, 1, state) != state) continue;
+			sentinelMap *map = sentinelClientRingOpen(&_ownRing, mapHostName, i, false);
+			if (!map || (pass && !sentinelClientRingReset(map))) {
+				sentinelRegionClose(&_ownRing, false);
+				entry->State = state;
+				continue;
+			}
+			entry->Pid = sentinelProcessId();
+			entry->Weight = weight;
+			sentinelMemoryBarrier();
+			entry->State = 2;
+			_ownEntry = i;
+			_sentinelHostMap = map;
+		}
+	_sentinelHostMapOffset = (intptr_t)((char *)_sentinelHostMap->Offset - (char *)_sentinelHostMap);
 }
 
 void sentinelClientShutdown()
 {
-	if (_hostMap) { UnmapViewOfFile(_hostMap); _hostMap = nullptr; }
-	if (_hostMapHandle) { CloseHandle(_hostMapHandle); _hostMapHandle = NULL; }
+	if (_ownEntry >= 0) {
+		sentinelClientEntry *entry = &_sentinelHostClients->Client[_ownEntry];
+		sentinelRegionClose(&_ownRing, false);
+		entry->Pid = 0;
+		sentinelMemoryBarrier();
+		entry->State = 0;
+		_ownEntry = -1;
+	}
+	sentinelHostMapClose(false);
 }
 #endif
 
@@ -237,9 +1119,17 @@ static void sentinelUnlinkExecutor(sentinelExecutor *exec, bool forDevice)
 
 void sentinelRegisterExecutor(sentinelExecutor *exec, bool makeDefault, bool forDevice)
 {
+	while (sentinelCompareExchange(&_dispatchLock, 1, 0)) sentinelYield();
+	sentinelExecutor *head = forDevice ? _ctx.DeviceList : _ctx.HostList;
 	sentinelUnlinkExecutor(exec, forDevice);
 	sentinelExecutor *list = forDevice ? _ctx.DeviceList : _ctx.HostList;
 	if (makeDefault || !list) {
+		// the table stands in for the front of the list, so what the displaced default held there passes to the new one, which still
+		// falls back to the list for anything it declines
+		sentinelExecutor *volatile *ops = forDevice ? _ctx.DeviceOps : _ctx.HostOps;
+		if (head && head != exec)
+			for (int i = 0; i < SENTINEL_OPCOUNT; i++)
+				if (ops[i] == head) ops[i] = exec;
 		exec->Next = list;
 		if (forDevice) _ctx.DeviceList = exec;
 		else _ctx.HostList = exec;
@@ -248,9 +1138,45 @@ void sentinelRegisterExecutor(sentinelExecutor *exec, bool makeDefault, bool for
 		exec->Next = list->Next;
 		list->Next = exec;
 	}
+	sentinelMemoryBarrier();
+	_dispatchLock = 0;
 }
 
 void sentinelUnregisterExecutor(sentinelExecutor *exec, bool forDevice)
 {
+	while (sentinelCompareExchange(&_dispatchLock, 1, 0)) sentinelYield();
 	sentinelUnlinkExecutor(exec, forDevice);
+	sentinelExecutor *volatile *ops = forDevice ? _ctx.DeviceOps : _ctx.HostOps;
+	for (int i = 0; i < SENTINEL_OPCOUNT; i++)
+		if (ops[i] == exec) ops[i] = nullptr;
+	sentinelDispatchSynchronize();
+	_dispatchLock = 0;
+}
+
+/* Route opcodes opFirst..opLast straight to exec, taking them over from any executor that held them. Executors keep their place in the list,
+** which still catches opcodes no table entry claims or whose owner declines them. */
+void sentinelRegisterExecutorOps(sentinelExecutor *exec, int opFirst, int opLast, bool forDevice)
+{
+	assert(opFirst >= 0 && opFirst <= opLast && opLast < SENTINEL_OPCOUNT);
+	while (sentinelCompareExchange(&_dispatchLock, 1, 0)) sentinelYield();
+	sentinelExecutor *volatile *ops = forDevice ? _ctx.DeviceOps : _ctx.HostOps;
+	for (int i = opFirst; i <= opLast; i++)
+		ops[i] = exec;
+	sentinelMemoryBarrier();
+	_dispatchLock = 0;
+}
+
+/* Send messages of op that leave Lane at -1 through lane. Senders read the table out of the maps they send through, so it takes effect
+** for every client and device thread at their next send. */
+void sentinelSetOpLane(int op, int lane)
+{
+	assert(op >= 0 && op < SENTINEL_OPCOUNT && lane >= 0 && lane < SENTINEL_LANES);
+	_opLanes[op] = (unsigned char)lane;
+	for (int i = 0; i < SENTINEL_DEVICEMAPS; i++)
+		if (_ctx.DeviceMap[i]) _ctx.DeviceMap[i]->Lanes[op] = (unsigned char)lane;
+#if HAS_HOSTSENTINEL
+	if (_ctx.HostMap) _ctx.HostMap->Lanes[op] = (unsigned char)lane;
+	for (int i = 0; i < SENTINEL_CLIENTS; i++)
+		if (_clientMaps[i]) _clientMaps[i]->Lanes[op] = (unsigned char)lane;
+#endif
 }
\ No newline at end of file
@@ -8,62 +8,212 @@
 #include <unistdcu.h>
 #include <fcntlcu.h>
 #include <errnocu.h>
+#include <cuda_runtimecu.h>
 
 #define CORE_MAXLENGTH 1000000000
 
+#if defined(LIBCU_HOST) && !defined(_MSC_VER)
+// the device streams live in FILE under the msvc field names, these are glibc's
+#define _file _fileno
+#define _flag _flags
+#define _base _IO_buf_base
+#endif
+
 __BEGIN_DECLS;
 
 // STREAMS
 #pragma region STREAMS
 
-typedef struct __align__(8) {
-	FILE *file;				// reference
-	unsigned short id;		// ID of author
-	unsigned short threadid;// thread ID of author
-} streamRef;
+__constant__ FILE __iob_streams[3];
+__device__ slotTable_t __iob_streamTable = SLOTTABLEINIT(sizeof(FILE));
 
-__device__ streamRef __iob_streamRefs[CORE_MAXFILESTREAM]; // Start of circular buffer (set up by host)
-volatile __device__ streamRef *__iob_freeStreamPtr = __iob_streamRefs; // Current atomically-incremented non-wrapped offset
-volatile __device__ streamRef *__iob_retnStreamPtr = __iob_streamRefs; // Current atomically-incremented non-wrapped offset
-__constant__ FILE __iob_streams[CORE_MAXFILESTREAM+3];
+// marks _flag of a device stream in the bits glibc keeps its own magic in, so a host FILE never carries it
+#define STREAM_MAGIC 0x1CDE0000
+#define STREAM_MAGICMASK 0xFFFF0000
 
-static __device__ __forceinline void writeStreamRef(streamRef *ref, FILE *s)
+/* A device stream is a standard one or one in the stream table, anything else is the host's. A host FILE lies outside the table's
+** segments, where only the host backend, sharing one heap with it, can find it between them: there its _flag tells the two apart. */
+__device__ bool __iob_isstream(FILE *stream)
 {
-	ref->file = s;
-	ref->id = gridDim.x*blockIdx.y + blockIdx.x;
-	ref->threadid = blockDim.x*blockDim.y*threadIdx.z + blockDim.x*threadIdx.y + threadIdx.x;
+	return (stream >= __iob_streams && stream < __iob_streams + 3) || (slotWithin(&__iob_streamTable, stream) && (stream->_flag & STREAM_MAGICMASK) == STREAM_MAGIC);
 }
 
 static __device__ FILE *streamGet(int fd = 0)
 {
-	// advance circular buffer
-	size_t offset = (atomicAdd((uintptr_t *)&__iob_freeStreamPtr, sizeof(streamRef)) - (size_t)&__iob_streamRefs);
-	offset %= (sizeof(streamRef)*CORE_MAXFILESTREAM);
-	int offsetId = offset / sizeof(streamRef);
-	streamRef *ref = (streamRef *)((char *)&__iob_streamRefs + offset);
-	FILE *s = ref->file;
-	if (!s) {
-		s = &__iob_streams[offsetId+3];
-		writeStreamRef(ref, s);
-	}
+	FILE *s;
+	if (slotGet(&__iob_streamTable, (void **)&s) == -1)
+		return nullptr;
+	memset(s, 0, sizeof(FILE));
+	s->_flag = STREAM_MAGIC;
 	s->_file = fd;
 	return s;
 }
 
 static __device__ void streamFree(FILE *s)
 {
-	if (!s) return;
-	//if (s->_file != -1)
-	//	close(s->_file);
-	// advance circular buffer
-	size_t offset = atomicAdd((uintptr_t *)&__iob_retnStreamPtr, sizeof(streamRef)) - (size_t)&__iob_streamRefs;
-	offset %= (sizeof(streamRef)*CORE_MAXFILESTREAM);
-	streamRef *ref = (streamRef *)((char *)&__iob_streamRefs + offset);
-	writeStreamRef(ref, s);
+	int index;
+	if (!s || (index = slotIndexOf(&__iob_streamTable, s)) == -1) return;
+	slotFree(&__iob_streamTable, index);
+}
+
+/* Ready STREAM for freopen: a device stream keeps its slot and closes its file, a host one cannot carry a device file and is closed. */
+static __device__ FILE *streamReopen(FILE *stream)
+{
+	if (!stream) return nullptr;
+	if (ISHOSTFILE(stream)) { fclose_(stream); return nullptr; }
+	if (stream->_file != -1)
+		close(stream->_file);
+	stream->_file = -1;
+	return stream;
 }
 
 #pragma endregion
 
+// HOSTBUFFERS
+#pragma region HOSTBUFFERS
+
+#ifndef CORE_MAXHOSTBUFFER
+#define CORE_MAXHOSTBUFFER 16 // host streams with a write-combining buffer, the rest are written through
+#endif
+#ifndef CORE_HOSTBUFFERSIZE
+#define CORE_HOSTBUFFERSIZE 1024 // bytes combined into one sentinel fwrite
+#endif
+
+enum {
+	HOSTBUFFER_FULL = 0,	// flush when full, the default as for any host file
+	HOSTBUFFER_LINE,		// also flush after a newline
+};
+
+typedef struct __align__(8) {
+	FILE *volatile file;	// host stream owning the buffer, nullptr when free
+	int lock;
+	int mode;
+	int size;				// flush threshold, 0 for CORE_HOSTBUFFERSIZE
+	volatile int length;
+	char data[CORE_HOSTBUFFERSIZE];
+} hostBuffer;
+
+__device__ hostBuffer __iob_hostBuffers[CORE_MAXHOSTBUFFER];
+__device__ FILE *volatile __iob_hostUnbuffered[CORE_MAXHOSTBUFFER]; // host streams set to _IONBF, written through without holding a buffer
+
+// warp-safe critical section: a lane that loses the exchange loops back around instead of spinning ahead of the lane that won
+#define HOSTBUFFER_LOCKED(b, ...) for (bool done_ = false; !done_; ) if (!atomicCAS(&(b)->lock, 0, 1)) { __VA_ARGS__; __threadfence(); atomicExch(&(b)->lock, 0); done_ = true; }
+
+/* Find the buffer of a host stream, claiming a free one if create is set. */
+static __device__ hostBuffer *hostBufferGet(FILE *s, bool create)
+{
+	hostBuffer *b;
+	if (!s) return nullptr;
+	for (b = __iob_hostBuffers; b < __iob_hostBuffers + CORE_MAXHOSTBUFFER; b++)
+		if (b->file == s) return b;
+	if (create)
+		for (b = __iob_hostBuffers; b < __iob_hostBuffers + CORE_MAXHOSTBUFFER; b++)
+			if (!b->file || b->file == s) {
+				// a lane that claimed this slot for the same stream since our lookup has done it for us
+				FILE *f = (FILE *)atomicCAS((unsigned long long *)&b->file, 0ULL, (unsigned long long)s);
+				if (!f || f == s) return b; // won it, or lost it to another lane claiming the same stream
+			}
+	return nullptr;
+}
+
+/* Find the write-through mark of a host stream, claiming a free one if create is set. */
+static __device__ FILE *volatile *hostUnbufferedGet(FILE *s, bool create)
+{
+	FILE *volatile *u;
+	if (!s) return nullptr;
+	for (u = __iob_hostUnbuffered; u < __iob_hostUnbuffered + CORE_MAXHOSTBUFFER; u++)
+		if (*u == s) return u;
+	if (create)
+		for (u = __iob_hostUnbuffered; u < __iob_hostUnbuffered + CORE_MAXHOSTBUFFER; u++)
+			if (!*u || *u == s) {
+				FILE *f = (FILE *)atomicCAS((unsigned long long *)u, 0ULL, (unsigned long long)s);
+				if (!f || f == s) return u;
+			}
+	return nullptr;
+}
+
+/* Send a buffer's contents as a single fwrite. The caller holds the lock. */
+static __device__ int hostBufferFlush(hostBuffer *b, bool wait)
+{
+	if (!b->length) return 0;
+	stdio_fwrite msg(wait, b->data, b->length, 1, b->file);
+	b->length = 0;
+	return wait && msg.RC != 1 ? EOF : 0;
+}
+
+/* Flush the buffer of a host stream, or of every host stream if S is NULL, ahead of anything else sent for it. */
+static __device__ int hostBufferFlushStream(FILE *s, bool wait = false)
+{
+	int rc = 0;
+	hostBuffer *b;
+	if (!s) {
+		for (b = __iob_hostBuffers; b < __iob_hostBuffers + CORE_MAXHOSTBUFFER; b++)
+			if (b->file && b->length) HOSTBUFFER_LOCKED(b, if (b->file && hostBufferFlush(b, wait)) rc = EOF);
+	}
+	else if ((b = hostBufferGet(s, false)) && b->length)
+		HOSTBUFFER_LOCKED(b, rc = hostBufferFlush(b, wait));
+	return rc;
+}
+
+/* Flush and give back the buffer of a host stream being closed, and forget it was written through. */
+static __device__ void hostBufferRelease(FILE *s)
+{
+	FILE *volatile *u = hostUnbufferedGet(s, false);
+	if (u) *u = nullptr;
+	hostBuffer *b = hostBufferGet(s, false);
+	if (!b) return;
+	HOSTBUFFER_LOCKED(b, if (b->file == s) { hostBufferFlush(b, false); b->mode = HOSTBUFFER_FULL; b->size = 0; b->file = nullptr; });
+}
+
+/* A host stream just opened may sit at the address of one the host closed behind our back: drop, unsent, whatever that one left. */
+static __device__ FILE *hostBufferOpened(FILE *s)
+{
+	FILE *volatile *u = hostUnbufferedGet(s, false);
+	if (u) *u = nullptr;
+	hostBuffer *b = hostBufferGet(s, false);
+	if (b) HOSTBUFFER_LOCKED(b, if (b->file == s) { b->length = 0; b->mode = HOSTBUFFER_FULL; b->size = 0; b->file = nullptr; });
+	return s;
+}
+
+/* Append to the buffer of a host stream, flushing as it fills and, when line buffered, after a newline. Returns false, buffering nothing, for a stream to write through. */
+static __device__ bool hostBufferWrite(FILE *s, const void *ptr, size_t size)
+{
+	if (hostUnbufferedGet(s, false)) return false;
+	hostBuffer *b = hostBufferGet(s, true);
+	if (!b) return false;
+	const char *v = (const char *)ptr;
+	HOSTBUFFER_LOCKED(b,
+		int limit = b->size ? b->size : CORE_HOSTBUFFERSIZE;
+		bool newline = b->mode == HOSTBUFFER_LINE && memchr(v, '\n', size);
+		while (size > 0) {
+			size_t n = _MIN(size, (size_t)(limit - b->length));
+			memcpy(b->data + b->length, v, n);
+			b->length += (int)n; v += n; size -= n;
+			if (b->length >= limit) hostBufferFlush(b, false);
+		}
+		if (newline) hostBufferFlush(b, false));
+	return true;
+}
+
+/* Match setvbuf on the buffer of a host stream. _IONBF gives the buffer back for a mark, with no mark free the stream stays buffered. */
+static __device__ void hostBufferSetMode(FILE *s, int modes, size_t n)
+{
+	if (modes == _IONBF) { hostBufferRelease(s); hostUnbufferedGet(s, true); return; }
+	FILE *volatile *u = hostUnbufferedGet(s, false);
+	if (u) *u = nullptr;
+	hostBuffer *b = hostBufferGet(s, true);
+	if (!b) return;
+	HOSTBUFFER_LOCKED(b,
+		hostBufferFlush(b, false);
+		b->mode = modes == _IOLBF ? HOSTBUFFER_LINE : HOSTBUFFER_FULL;
+		b->size = n > 0 && n < CORE_HOSTBUFFERSIZE ? (int)n : 0);
+}
+
+static __global__ void g_hostBufferFlushAll() { hostBufferFlushStream(nullptr, true); }
+cudaError_t cudaDeviceFlushHostStreams() { cudaLaunchGrid(g_hostBufferFlushAll, 1, 1)(); return cudaDeviceSynchronize(); }
+
+#pragma endregion
+
 /* Remove file FILENAME.  */
 __device__ int remove_(const char *filename)
 {
@@ -96,7 +246,7 @@ __device__ FILE *tmpfile_(void)
 /* Close STREAM. */
 __device__ int fclose_(FILE *stream, bool wait)
 {
-	if (ISHOSTFILE(stream)) { stdio_fclose msg(wait, stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferRelease(stream); stdio_fclose msg(wait, stream); return msg.RC; }
 	dirEnt_t *f; UNUSED_SYMBOL(f);
 	if (!stream || !(f = (dirEnt_t *)stream->_base))
 		panic("fclose: !stream");
@@ -109,16 +259,16 @@ __device__ int fclose_(FILE *stream, bool wait)
 /* Flush STREAM, or all streams if STREAM is NULL. */
 __device__ int fflush_(FILE *stream)
 { 
-	if (ISHOSTFILE(stream)) { stdio_fflush msg(false, stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_fflush msg(false, stream); return msg.RC; }
 	return 0; 
 }
 
 /* Open a file, replacing an existing stream with it. */
 __device__ FILE *freopen_(const char *__restrict filename, const char *__restrict modes, FILE *__restrict stream)
 {
-	if (ISHOSTPATH(filename)) { stdio_freopen msg(filename, modes, stream); return msg.RC; }
-	if (stream)
-		streamFree(stream);
+	if (stream && ISHOSTFILE(stream)) hostBufferRelease(stream);
+	if (ISHOSTPATH(filename)) { stdio_freopen msg(filename, modes, stream); return hostBufferOpened(msg.RC); }
+	stream = streamReopen(stream);
 	// Parse the specified mode.
 	unsigned short openMode = O_RDONLY;
 	if (*modes != 'r') { // Not read...
@@ -146,10 +296,10 @@ __device__ FILE *freopen_(const char *__restrict filename, const char *__restric
 		if (!stream)
 			return nullptr;
 	}
-	stream->_flag = openMode;
+	stream->_flag = STREAM_MAGIC | openMode;
+	// fsystemOpen sets errno, EMFILE among them
 	stream->_base = (char *)fsystemOpen(filename, openMode, &stream->_file);
 	if (!stream->_base) {
-		_set_errno(EINVAL);
 		streamFree(stream);
 		return nullptr;
 	}
@@ -159,7 +309,7 @@ __device__ FILE *freopen_(const char *__restrict filename, const char *__restric
 /* Open a file and create a new stream for it. */
 __device__ FILE *fopen_(const char *__restrict filename, const char *__restrict modes)
 {
-	if (ISHOSTPATH(filename)) { stdio_freopen msg(filename, modes, nullptr); return msg.RC; }
+	if (ISHOSTPATH(filename)) { stdio_freopen msg(filename, modes, nullptr); return hostBufferOpened(msg.RC); }
 	return freopen_(filename, modes, nullptr); 
 }
 
@@ -167,9 +317,8 @@ __device__ FILE *fopen_(const char *__restrict filename, const char *__restrict
 /* Open a file, replacing an existing stream with it. */
 __device__ FILE *freopen64_(const char *__restrict filename, const char *__restrict modes, FILE *__restrict stream)
 {
-	if (ISHOSTPATH(filename)) { stdio_freopen msg(filename, modes, stream); return msg.RC; }
-	if (stream)
-		fclose_(stream);
+	if (ISHOSTPATH(filename)) { stdio_freopen msg(filename, modes, stream); return hostBufferOpened(msg.RC); }
+	stream = streamReopen(stream);
 	// Parse the specified mode.
 	unsigned short openMode = O_RDONLY;
 	if (*modes != 'r') { // Not read...
@@ -205,7 +354,7 @@ __device__ FILE *freopen64_(const char *__restrict filename, const char *__restr
 /* Open a file and create a new stream for it. */
 __device__ FILE *fopen64_(const char *__restrict filename, const char *__restrict modes)
 {
-	if (ISHOSTPATH(filename)) { stdio_freopen msg(filename, modes, nullptr); return msg.RC; }
+	if (ISHOSTPATH(filename)) { stdio_freopen msg(filename, modes, nullptr); return hostBufferOpened(msg.RC); }
 	return freopen64_(filename, modes, nullptr); 
 }
 #endif
@@ -213,7 +362,7 @@ __device__ FILE *fopen64_(const char *__restrict filename, const char *__restric
 /* Make STREAM use buffering mode MODE. If BUF is not NULL, use N bytes of it for buffering; else allocate an internal buffer N bytes long.  */
 __device__ int setvbuf_(FILE *__restrict stream, char *__restrict buf, int modes, size_t n)
 {
-	if (ISHOSTFILE(stream)) { stdio_setvbuf msg(stream, buf, modes, n); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferSetMode(stream, modes, n); stdio_setvbuf msg(stream, buf, modes, n); return msg.RC; }
 	panic("Not Implemented");
 	return 0;
 }
@@ -221,12 +370,12 @@ __device__ int setvbuf_(FILE *__restrict stream, char *__restrict buf, int modes
 /* If BUF is NULL, make STREAM unbuffered. Else make it use buffer BUF, of size BUFSIZ.  */
 __device__ void setbuf_(FILE *__restrict stream, char *__restrict buf)
 {
-	if (ISHOSTFILE(stream)) { stdio_setvbuf msg(stream, buf, -1, 0); return; }
+	if (ISHOSTFILE(stream)) { hostBufferSetMode(stream, buf ? _IOFBF : _IONBF, 0); stdio_setvbuf msg(stream, buf, -1, 0); return; }
 	setvbuf_(stream, buf, buf ? _IOFBF : _IONBF, BUFSIZ);
 }
 
 /* Write formatted output to S from argument list ARG.  */
-#ifdef __CUDA_ARCH__
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __device__ int vsnprintf_(char *__restrict s, size_t maxlen, const char *__restrict format, va_list va)
 {
 	if (maxlen <= 0) return -1;
@@ -239,7 +388,7 @@ __device__ int vsnprintf_(char *__restrict s, size_t maxlen, const char *__restr
 #endif
 
 /* Write formatted output to S from argument list ARG. */
-#ifdef __CUDA_ARCH__
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __device__ int vfprintf_(FILE *__restrict s, const char *__restrict format, va_list va, bool wait)
 {
 	char base[PRINT_BUF_SIZE];
@@ -247,11 +396,9 @@ __device__ int vfprintf_(FILE *__restrict s, const char *__restrict format, va_l
 	strbldInit(&b, nullptr, base, sizeof(base), CORE_MAXLENGTH);
 	strbldAppendFormat(&b, format, va);
 	const char *v = strbldToString(&b);
-	int size = b.index + 1;
-	// chunk results
-	int offset = 0; int rc = 0;
-	if (!ISHOSTFILE(s)) while (size > 0 && !rc) { rc = fwrite_(v + offset, size > 1024 ? 1024 : size, 1, s); size -= 1024; }
-	else while (size > 0 && !rc) { stdio_fwrite msg(true, v + offset, size > 1024 ? 1024 : size, 1, s); rc = msg.RC; size -= 1024; }
+	int size = b.index;
+	int rc = size;
+	if (fwrite_(v, 1, size, s, wait) != (size_t)size && wait) rc = -1;
 	free((void *)v);
 	return rc; 
 }
@@ -274,7 +421,7 @@ __device__ int vsscanf_(const char *__restrict s, const char *__restrict format,
 /* Read a character from STREAM.  */
 __device__ int fgetc_(FILE *stream)
 {
-	if (ISHOSTFILE(stream)) { stdio_fgetc msg(stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_fgetc msg(stream); return msg.RC; }
 	panic("Not Implemented");
 	return 0;
 }
@@ -282,7 +429,7 @@ __device__ int fgetc_(FILE *stream)
 /* Write a character to STREAM.  */
 __device__ int fputc_(int c, FILE *stream, bool wait)
 {
-	if (ISHOSTFILE(stream)) { stdio_fputc msg(wait, c, stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) { char ch = (char)c; if (hostBufferWrite(stream, &ch, 1)) return (unsigned char)c; stdio_fputc msg(wait, c, stream); return msg.RC; }
 	if (stream == stdout || stream == stderr)
 		printf("%c", c);
 	return 0;
@@ -291,7 +438,7 @@ __device__ int fputc_(int c, FILE *stream, bool wait)
 /* Get a newline-terminated string of finite length from STREAM.  */
 __device__ char *fgets_(char *__restrict s, int n, FILE *__restrict stream)
 {
-	if (ISHOSTFILE(stream)) { stdio_fgets msg(s, n, stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_fgets msg(s, n, stream); return msg.RC; }
 	panic("Not Implemented");
 	return nullptr;
 }
@@ -299,7 +446,7 @@ __device__ char *fgets_(char *__restrict s, int n, FILE *__restrict stream)
 /* Write a string to STREAM.  */
 __device__ int fputs_(const char *__restrict s, FILE *__restrict stream, bool wait)
 {
-	if (ISHOSTFILE(stream)) { stdio_fputs msg(wait, s, stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) { if (hostBufferWrite(stream, s, strlen(s))) return 0; stdio_fputs msg(wait, s, stream); return msg.RC; }
 	if (stream == stdout || stream == stderr)
 		printf(s);
 	return 0;
@@ -308,7 +455,7 @@ __device__ int fputs_(const char *__restrict s, FILE *__restrict stream, bool wa
 /* Push a character back onto the input buffer of STREAM.  */
 __device__ int ungetc_(int c, FILE *stream, bool wait)
 {
-	if (ISHOSTFILE(stream)) { stdio_ungetc msg(wait, c, stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_ungetc msg(wait, c, stream); return msg.RC; }
 	panic("Not Implemented");
 	return 0;
 }
@@ -316,7 +463,16 @@ __device__ int ungetc_(int c, FILE *stream, bool wait)
 /* Read chunks of generic data from STREAM.  */
 __device__ size_t fread_(void *__restrict ptr, size_t size, size_t n, FILE *__restrict stream, bool wait)
 {
-	if (ISHOSTFILE(stream)) { stdio_fread msg(wait, size, n, stream); memcpy(ptr, msg.Ptr, msg.RC); return msg.RC; }
+	if (ISHOSTFILE(stream)) {
+		hostBufferFlushStream(stream);
+		if (!size || !n) return 0;
+		// pooled buffers are read into in place by the host, in one message of any length
+		if (sentinelDevicePooled(ptr, size * n)) { stdio_fread msg(true, ptr, size, n, stream); return msg.RC; }
+		size_t rc = sentinelDeviceStream<stdio_fread>((char *)ptr, size * n,
+			[=](stdio_fread *msg, sentinelTicket *ticket, size_t offset, size_t length) { new (msg) stdio_fread(ticket, (char *)ptr + offset, 1, length, stream); },
+			[](stdio_fread *msg) { return msg->RC; });
+		return rc == (size_t)-1 ? 0 : rc / size;
+	}
 	dirEnt_t *f;
 	if (!stream || !(f = (dirEnt_t *)stream->_base))
 		panic("fwrite: !stream");
@@ -330,7 +486,20 @@ __device__ size_t fread_(void *__restrict ptr, size_t size, size_t n, FILE *__re
 /* Write chunks of generic data to STREAM.  */
 __device__ size_t fwrite_(const void *__restrict ptr, size_t size, size_t n, FILE *__restrict stream, bool wait)
 {
-	if (ISHOSTFILE(stream)) { stdio_fwrite msg(wait, ptr, size, n, stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) {
+		size_t length = size * n, chunk = SENTINEL_PAYLOAD(sizeof(stdio_fwrite));
+		if (!length) return 0;
+		// a write the buffer cannot hold goes out after what it holds, counted by the host rather than accepted in buffer sized pieces
+		if (length < CORE_HOSTBUFFERSIZE) { if (hostBufferWrite(stream, ptr, length)) return n; }
+		else if (hostBufferFlushStream(stream, wait)) return 0;
+		// pooled buffers skip the copy into slots, the send still waits as the host reads the pool in place
+		if (length >= CORE_HOSTBUFFERSIZE && sentinelDevicePooled(ptr, length)) { stdio_fwrite msg(true, ptr, size, n, stream, true); return msg.RC; }
+		if (!wait) { for (size_t offset = 0; offset < length; offset += chunk) { stdio_fwrite msg(false, (const char *)ptr + offset, 1, _MIN(chunk, length - offset), stream); } return n; }
+		size_t rc = sentinelDeviceStream<stdio_fwrite>(nullptr, length,
+			[=](stdio_fwrite *msg, sentinelTicket *ticket, size_t offset, size_t length) { new (msg) stdio_fwrite(ticket, (const char *)ptr + offset, 1, length, stream); },
+			[](stdio_fwrite *msg) { return msg->RC; });
+		return rc == (size_t)-1 ? 0 : rc / size;
+	}
 	dirEnt_t *f;
 	if (!stream || !(f = (dirEnt_t *)stream->_base))
 		panic("fwrite: !stream");
@@ -344,7 +513,7 @@ __device__ size_t fwrite_(const void *__restrict ptr, size_t size, size_t n, FIL
 /* Seek to a certain position on STREAM.  */
 __device__ int fseek_(FILE *stream, long int off, int whence)
 {
-	if (ISHOSTFILE(stream)) { stdio_fseek msg(true, stream, off, whence); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_fseek msg(true, stream, off, whence); return msg.RC; }
 	panic("Not Implemented");
 	return 0;
 }
@@ -352,7 +521,7 @@ __device__ int fseek_(FILE *stream, long int off, int whence)
 /* Return the current position of STREAM.  */
 __device__ long int ftell_(FILE *stream)
 {
-	if (ISHOSTFILE(stream)) { stdio_ftell msg(stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_ftell msg(stream); return msg.RC; }
 	panic("Not Implemented");
 	return 0;
 }
@@ -360,7 +529,7 @@ __device__ long int ftell_(FILE *stream)
 /* Rewind to the beginning of STREAM.  */
 __device__ void rewind_(FILE *stream)
 {
-	if (ISHOSTFILE(stream)) { stdio_rewind msg(stream); return; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_rewind msg(stream); return; }
 	panic("Not Implemented");
 	return;
 }
@@ -368,7 +537,7 @@ __device__ void rewind_(FILE *stream)
 /* Get STREAM's position.  */
 __device__ int fgetpos_(FILE *__restrict stream, fpos_t *__restrict pos)
 {
-	if (ISHOSTFILE(stream)) { stdio_fgetpos msg(stream, pos); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_fgetpos msg(stream, pos); return msg.RC; }
 	panic("Not Implemented");
 	return 0;
 }
@@ -376,7 +545,7 @@ __device__ int fgetpos_(FILE *__restrict stream, fpos_t *__restrict pos)
 /* Set STREAM's position.  */
 __device__ int fsetpos_(FILE *stream, const fpos_t *pos)
 {
-	if (ISHOSTFILE(stream)) { stdio_fsetpos msg(stream, pos); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_fsetpos msg(stream, pos); return msg.RC; }
 	panic("Not Implemented");
 	return 0;
 }
@@ -391,7 +560,7 @@ __device__ void clearerr_(FILE *stream)
 /* Return the EOF indicator for STREAM.  */
 __device__ int feof_(FILE *stream)
 {
-	if (ISHOSTFILE(stream)) { stdio_feof msg(stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_feof msg(stream); return msg.RC; }
 	panic("Not Implemented");
 	return 0;
 }
@@ -399,7 +568,7 @@ __device__ int feof_(FILE *stream)
 /* Return the error indicator for STREAM.  */
 __device__ int ferror_(FILE *stream)
 {
-	if (ISHOSTFILE(stream)) { stdio_ferror msg(stream); return msg.RC; }
+	if (ISHOSTFILE(stream)) { hostBufferFlushStream(stream); stdio_ferror msg(stream); return msg.RC; }
 	if (stream == stdout || stream == stderr)
 		return 0; 
 	return 0;
@@ -860,7 +1029,7 @@ match_failure:
 
 #pragma endregion
 
-#ifdef __CUDA_ARCH__
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __device__ char *vmtagprintf_(void *tag, const char *format, va_list va)
 {
 	assert(tag != nullptr);
@@ -875,7 +1044,7 @@ __device__ char *vmtagprintf_(void *tag, const char *format, va_list va)
 }
 #endif
 
-#ifdef __CUDA_ARCH__
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __device__ char *vmprintf_(const char *format, va_list va)
 {
 	char base[PRINT_BUF_SIZE];
@@ -886,7 +1055,7 @@ __device__ char *vmprintf_(const char *format, va_list va)
 }
 #endif
 
-#ifdef __CUDA_ARCH__
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 __device__ char *vmsnprintf_(char *__restrict s, size_t maxlen, const char *format, va_list va)
 {
 	if (maxlen <= 0) return (char *)s;
@@ -902,4 +1071,10 @@ __END_DECLS;
 ///* Read formatted input from stdin into argument list ARG. */
 //__device__ int vscanf_(const char *__restrict format, va_list va) { return -1; }
 ///* Read formatted input from S into argument list ARG.  */
-//__device__ int vsscanf_(const char *__restrict s, const char *__restrict format, va_list va) { return -1; }
\ No newline at end of file
+//__device__ int vsscanf_(const char *__restrict s, const char *__restrict format, va_list va) { return -1; }
+
+#if defined(LIBCU_HOST) && !defined(_MSC_VER)
+#undef _file
+#undef _flag
+#undef _base
+#endif
@@ -5,6 +5,7 @@
 #include <ctypecu.h>
 #include <errnocu.h>
 #include <fcntlcu.h>
+#include <unistdcu.h>
 #include <assert.h>
 
 __BEGIN_DECLS;
@@ -695,40 +696,113 @@ __device__ void _Exit_(int status)
 	stdlib_exit msg(false, status);
 }
 
+// the environment is __environ, grown by setenv into an array of its own; strings it replaces are not freed, getenv may have handed them out
+static __device__ volatile int _environLock;
+static __device__ char **_environOwned; // __environ once setenv has grown it
+
+static __device__ char **environFind(const char *name, size_t length)
+{
+	char **e = __environ;
+	for (; *e; e++)
+		if (!strncmp(*e, name, length) && (*e)[length] == '=') return e;
+	return e;
+}
+
 /* Return the value of envariable NAME, or NULL if it doesn't exist.  */
 __device__ char *getenv_(const char *name)
 {
-	//if (!strcmp(name, "HOME")) return "gpu:\\";
-	//if (!strcmp(name, "PATH")) return "gpu:\\";
-	panic("Not Implemented");
-	return nullptr;
+	size_t length = strlen(name);
+	char **e = environFind(name, length);
+	return *e ? *e + length + 1 : nullptr;
 }
 
 /* Set NAME to VALUE in the environment. If REPLACE is nonzero, overwrite an existing value.  */
 __device__ int setenv_(const char *name, const char *value, int replace)
 {
-	panic("Not Implemented");
-	return 0;
+	size_t length = strlen(name);
+	if (!length || strchr(name, '=')) {
+		_set_errno(EINVAL);
+		return -1;
+	}
+	size_t valueLength = strlen(value);
+	char *entry = (char *)malloc(length + valueLength + 2);
+	if (!entry) {
+		_set_errno(ENOMEM);
+		return -1;
+	}
+	memcpy(entry, name, length); entry[length] = '='; memcpy(entry + length + 1, value, valueLength + 1);
+	int rc = 0;
+	// warp-safe lock: a lane that loses the exchange loops back around instead of spinning ahead of the lane that won
+	for (bool done = false; !done; )
+		if (!atomicCAS((int *)&_environLock, 0, 1)) {
+			char **e = environFind(name, length);
+			if (*e) { if (replace) *e = entry; else { free(entry); entry = nullptr; } }
+			else {
+				int count = (int)(e - __environ);
+				char **grown = (char **)malloc((count + 2) * sizeof(char *));
+				if (!grown) { free(entry); _set_errno(ENOMEM); rc = -1; }
+				else {
+					memcpy(grown, __environ, count * sizeof(char *));
+					grown[count] = entry; grown[count + 1] = nullptr;
+					if (_environOwned) free(_environOwned);
+					__environ = _environOwned = grown;
+				}
+			}
+			__threadfence(); atomicExch((int *)&_environLock, 0); done = true;
+		}
+	return rc;
 }
 
 /* Remove the variable NAME from the environment.  */
 __device__ int unsetenv_(const char *name)
 {
-	panic("Not Implemented");
+	size_t length = strlen(name);
+	if (!length || strchr(name, '=')) {
+		_set_errno(EINVAL);
+		return -1;
+	}
+	for (bool done = false; !done; )
+		if (!atomicCAS((int *)&_environLock, 0, 1)) {
+			char **e;
+			while (*(e = environFind(name, length)))
+				do e[0] = e[1]; while (*++e);
+			__threadfence(); atomicExch((int *)&_environLock, 0); done = true;
+		}
 	return 0;
 }
 
-/* Generate a unique temporary file name from TEMPLATE. */
+static __device__ volatile unsigned int _mktempCount;
+
+/* Generate a unique temporary file name from TEMPLATE, whose last six characters must be "XXXXXX" and are replaced. Returns TEMPLATE,
+emptied with errno set when it is out of shape or no unused name was found. */
 __device__ char *mktemp_(char *template_)
 {
-	panic("Not Implemented");
-	return nullptr;
+	const char *letters = "abcdefghijklmnopqrstuvwxyz0123456789";
+	size_t length = strlen(template_);
+	if (length < 6 || strcmp(template_ + length - 6, "XXXXXX")) {
+		_set_errno(EINVAL);
+		*template_ = 0;
+		return template_;
+	}
+	char *x = template_ + length - 6;
+	for (int attempt = 0; attempt < 100; attempt++) {
+		unsigned int v = atomicAdd((unsigned int *)&_mktempCount, 1) * 2654435761U ^ (unsigned int)clock64();
+		for (int i = 0; i < 6; i++, v /= 36) x[i] = letters[v % 36];
+		// a name is taken when it opens, or is a directory
+		_set_errno(0);
+		int fd = open(template_, O_RDONLY);
+		if (fd != -1) close(fd);
+		else if (errno != EISDIR) return template_;
+	}
+	_set_errno(EEXIST);
+	*template_ = 0;
+	return template_;
 }
 
-/* Generate a unique temporary file name from TEMPLATE. */
+/* Generate a unique temporary file name from TEMPLATE, create the file and open it for reading and writing. */
 __device__ int mkstemp_(char *template_)
 {
-	return open(mktemp_(template_), 0);
+	return *mktemp_(template_) ? open(template_, O_CREAT|O_RDWR) : -1;
 }
 
 /* Execute the given line as a shell command.  */
@@ -893,36 +967,58 @@ __device__ lldiv_t lldiv_(long long int numer, long long int denom)
 }
 #endif
 
+// multibyte characters are those of the "C" locale, a byte each, and so stateless
+
 /* Return the length of the multibyte character in S, which is no longer than N.  */
 __device__ int mblen_(const char *s, size_t n)
 {
-	panic("Not Implemented");
-	return 0;
+	if (!s) return 0;
+	if (!n) return -1;
+	return *s ? 1 : 0;
 }
 /* Return the length of the given multibyte character, putting its `wchar_t' representation in *PWC.  */
 __device__ int mbtowc_(wchar_t *__restrict __pwc, const char *__restrict s, size_t n)
 {
-	panic("Not Implemented");
-	return 0;
+	if (!s) return 0;
+	if (!n) return -1;
+	if (__pwc) *__pwc = (unsigned char)*s;
+	return *s ? 1 : 0;
 }
 /* Put the multibyte character represented by WCHAR in S, returning its length.  */
 __device__ int wctomb_(char *s, wchar_t wchar)
 {
-	panic("Not Implemented");
-	return 0;
+	if (!s) return 0;
+	if ((unsigned)wchar > 0xff) {
+		_set_errno(EILSEQ);
+		return -1;
+	}
+	*s = (char)wchar;
+	return 1;
 }
 
 /* Convert a multibyte string to a wide char string.  */
 __device__ size_t mbstowcs_(wchar_t *__restrict pwcs, const char *__restrict s, size_t n)
 {
-	panic("Not Implemented");
-	return 0;
+	size_t i = 0;
+	for (; !pwcs || i < n; i++) {
+		if (pwcs) pwcs[i] = (unsigned char)s[i];
+		if (!s[i]) break;
+	}
+	return i;
 }
 /* Convert a wide char string to multibyte string.  */
 __device__ size_t wcstombs_(char *__restrict s, const wchar_t *__restrict pwcs, size_t n)
 {
-	panic("Not Implemented");
-	return 0;
+	size_t i = 0;
+	for (; !s || i < n; i++) {
+		if ((unsigned)pwcs[i] > 0xff) {
+			_set_errno(EILSEQ);
+			return (size_t)-1;
+		}
+		if (s) s[i] = (char)pwcs[i];
+		if (!pwcs[i]) break;
+	}
+	return i;
 }
 
 __END_DECLS;
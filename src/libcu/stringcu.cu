@@ -7,6 +7,9 @@
 #include <assert.h>
 
 #define xOMIT_PTX
+#ifdef LIBCU_HOST
+#define OMIT_PTX
+#endif
 __BEGIN_DECLS;
 
 /* Copy N bytes of SRC to DEST.  */
@@ -1188,7 +1191,7 @@ __device__ void strbldAppendFormat(strbld_t *b, const char *fmt, va_list va) //:
 			char q = (type == TYPE_SQLESCAPE3 ? '"' : '\''); // Quote character
 			char *escarg = noArgs ? va_arg(va, char*) : __extsystem.getStringArg(args);
 			bool isnull = !escarg;
-			if (isnull) escarg = (type == TYPE_SQLESCAPE2 ? "NULL" : "(NULL)");
+			if (isnull) escarg = (char *)(type == TYPE_SQLESCAPE2 ? "NULL" : "(NULL)");
 			int k = precision;
 			int i, j, n;
 			char ch;
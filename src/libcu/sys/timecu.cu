@@ -2,7 +2,7 @@
 #include <sys/timecu.h>
 
 __BEGIN_DECLS;
-#if defined(__CUDA_ARCH__)
+#if defined(__CUDA_ARCH__) || defined(LIBCU_HOST)
 
 // gettimeofday
 __device__ int gettimeofday_(struct timeval *tp, void *tz)
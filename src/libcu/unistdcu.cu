@@ -37,7 +37,12 @@ __device__ off64_t lseek64_(int fd, off64_t offset, int whence)
 /* Read NBYTES into BUF from FD.  Return the number read, -1 for errors or 0 for EOF.  */
 __device__ size_t read_(int fd, void *buf, size_t nbytes, bool wait)
 {
-	if (ISHOSTHANDLE(fd)) { unistd_read msg(wait, fd, buf, nbytes); return msg.RC; }
+	if (ISHOSTHANDLE(fd)) {
+		if (sentinelDevicePooled(buf, nbytes)) { unistd_read msg(true, fd, buf, nbytes, true); return msg.RC; }
+		return sentinelDeviceStream<unistd_read>((char *)buf, nbytes,
+			[=](unistd_read *msg, sentinelTicket *ticket, size_t offset, size_t length) { new (msg) unistd_read(ticket, fd, (char *)buf + offset, length); },
+			[](unistd_read *msg) { return msg->RC; });
+	}
 	panic("Not Implemented");
 	return 0;
 }
@@ -45,7 +50,14 @@ __device__ size_t read_(int fd, void *buf, size_t nbytes, bool wait)
 /* Write N bytes of BUF to FD.  Return the number written, or -1.  */
 __device__ size_t write_(int fd, const void *buf, size_t nbytes, bool wait)
 {
-	if (ISHOSTHANDLE(fd)) { unistd_write msg(wait, fd, buf, nbytes); return msg.RC; }
+	if (ISHOSTHANDLE(fd)) {
+		if (sentinelDevicePooled(buf, nbytes)) { unistd_write msg(true, fd, buf, nbytes, true); return msg.RC; }
+		size_t chunk = SENTINEL_PAYLOAD(sizeof(unistd_write));
+		if (!wait) { for (size_t offset = 0; offset < nbytes; offset += chunk) { unistd_write msg(false, fd, (const char *)buf + offset, _MIN(chunk, nbytes - offset)); } return nbytes; }
+		return sentinelDeviceStream<unistd_write>(nullptr, nbytes,
+			[=](unistd_write *msg, sentinelTicket *ticket, size_t offset, size_t length) { new (msg) unistd_write(ticket, fd, (const char *)buf + offset, length); },
+			[](unistd_write *msg) { return msg->RC; });
+	}
 	panic("Not Implemented");
 	return 0;
 }
@@ -108,7 +120,7 @@ __device__ int dup2_(int fd, int fd2)
 /* NULL-terminated array of "NAME=VALUE" environment variables.  */
 __device__ char *__environ_device[3] = { "HOME=", "PATH=", nullptr }; // pointer to environment table
 
-extern __device__ char **__environ_ = (char **)__environ_device;
+__device__ char **__environ_ = (char **)__environ_device;
 
 /* Remove the link NAME.  */
 __device__ int unlink_(const char *filename)